@@ -0,0 +1,55 @@
+#include "anti_passback.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    int64_t at_us;          // Last recorded attendance
+    uint16_t id;
+    bool used;
+} recent_t;
+
+static recent_t s_recent[ANTI_PASSBACK_SLOTS];
+static anti_passback_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool anti_passback_is_repeat(uint16_t id, int64_t now_us, uint32_t window_ms, uint32_t *age_ms) {
+    if (window_ms == 0) return false;
+    int64_t window_us = (int64_t)window_ms * 1000;
+    bool repeat = false;
+
+    portENTER_CRITICAL(&s_lock);
+    // One pass: the ID's own slot, else the best slot to take over (free
+    // or expired, otherwise the oldest)
+    recent_t *slot = NULL;
+    recent_t *victim = &s_recent[0];
+    for (int i = 0; i < ANTI_PASSBACK_SLOTS; i++) {
+        recent_t *r = &s_recent[i];
+        if (r->used && r->id == id) {
+            slot = r;
+            break;
+        }
+        bool stale = !r->used || now_us - r->at_us >= window_us;
+        bool victim_stale = !victim->used || now_us - victim->at_us >= window_us;
+        if (!victim_stale && (stale || r->at_us < victim->at_us)) victim = r;
+    }
+
+    if (slot && now_us - slot->at_us < window_us) {
+        if (age_ms) *age_ms = (uint32_t)((now_us - slot->at_us) / 1000);
+        s_stats.suppressed++;
+        repeat = true;
+    } else {
+        if (!slot) {
+            if (victim->used && now_us - victim->at_us < window_us) s_stats.evicted++;
+            slot = victim;
+        }
+        *slot = (recent_t){.at_us = now_us, .id = id, .used = true};
+        s_stats.recorded++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return repeat;
+}
+
+void anti_passback_get_stats(anti_passback_stats_t *stats) {
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
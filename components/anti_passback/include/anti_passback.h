@@ -0,0 +1,32 @@
+#ifndef ANTI_PASSBACK_H
+#define ANTI_PASSBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// IDs remembered at once; when all are inside the window the oldest is
+// forgotten first
+#define ANTI_PASSBACK_SLOTS 32
+
+typedef struct {
+    uint32_t recorded;      // Attendances let through
+    uint32_t suppressed;    // Repeats inside the window
+    uint32_t evicted;       // IDs forgotten early, table full
+} anti_passback_stats_t;
+
+/**
+ * @brief Record an attendance for id, unless one was recorded for it less
+ *        than window_ms ago (repeats do not extend the window)
+ * @param window_ms 0 lets everything through
+ * @param age_ms If a repeat, set to the time since the recorded one (may be NULL)
+ * @return true if this is a repeat to suppress
+ * @note Safe to call from several tasks
+ */
+bool anti_passback_is_repeat(uint16_t id, int64_t now_us, uint32_t window_ms, uint32_t *age_ms);
+
+/**
+ * @brief Counters since boot
+ */
+void anti_passback_get_stats(anti_passback_stats_t *stats);
+
+#endif // ANTI_PASSBACK_H
@@ -0,0 +1,189 @@
+#include "attendance_journal.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "JOURNAL";
+
+#define JOURNAL_NAMESPACE "journal"
+
+// RAM mirror of the flash slots; slot = seq % JOURNAL_CAPACITY.
+// seq 0 marks an empty slot.
+static journal_record_t s_records[JOURNAL_CAPACITY];
+static nvs_handle_t s_nvs;
+static bool s_ready = false;
+static uint32_t s_stream_id = 0;
+static uint32_t s_next_seq = 1;
+static uint32_t s_first_seq = 1;      // Oldest seq still held
+static uint32_t s_acked_seq = 0;
+static uint32_t s_overwritten = 0;
+
+static void slot_key(uint32_t seq, char *key, size_t size) {
+    snprintf(key, size, "r%02lu", (unsigned long)(seq % JOURNAL_CAPACITY));
+}
+
+static journal_record_t *slot(uint32_t seq) {
+    return &s_records[seq % JOURNAL_CAPACITY];
+}
+
+static esp_err_t store_record(const journal_record_t *record) {
+    char key[8];
+    slot_key(record->seq, key, sizeof(key));
+    return nvs_set_blob(s_nvs, key, record, sizeof(*record));
+}
+
+static esp_err_t create_stream(void) {
+    // A fresh stream: the server keys sequence numbers by (device, stream),
+    // so a wiped journal never collides with numbers it already acknowledged
+    s_stream_id = esp_random();
+    if (s_stream_id == 0) s_stream_id = 1;
+    s_next_seq = 1;
+    s_first_seq = 1;
+    s_acked_seq = 0;
+
+    nvs_set_u32(s_nvs, "stream", s_stream_id);
+    nvs_set_u32(s_nvs, "next_seq", s_next_seq);
+    nvs_set_u32(s_nvs, "first_seq", s_first_seq);
+    nvs_set_u32(s_nvs, "acked", s_acked_seq);
+    return nvs_commit(s_nvs);
+}
+
+esp_err_t journal_init(void) {
+    esp_err_t ret = nvs_open(JOURNAL_NAMESPACE, NVS_READWRITE, &s_nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    memset(s_records, 0, sizeof(s_records));
+
+    if (nvs_get_u32(s_nvs, "stream", &s_stream_id) != ESP_OK ||
+        nvs_get_u32(s_nvs, "next_seq", &s_next_seq) != ESP_OK ||
+        nvs_get_u32(s_nvs, "first_seq", &s_first_seq) != ESP_OK ||
+        nvs_get_u32(s_nvs, "acked", &s_acked_seq) != ESP_OK) {
+        ESP_LOGW(TAG, "No journal found, starting a new stream");
+        ret = create_stream();
+        if (ret != ESP_OK) return ret;
+    }
+
+    // Reload pending records; a missing or stale slot is a lost record
+    uint32_t lost = 0;
+    for (uint32_t seq = s_first_seq; seq < s_next_seq; seq++) {
+        char key[8];
+        journal_record_t record;
+        size_t size = sizeof(record);
+        slot_key(seq, key, sizeof(key));
+
+        if (nvs_get_blob(s_nvs, key, &record, &size) == ESP_OK &&
+            size == sizeof(record) && record.seq == seq) {
+            *slot(seq) = record;
+        } else {
+            // The server only acknowledges contiguous runs: keep the seq as
+            // a placeholder so it can be reported lost and acked past
+            ESP_LOGE(TAG, "Record %lu unreadable, reporting it lost", (unsigned long)seq);
+            record = (journal_record_t){.seq = seq, .flags = JOURNAL_FLAG_LOST};
+            *slot(seq) = record;
+            store_record(&record);
+            s_overwritten++;
+            lost++;
+        }
+    }
+    if (lost > 0) nvs_commit(s_nvs);
+
+    s_ready = true;
+    ESP_LOGI(TAG, "Stream %08lx: next seq %lu, acked %lu, %lu pending",
+             (unsigned long)s_stream_id, (unsigned long)s_next_seq,
+             (unsigned long)s_acked_seq, (unsigned long)(s_next_seq - s_first_seq));
+    return ESP_OK;
+}
+
+esp_err_t journal_append(journal_record_t *record) {
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+
+    if (s_next_seq - s_first_seq >= JOURNAL_CAPACITY) {
+        ESP_LOGE(TAG, "Journal full, overwriting record %lu", (unsigned long)s_first_seq);
+        s_first_seq++;
+        s_overwritten++;
+    }
+
+    record->seq = s_next_seq;
+    esp_err_t ret = store_record(record);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store record: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    s_next_seq++;
+    nvs_set_u32(s_nvs, "next_seq", s_next_seq);
+    nvs_set_u32(s_nvs, "first_seq", s_first_seq);
+    ret = nvs_commit(s_nvs);
+    if (ret != ESP_OK) {
+        // The blob may be on flash without its counter; the same seq is
+        // reused next time, which the server still sees as one record
+        s_next_seq--;
+        return ret;
+    }
+
+    *slot(record->seq) = *record;
+    return ESP_OK;
+}
+
+size_t journal_peek(uint32_t after_seq, journal_record_t *records, size_t max_count) {
+    size_t count = 0;
+    uint32_t seq = (after_seq + 1 > s_first_seq) ? after_seq + 1 : s_first_seq;
+
+    for (; seq < s_next_seq && count < max_count; seq++) {
+        const journal_record_t *record = slot(seq);
+        if (record->seq == seq) {
+            records[count++] = *record;
+        }
+    }
+    return count;
+}
+
+esp_err_t journal_set_wall_time(uint32_t seq, int64_t wall_us) {
+    if (seq < s_first_seq || seq >= s_next_seq) return ESP_ERR_NOT_FOUND;
+
+    journal_record_t *record = slot(seq);
+    if (record->seq != seq) return ESP_ERR_NOT_FOUND;
+    if ((record->flags & JOURNAL_FLAG_WALL_VALID) && record->wall_us == wall_us) return ESP_OK;
+
+    record->wall_us = wall_us;
+    record->flags |= JOURNAL_FLAG_WALL_VALID;
+    esp_err_t ret = store_record(record);
+    return (ret == ESP_OK) ? nvs_commit(s_nvs) : ret;
+}
+
+esp_err_t journal_ack(uint32_t ack_seq) {
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+    if (ack_seq <= s_acked_seq) return ESP_OK;
+    if (ack_seq >= s_next_seq) {
+        // The server knows numbers this stream never issued
+        ESP_LOGW(TAG, "Ignoring ack %lu beyond next seq %lu",
+                 (unsigned long)ack_seq, (unsigned long)s_next_seq);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Releasing is a watermark move; the slots are reused in place,
+    // so the whole batch costs one counter write
+    s_acked_seq = ack_seq;
+    if (s_first_seq <= ack_seq) s_first_seq = ack_seq + 1;
+
+    nvs_set_u32(s_nvs, "acked", s_acked_seq);
+    nvs_set_u32(s_nvs, "first_seq", s_first_seq);
+    return nvs_commit(s_nvs);
+}
+
+uint32_t journal_first_seq(void) {
+    return s_first_seq;
+}
+
+void journal_get_stats(journal_stats_t *stats) {
+    stats->stream_id = s_stream_id;
+    stats->next_seq = s_next_seq;
+    stats->acked_seq = s_acked_seq;
+    stats->pending = s_next_seq - s_first_seq;
+    stats->overwritten = s_overwritten;
+}
@@ -0,0 +1,77 @@
+#ifndef ATTENDANCE_JOURNAL_H
+#define ATTENDANCE_JOURNAL_H
+
+#include "esp_err.h"
+#include "time_manager.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Unacknowledged records kept in flash (one NVS blob each)
+#define JOURNAL_CAPACITY 64
+
+#define JOURNAL_FLAG_WALL_VALID 0x01   // wall_us holds the resolved capture time
+#define JOURNAL_FLAG_LOST 0x02         // Slot could not be read back: only seq is valid
+
+// One attendance record. seq is assigned on append, persistent across
+// reboots and strictly increasing within a stream.
+typedef struct {
+    uint32_t seq;
+    uint16_t fingerprint_id;
+    uint8_t method;               // login_method_t
+    uint8_t flags;
+    event_time_t captured;
+    int64_t wall_us;              // Unix time in µs, valid with JOURNAL_FLAG_WALL_VALID
+} journal_record_t;
+
+typedef struct {
+    uint32_t stream_id;           // Random, regenerated if the journal is ever lost
+    uint32_t next_seq;
+    uint32_t acked_seq;           // Highest contiguous seq the server confirmed
+    uint32_t pending;
+    uint32_t overwritten;         // Unacknowledged records lost to a full journal or a bad slot
+} journal_stats_t;
+
+/**
+ * @brief Load the journal from NVS (call after nvs_flash_init)
+ * A pending record that cannot be read back is kept as a JOURNAL_FLAG_LOST
+ * placeholder, so the upload reports its seq instead of stalling on the gap.
+ * @note Not thread-safe: use the journal from a single task
+ */
+esp_err_t journal_init(void);
+
+/**
+ * @brief Assign the next sequence number and persist the record
+ * A full journal overwrites its oldest unacknowledged record.
+ * @param record In: payload fields. Out: seq filled in.
+ */
+esp_err_t journal_append(journal_record_t *record);
+
+/**
+ * @brief Copy up to max_count pending records after a given seq, oldest first
+ * @param after_seq Start after this seq (pass the acked seq for everything pending)
+ */
+size_t journal_peek(uint32_t after_seq, journal_record_t *records, size_t max_count);
+
+/**
+ * @brief Store a record's resolved wall time so it survives a reboot
+ */
+esp_err_t journal_set_wall_time(uint32_t seq, int64_t wall_us);
+
+/**
+ * @brief Advance the acknowledgment watermark, releasing every record up to ack_seq
+ * Older or out-of-range acknowledgments are ignored.
+ */
+esp_err_t journal_ack(uint32_t ack_seq);
+
+/**
+ * @brief First seq still held (records before it are acknowledged or lost)
+ */
+uint32_t journal_first_seq(void);
+
+/**
+ * @brief Get journal counters
+ */
+void journal_get_stats(journal_stats_t *stats);
+
+#endif // ATTENDANCE_JOURNAL_H
@@ -0,0 +1,185 @@
+#include "boot_orchestrator.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "trace.h"
+
+static const char *TAG = "BOOT";
+
+#define BOOT_DEFAULT_STACK 4096
+
+typedef struct {
+    uint8_t index;
+    esp_err_t err;
+} step_done_t;
+
+typedef struct {
+    const boot_step_t *step;
+    uint8_t index;
+} step_arg_t;
+
+// Static: a timed-out step may still finish after boot_orchestrator_run returned
+static QueueHandle_t s_done_queue = NULL;
+static StaticQueue_t s_done_queue_buf;
+static uint8_t s_done_storage[BOOT_MAX_STEPS * sizeof(step_done_t)];
+static step_arg_t s_args[BOOT_MAX_STEPS];
+
+static void step_task(void *arg) {
+    step_arg_t *a = (step_arg_t *)arg;
+    TRACE_BEGIN(TRACE_BOOT_STEP, a->index);
+    step_done_t done = {.index = a->index, .err = a->step->run(a->step->ctx)};
+    TRACE_END(TRACE_BOOT_STEP);
+    xQueueSend(s_done_queue, &done, 0);
+    vTaskDelete(NULL);
+}
+
+static uint32_t elapsed_ms(int64_t start_us) {
+    return (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+}
+
+const char *boot_step_status_name(boot_step_status_t status) {
+    switch (status) {
+        case BOOT_STEP_PENDING: return "pending";
+        case BOOT_STEP_RUNNING: return "running";
+        case BOOT_STEP_OK:      return "ok";
+        case BOOT_STEP_FAILED:  return "failed";
+        case BOOT_STEP_TIMEOUT: return "timeout";
+        case BOOT_STEP_SKIPPED: return "skipped";
+        default:                return "unknown";
+    }
+}
+
+// State of one boot_orchestrator_run call
+typedef struct {
+    const boot_step_t *steps;
+    boot_step_result_t *results;
+    boot_step_done_cb_t on_done;
+    void *user_data;
+    int64_t t0;
+    uint32_t ok_mask;
+    uint32_t settled_mask;
+    size_t settled;
+} boot_run_t;
+
+static void settle(boot_run_t *run, size_t i, boot_step_status_t status) {
+    boot_step_result_t *r = &run->results[i];
+    r->status = status;
+    r->elapsed_ms = elapsed_ms(run->t0) - r->start_ms;
+    run->settled_mask |= BOOT_DEP(i);
+    if (status == BOOT_STEP_OK) run->ok_mask |= BOOT_DEP(i);
+    run->settled++;
+
+    ESP_LOGI(TAG, "%s: %s in %lu ms", run->steps[i].name, boot_step_status_name(status),
+             (unsigned long)r->elapsed_ms);
+    if (run->on_done) run->on_done(i, &run->steps[i], r, run->user_data);
+}
+
+esp_err_t boot_orchestrator_run(const boot_step_t *steps, size_t count,
+                                boot_step_done_cb_t on_done, void *user_data,
+                                boot_step_result_t *results) {
+    if (!steps || count == 0 || count > BOOT_MAX_STEPS) return ESP_ERR_INVALID_ARG;
+
+    if (!s_done_queue) {
+        s_done_queue = xQueueCreateStatic(BOOT_MAX_STEPS, sizeof(step_done_t), s_done_storage,
+                                          &s_done_queue_buf);
+        if (!s_done_queue) return ESP_ERR_NO_MEM;
+    }
+
+    boot_step_result_t local[BOOT_MAX_STEPS];
+    boot_run_t run = {
+        .steps = steps,
+        .results = results ? results : local,
+        .on_done = on_done,
+        .user_data = user_data,
+        .t0 = esp_timer_get_time(),
+    };
+    boot_step_result_t *r = run.results;
+    for (size_t i = 0; i < count; i++) {
+        r[i] = (boot_step_result_t){.status = BOOT_STEP_PENDING};
+    }
+
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    size_t running = 0;
+
+    while (run.settled < count) {
+        // Start whatever is ready; skip whatever can no longer run (cascades)
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 0; i < count; i++) {
+                if (r[i].status != BOOT_STEP_PENDING) continue;
+                uint32_t deps = steps[i].depends_on;
+
+                if (deps & run.settled_mask & ~run.ok_mask) {
+                    r[i].start_ms = elapsed_ms(run.t0);
+                    settle(&run, i, BOOT_STEP_SKIPPED);
+                    changed = true;
+                } else if ((deps & run.ok_mask) == deps) {
+                    s_args[i] = (step_arg_t){.step = &steps[i], .index = (uint8_t)i};
+                    r[i].start_ms = elapsed_ms(run.t0);
+                    r[i].status = BOOT_STEP_RUNNING;
+                    if (xTaskCreate(step_task, steps[i].name,
+                                    steps[i].stack_size ? steps[i].stack_size : BOOT_DEFAULT_STACK,
+                                    &s_args[i], priority, NULL) != pdPASS) {
+                        r[i].err = ESP_ERR_NO_MEM;
+                        settle(&run, i, BOOT_STEP_FAILED);
+                        changed = true;
+                    } else {
+                        running++;
+                    }
+                }
+            }
+        }
+        if (run.settled == count) break;
+
+        if (running == 0) {
+            // Nothing running and nothing startable: unknown or cyclic dependencies
+            for (size_t i = 0; i < count; i++) {
+                if (r[i].status == BOOT_STEP_PENDING) {
+                    ESP_LOGE(TAG, "%s: unsatisfiable dependencies", steps[i].name);
+                    r[i].start_ms = elapsed_ms(run.t0);
+                    settle(&run, i, BOOT_STEP_SKIPPED);
+                }
+            }
+            break;
+        }
+
+        // Sleep until a step finishes or the nearest deadline
+        TickType_t wait = portMAX_DELAY;
+        uint32_t now_ms = elapsed_ms(run.t0);
+        for (size_t i = 0; i < count; i++) {
+            if (r[i].status != BOOT_STEP_RUNNING || steps[i].timeout_ms == 0) continue;
+            uint32_t deadline = r[i].start_ms + steps[i].timeout_ms;
+            TickType_t left = deadline > now_ms ? pdMS_TO_TICKS(deadline - now_ms) : 0;
+            if (left < wait) wait = left;
+        }
+
+        step_done_t done;
+        if (xQueueReceive(s_done_queue, &done, wait) == pdTRUE &&
+            done.index < count && r[done.index].status == BOOT_STEP_RUNNING) {
+            running--;
+            r[done.index].err = done.err;
+            settle(&run, done.index, done.err == ESP_OK ? BOOT_STEP_OK : BOOT_STEP_FAILED);
+        }
+
+        now_ms = elapsed_ms(run.t0);
+        for (size_t i = 0; i < count; i++) {
+            if (r[i].status == BOOT_STEP_RUNNING && steps[i].timeout_ms &&
+                now_ms >= r[i].start_ms + steps[i].timeout_ms) {
+                running--;
+                r[i].err = ESP_ERR_TIMEOUT;
+                settle(&run, i, BOOT_STEP_TIMEOUT);
+            }
+        }
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < count; i++) {
+        if (steps[i].critical && r[i].status != BOOT_STEP_OK) ret = ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Bring-up finished in %lu ms%s", (unsigned long)elapsed_ms(run.t0),
+             ret == ESP_OK ? "" : " (critical failure)");
+    return ret;
+}
@@ -0,0 +1,62 @@
+#ifndef BOOT_ORCHESTRATOR_H
+#define BOOT_ORCHESTRATOR_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOOT_MAX_STEPS 16
+
+#define BOOT_DEP(index) (1u << (index))
+
+typedef esp_err_t (*boot_step_fn_t)(void *ctx);
+
+// One bring-up step. Steps whose dependencies are met run in parallel,
+// each in its own short-lived task.
+typedef struct {
+    const char *name;
+    boot_step_fn_t run;
+    void *ctx;
+    uint32_t depends_on;          // BOOT_DEP() mask of steps that must succeed first
+    uint32_t timeout_ms;          // Reported as timed out after this (0 = no limit)
+    uint32_t stack_size;          // 0 = default
+    bool critical;                // Failure makes boot_orchestrator_run fail
+} boot_step_t;
+
+typedef enum {
+    BOOT_STEP_PENDING,
+    BOOT_STEP_RUNNING,
+    BOOT_STEP_OK,
+    BOOT_STEP_FAILED,
+    BOOT_STEP_TIMEOUT,
+    BOOT_STEP_SKIPPED             // A dependency did not succeed
+} boot_step_status_t;
+
+typedef struct {
+    boot_step_status_t status;
+    esp_err_t err;
+    uint32_t start_ms;            // Relative to boot_orchestrator_run
+    uint32_t elapsed_ms;
+} boot_step_result_t;
+
+// Called in the caller's task as each step settles (safe to draw from)
+typedef void (*boot_step_done_cb_t)(size_t index, const boot_step_t *step,
+                                    const boot_step_result_t *result, void *user_data);
+
+/**
+ * @brief Run the steps, honouring dependencies, and wait until all have settled
+ * A step that times out keeps running in the background; its late result is ignored.
+ * @param results Optional, one entry per step
+ * @return ESP_OK, or ESP_FAIL if a critical step failed, timed out or was skipped
+ */
+esp_err_t boot_orchestrator_run(const boot_step_t *steps, size_t count,
+                                boot_step_done_cb_t on_done, void *user_data,
+                                boot_step_result_t *results);
+
+/**
+ * @brief Human-readable step status
+ */
+const char *boot_step_status_name(boot_step_status_t status);
+
+#endif // BOOT_ORCHESTRATOR_H
@@ -0,0 +1,52 @@
+#include "diag_server.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "metrics.h"
+#include "trace.h"
+
+static const char *TAG = "DIAG";
+
+static httpd_handle_t s_server = NULL;
+
+static esp_err_t send_chunk(const char *data, size_t len, void *ctx) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+static esp_err_t trace_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+    esp_err_t ret = trace_dump_json(send_chunk, req);
+    if (ret != ESP_OK) return ret;   // Closes the connection mid-response
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t ret = metrics_write_prometheus(send_chunk, req);
+    if (ret != ESP_OK) return ret;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t diag_server_start(uint16_t port) {
+    if (s_server) return ESP_OK;
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.max_open_sockets = 2;
+    config.lru_purge_enable = true;
+
+    esp_err_t ret = httpd_start(&s_server, &config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start on port %u: %s", port, esp_err_to_name(ret));
+        s_server = NULL;
+        return ret;
+    }
+
+    httpd_uri_t trace_uri = {.uri = "/trace", .method = HTTP_GET, .handler = trace_handler};
+    httpd_register_uri_handler(s_server, &trace_uri);
+    httpd_uri_t metrics_uri = {.uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler};
+    httpd_register_uri_handler(s_server, &metrics_uri);
+
+    ESP_LOGI(TAG, "Diagnostics on port %u", port);
+    return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#include "diag_server.h"
+#include "esp_log.h"
+
+static const char *TAG = "DIAG";
+
+esp_err_t diag_server_start(uint16_t port) {
+    // No sockets on the host build; host_sim dumps /trace and /metrics on request
+    ESP_LOGI(TAG, "HTTP diagnostics not available on the host build");
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#ifndef DIAG_SERVER_H
+#define DIAG_SERVER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/**
+ * @brief Start the on-device diagnostics HTTP server
+ * Endpoints: GET /trace (Chrome trace-event JSON of the trace ring),
+ *            GET /metrics (Prometheus text format)
+ */
+esp_err_t diag_server_start(uint16_t port);
+
+#endif // DIAG_SERVER_H
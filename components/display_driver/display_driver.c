@@ -5,7 +5,11 @@
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mem_budget.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -22,6 +26,25 @@ struct display_driver {
     int v_res;
     int bl_pin;
 };
+static struct display_driver g_display_dev;
+
+// Every public draw holds the lock: the UI and the fingerprint preview draw
+// from different tasks, and a panel window must not be split between them
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+
+// Ping-pong: the panel IO waits for the previous colour transfer before it
+// queues the next, so one buffer can be refilled while the other is sent
+static DMA_ATTR uint16_t s_line_buf[2][DISPLAY_LINE_BUF_PIXELS];
+static int s_line_buf_next = 0;
+
+static void lock(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void) {
+    xSemaphoreGive(s_lock);
+}
 
 // --- CUSTOM 8x8 BITMAP FONT ---
 // ASCII 32 (' ') to 127 (DEL)
@@ -127,10 +150,9 @@ static const uint8_t font8x8[96][8] = {
 esp_err_t display_init(const display_config_t *config, display_handle_t *handle) {
     ESP_LOGI(TAG, "Initializing ST7789 (GMT147SPI)");
     
-    display_handle_t h = malloc(sizeof(struct display_driver));
-    if (!h) {
-        return ESP_ERR_NO_MEM;
-    }
+    display_handle_t h = &g_display_dev;
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    mem_budget_add("display", "line buffers", s_line_buf, sizeof(s_line_buf));
     
     h->h_res = config->h_res;
     h->v_res = config->v_res;
@@ -203,7 +225,7 @@ esp_err_t display_init(const display_config_t *config, display_handle_t *handle)
     return ESP_OK;
 }
 
-esp_err_t display_clear(display_handle_t handle, uint16_t color) {
+static esp_err_t clear_locked(display_handle_t handle, uint16_t color) {
     // Fill screen in chunks
     int chunk_height = 20; 
     uint16_t *buffer = malloc(handle->h_res * chunk_height * sizeof(uint16_t));
@@ -226,7 +248,7 @@ esp_err_t display_clear(display_handle_t handle, uint16_t color) {
 }
 
 // Optimized Text Drawing (Buffered)
-esp_err_t display_draw_text(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
+static esp_err_t draw_text_locked(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
     int len = strlen(text);
     int char_width = 8;
     int char_height = 16;  // 2x Scale
@@ -268,7 +290,7 @@ esp_err_t display_draw_text(display_handle_t handle, int x, int y, const char *t
 // Optimized Large Text Drawing (3x Scale)
 // Reduces size to 24x24 pixels (Scale 3) to fit screen better.
 // Keeps the robust "strip" rendering to prevent glitches.
-esp_err_t display_draw_text_large(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
+static esp_err_t draw_text_large_locked(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
     if (!handle || !text) return ESP_ERR_INVALID_ARG;
 
     int len = strlen(text);
@@ -347,7 +369,7 @@ esp_err_t display_draw_text_large(display_handle_t handle, int x, int y, const c
     return ESP_OK;
 }
 
-esp_err_t display_fill_rect(display_handle_t handle, int x, int y, int w, int h, uint16_t color) {
+static esp_err_t fill_rect_locked(display_handle_t handle, int x, int y, int w, int h, uint16_t color) {
     if (x < 0 || y < 0 || x + w > handle->h_res || y + h > handle->v_res) return ESP_ERR_INVALID_ARG;
     
     uint16_t *buffer = malloc(w * h * sizeof(uint16_t));
@@ -361,6 +383,52 @@ esp_err_t display_fill_rect(display_handle_t handle, int x, int y, int w, int h,
     return ESP_OK;
 }
 
+esp_err_t display_clear(display_handle_t handle, uint16_t color) {
+    lock();
+    esp_err_t ret = clear_locked(handle, color);
+    unlock();
+    return ret;
+}
+
+esp_err_t display_fill_rect(display_handle_t handle, int x, int y, int w, int h, uint16_t color) {
+    lock();
+    esp_err_t ret = fill_rect_locked(handle, x, y, w, h, color);
+    unlock();
+    return ret;
+}
+
+esp_err_t display_draw_text(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
+    lock();
+    esp_err_t ret = draw_text_locked(handle, x, y, text, fg_color, bg_color);
+    unlock();
+    return ret;
+}
+
+esp_err_t display_draw_text_large(display_handle_t handle, int x, int y, const char *text, uint16_t fg_color, uint16_t bg_color) {
+    lock();
+    esp_err_t ret = draw_text_large_locked(handle, x, y, text, fg_color, bg_color);
+    unlock();
+    return ret;
+}
+
+esp_err_t display_draw_bitmap(display_handle_t handle, int x, int y, int w, int h, const uint16_t *pixels) {
+    if (!handle || !pixels || w <= 0 || h <= 0 || w > DISPLAY_LINE_BUF_PIXELS) return ESP_ERR_INVALID_ARG;
+    if (x < 0 || y < 0 || x + w > handle->h_res || y + h > handle->v_res) return ESP_ERR_INVALID_ARG;
+
+    int rows_per_chunk = DISPLAY_LINE_BUF_PIXELS / w;
+    esp_err_t ret = ESP_OK;
+    lock();
+    for (int row = 0; row < h && ret == ESP_OK; row += rows_per_chunk) {
+        int rows = h - row < rows_per_chunk ? h - row : rows_per_chunk;
+        uint16_t *buf = s_line_buf[s_line_buf_next];
+        s_line_buf_next ^= 1;
+        memcpy(buf, pixels + row * w, rows * w * sizeof(uint16_t));
+        ret = esp_lcd_panel_draw_bitmap(handle->panel_handle, x, y + row, x + w, y + row + rows, buf);
+    }
+    unlock();
+    return ret;
+}
+
 esp_err_t display_set_backlight(display_handle_t handle, uint8_t brightness) {
     if (brightness > 100) brightness = 100;
     gpio_set_level(handle->bl_pin, brightness > 0 ? 1 : 0);
@@ -2,7 +2,10 @@
 #define DISPLAY_DRIVER_H
 
 #include "esp_err.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_lcd_panel_ops.h"
+#endif
 #include <stdint.h>
 
 // RGB565 Color Definitions
@@ -18,6 +21,12 @@
 #define COLOR_DARKGRAY    0x4208
 #define COLOR_ORANGE      0xFC00
 
+// RGB565 as the panel takes it over SPI (high byte first)
+#define DISPLAY_PANEL_COLOR(c) ((uint16_t)(((c) >> 8) | ((c) << 8)))
+
+// Bitmaps are sent through two line buffers of this many pixels
+#define DISPLAY_LINE_BUF_PIXELS (320 * 4)
+
 // Display Configuration
 typedef struct {
     int mosi_pin;
@@ -50,6 +59,13 @@ esp_err_t display_clear(display_handle_t handle, uint16_t color);
  */
 esp_err_t display_fill_rect(display_handle_t handle, int x, int y, int w, int h, uint16_t color);
 
+/**
+ * @brief Draw a bitmap; safe to call from any task while others draw
+ * @param pixels w x h, row-major, in panel byte order (DISPLAY_PANEL_COLOR);
+ *        copied before the call returns
+ */
+esp_err_t display_draw_bitmap(display_handle_t handle, int x, int y, int w, int h, const uint16_t *pixels);
+
 /**
  * @brief Draw text (simple 8x16 font)
  */
@@ -65,9 +81,11 @@ esp_err_t display_draw_text_large(display_handle_t handle, int x, int y, const c
  */
 esp_err_t display_set_backlight(display_handle_t handle, uint8_t brightness);
 
+#if !CONFIG_IDF_TARGET_LINUX
 /**
  * @brief Get display handle for direct panel operations
  */
 esp_lcd_panel_handle_t display_get_panel_handle(display_handle_t handle);
+#endif
 
 #endif // DISPLAY_DRIVER_H
\ No newline at end of file
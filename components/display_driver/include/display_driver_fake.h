@@ -0,0 +1,23 @@
+#ifndef DISPLAY_DRIVER_FAKE_H
+#define DISPLAY_DRIVER_FAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host build only: the simulated panel keeps a log of the text it drew
+
+#define DISPLAY_FAKE_LOG_SIZE 32
+
+/**
+ * @brief Number of text draws so far (use as a starting point for a search)
+ */
+uint32_t display_fake_draw_count(void);
+
+/**
+ * @brief Look for text drawn after the given draw count
+ * @param drawn_us esp_timer_get_time() of the first such draw (optional)
+ * @return false if not drawn, or no longer in the log
+ */
+bool display_fake_find_text(const char *text, uint32_t since, int64_t *drawn_us);
+
+#endif // DISPLAY_DRIVER_FAKE_H
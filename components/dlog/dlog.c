@@ -0,0 +1,368 @@
+#include "dlog.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mem_budget.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "DLOG";
+
+#define DLOG_TASK_STACK 3072
+#define DLOG_TASK_PRIORITY 1
+#define DLOG_LINE_MAX 512
+
+_Static_assert((DLOG_BUFFER_SIZE & (DLOG_BUFFER_SIZE - 1)) == 0, "DLOG_BUFFER_SIZE must be a power of two");
+
+// Record: u16 len | u8 level | u8 argc | u32 ms | fmt ptr | tag ptr | args,
+// each arg a type byte and its value (a string: u8 length, then the bytes).
+// Pointers are native width; the decoder takes it from the ELF class.
+enum {
+    DLOG_ARG_I32,
+    DLOG_ARG_I64,
+    DLOG_ARG_F64,
+    DLOG_ARG_STR,
+    DLOG_ARG_PTR
+};
+#define DLOG_HEADER_LEN (8 + 2 * sizeof(uintptr_t))
+
+static uint8_t s_ring[DLOG_BUFFER_SIZE];
+static uint32_t s_head = 0;         // Bytes written, free-running
+static uint32_t s_tail = 0;         // Bytes drained
+static dlog_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile bool s_raw = false;
+static SemaphoreHandle_t s_drain_lock = NULL;
+static StaticSemaphore_t s_drain_lock_buf;
+// Formats and prints only, never writes flash: PSRAM stack
+static EXT_RAM_BSS_ATTR StackType_t s_task_stack[DLOG_TASK_STACK];
+static StaticTask_t s_task;
+
+// --- Writers (any task, nothing but copies) ---
+
+static void put_bytes(dlog_record_t *r, const void *src, size_t n) {
+    memcpy(r->data + r->len, src, n);
+    r->len += n;
+}
+
+static bool put_arg(dlog_record_t *r, uint8_t type, const void *value, size_t n) {
+    if (r->len + 1 + n > DLOG_RECORD_MAX) {
+        r->data[3] |= 0x80;         // Truncated: counted at commit
+        return false;
+    }
+    r->data[r->len++] = type;
+    put_bytes(r, value, n);
+    r->data[3]++;
+    return true;
+}
+
+void dlog_begin(dlog_record_t *r, esp_log_level_t level, const char *tag, const char *fmt) {
+    uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uintptr_t fmt_addr = (uintptr_t)fmt;
+    uintptr_t tag_addr = (uintptr_t)tag;
+    r->len = 2;
+    r->data[r->len++] = (uint8_t)level;
+    r->data[r->len++] = 0;
+    put_bytes(r, &ms, sizeof(ms));
+    put_bytes(r, &fmt_addr, sizeof(fmt_addr));
+    put_bytes(r, &tag_addr, sizeof(tag_addr));
+}
+
+void dlog_put_i32(dlog_record_t *r, int32_t value) {
+    put_arg(r, DLOG_ARG_I32, &value, sizeof(value));
+}
+
+void dlog_put_i64(dlog_record_t *r, int64_t value) {
+    put_arg(r, DLOG_ARG_I64, &value, sizeof(value));
+}
+
+void dlog_put_f64(dlog_record_t *r, double value) {
+    put_arg(r, DLOG_ARG_F64, &value, sizeof(value));
+}
+
+void dlog_put_ptr(dlog_record_t *r, const void *value) {
+    uintptr_t addr = (uintptr_t)value;
+    put_arg(r, DLOG_ARG_PTR, &addr, sizeof(addr));
+}
+
+void dlog_put_str(dlog_record_t *r, const char *value) {
+    if (!value) value = "(null)";
+    size_t n = strnlen(value, DLOG_STR_MAX + 1);
+    size_t room = DLOG_RECORD_MAX - r->len;
+    if (room < 3) {
+        r->data[3] |= 0x80;
+        return;
+    }
+    if (n > DLOG_STR_MAX) {
+        n = DLOG_STR_MAX;           // Longer than a length byte can say
+        r->data[3] |= 0x80;
+    }
+    if (n > room - 2) {
+        n = room - 2;               // Keep the start of a long string
+        r->data[3] |= 0x80;
+    }
+    r->data[r->len++] = DLOG_ARG_STR;
+    r->data[r->len++] = (uint8_t)n;
+    put_bytes(r, value, n);
+    r->data[3]++;
+}
+
+static void ring_write(uint32_t pos, const uint8_t *src, size_t n) {
+    size_t off = pos & (DLOG_BUFFER_SIZE - 1);
+    size_t first = n < DLOG_BUFFER_SIZE - off ? n : DLOG_BUFFER_SIZE - off;
+    memcpy(&s_ring[off], src, first);
+    memcpy(s_ring, src + first, n - first);
+}
+
+static void ring_read(uint32_t pos, uint8_t *dst, size_t n) {
+    size_t off = pos & (DLOG_BUFFER_SIZE - 1);
+    size_t first = n < DLOG_BUFFER_SIZE - off ? n : DLOG_BUFFER_SIZE - off;
+    memcpy(dst, &s_ring[off], first);
+    memcpy(dst + first, s_ring, n - first);
+}
+
+void dlog_commit(const dlog_record_t *r) {
+    uint16_t len = r->len;
+    bool truncated = r->data[3] & 0x80;
+
+    portENTER_CRITICAL(&s_lock);
+    if (truncated) s_stats.truncated++;
+    uint32_t used = s_head - s_tail;
+    if (used + len > DLOG_BUFFER_SIZE) {
+        s_stats.dropped++;
+    } else {
+        ring_write(s_head, (const uint8_t *)&len, sizeof(len));
+        ring_write(s_head + sizeof(len), r->data + sizeof(len), len - sizeof(len));
+        s_head += len;
+        s_stats.written++;
+        if (used + len > s_stats.high_water) s_stats.high_water = used + len;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// --- Formatting (drain task) ---
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} arg_reader_t;
+
+static bool next_arg(arg_reader_t *a, uint8_t *type, const uint8_t **value, size_t *n) {
+    if (a->p >= a->end) return false;
+    *type = *a->p++;
+    switch (*type) {
+        case DLOG_ARG_I32: *n = 4; break;
+        case DLOG_ARG_I64:
+        case DLOG_ARG_F64: *n = 8; break;
+        case DLOG_ARG_PTR: *n = sizeof(uintptr_t); break;
+        case DLOG_ARG_STR:
+            if (a->p >= a->end) return false;
+            *n = *a->p++;
+            break;
+        default: return false;
+    }
+    if (a->p + *n > a->end) return false;
+    *value = a->p;
+    a->p += *n;
+    return true;
+}
+
+// Formats one conversion: spec holds "%[flags][width][.prec]" without
+// length modifiers; the stored type decides how the value is passed
+static int format_arg(char *out, size_t size, char *spec, size_t spec_len, char conv,
+                      uint8_t type, const uint8_t *value, size_t n) {
+    if (conv == 's') {
+        char str[DLOG_STR_MAX + 1];
+        if (type != DLOG_ARG_STR) return snprintf(out, size, "<?>");
+        memcpy(str, value, n);
+        str[n] = '\0';
+        memcpy(spec + spec_len, "s", 2);
+        return snprintf(out, size, spec, str);
+    }
+    if (conv == 'p' || type == DLOG_ARG_PTR) {
+        uintptr_t addr = 0;
+        memcpy(&addr, value, n < sizeof(addr) ? n : sizeof(addr));
+        return snprintf(out, size, "%p", (void *)addr);
+    }
+    if (strchr("fFeEgGaA", conv)) {
+        double d = 0;
+        if (type == DLOG_ARG_F64) memcpy(&d, value, sizeof(d));
+        spec[spec_len] = conv;
+        spec[spec_len + 1] = '\0';
+        return snprintf(out, size, spec, d);
+    }
+
+    long long v = 0;
+    if (type == DLOG_ARG_I32) {
+        int32_t i;
+        memcpy(&i, value, sizeof(i));
+        // Unsigned conversions of a 32-bit value must not sign-extend
+        v = strchr("uxXoc", conv) ? (long long)(uint32_t)i : (long long)i;
+    } else if (type == DLOG_ARG_I64) {
+        memcpy(&v, value, sizeof(v));
+    } else {
+        return snprintf(out, size, "<?>");
+    }
+    if (conv == 'c') {
+        memcpy(spec + spec_len, "c", 2);
+        return snprintf(out, size, spec, (int)v);
+    }
+    memcpy(spec + spec_len, "ll", 2);
+    spec[spec_len + 2] = conv;
+    spec[spec_len + 3] = '\0';
+    return snprintf(out, size, spec, v);
+}
+
+size_t dlog_format(const uint8_t *record, size_t len, char *out, size_t size) {
+    if (size == 0) return 0;
+    out[0] = '\0';
+    if (len < DLOG_HEADER_LEN) return 0;
+
+    const char *fmt;
+    uintptr_t fmt_addr;
+    memcpy(&fmt_addr, record + 8, sizeof(fmt_addr));
+    fmt = (const char *)fmt_addr;
+    arg_reader_t args = {.p = record + DLOG_HEADER_LEN, .end = record + len};
+
+    size_t o = 0;
+    for (const char *f = fmt; *f && o < size - 1; ) {
+        if (*f != '%') {
+            out[o++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[o++] = '%';
+            f += 2;
+            continue;
+        }
+
+        char spec[24];
+        size_t spec_len = 0;
+        spec[spec_len++] = *f++;
+        while (*f && strchr("-+ #0123456789.", *f) && spec_len < sizeof(spec) - 5) {
+            spec[spec_len++] = *f++;
+        }
+        while (*f && strchr("hlLqjzt", *f)) f++;    // The stored type decides
+        char conv = *f;
+        if (!conv) break;
+        f++;
+        spec[spec_len] = '\0';
+
+        uint8_t type;
+        const uint8_t *value;
+        size_t n;
+        int w;
+        if (next_arg(&args, &type, &value, &n)) {
+            w = format_arg(out + o, size - o, spec, spec_len, conv, type, value, n);
+        } else {
+            w = snprintf(out + o, size - o, "<missing>");
+        }
+        if (w > 0) o += (size_t)w < size - o ? (size_t)w : size - o - 1;
+    }
+    out[o] = '\0';
+    return o;
+}
+
+static char level_letter(esp_log_level_t level) {
+    switch (level) {
+        case ESP_LOG_ERROR:   return 'E';
+        case ESP_LOG_WARN:    return 'W';
+        case ESP_LOG_INFO:    return 'I';
+        case ESP_LOG_DEBUG:   return 'D';
+        case ESP_LOG_VERBOSE: return 'V';
+        default:              return '?';
+    }
+}
+
+static void emit(const uint8_t *record, size_t len) {
+    if (s_raw) {
+        static const char hex[] = "0123456789abcdef";
+        char line[5 + 2 * DLOG_RECORD_MAX + 2];
+        size_t o = 5;
+        memcpy(line, "DLOG:", 5);
+        for (size_t i = 0; i < len; i++) {
+            line[o++] = hex[record[i] >> 4];
+            line[o++] = hex[record[i] & 0x0F];
+        }
+        line[o++] = '\n';
+        line[o] = '\0';
+        fputs(line, stdout);
+        return;
+    }
+
+    esp_log_level_t level = (esp_log_level_t)record[2];
+    uint32_t ms;
+    uintptr_t tag_addr;
+    memcpy(&ms, record + 4, sizeof(ms));
+    memcpy(&tag_addr, record + 8 + sizeof(uintptr_t), sizeof(tag_addr));
+    const char *tag = (const char *)tag_addr;
+
+    char msg[DLOG_LINE_MAX];
+    dlog_format(record, len, msg, sizeof(msg));
+    // Same layout as ESP_LOGx, stamped with the time of the call, not of the print
+    esp_log_write(level, tag, "%c (%lu) %s: %s\n", level_letter(level), (unsigned long)ms, tag, msg);
+}
+
+static void drain(void) {
+    uint8_t record[DLOG_RECORD_MAX];
+
+    xSemaphoreTake(s_drain_lock, portMAX_DELAY);
+    while (1) {
+        uint16_t len = 0;
+        portENTER_CRITICAL(&s_lock);
+        if (s_head != s_tail) {
+            ring_read(s_tail, (uint8_t *)&len, sizeof(len));
+            ring_read(s_tail, record, len);
+            s_tail += len;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!len) break;
+        emit(record, len);
+    }
+    xSemaphoreGive(s_drain_lock);
+}
+
+static void dlog_task(void *arg) {
+    uint32_t reported_drops = 0;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+        drain();
+
+        dlog_stats_t stats;
+        dlog_get_stats(&stats);
+        if (stats.dropped != reported_drops) {
+            ESP_LOGW(TAG, "%lu record(s) lost to a full buffer",
+                     (unsigned long)(stats.dropped - reported_drops));
+            reported_drops = stats.dropped;
+        }
+    }
+}
+
+esp_err_t dlog_init(bool raw) {
+    if (s_drain_lock) return ESP_ERR_INVALID_STATE;
+    s_raw = raw;
+    s_drain_lock = xSemaphoreCreateMutexStatic(&s_drain_lock_buf);
+    xTaskCreateStatic(dlog_task, "dlog", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY,
+                      s_task_stack, &s_task);
+    mem_budget_add("dlog", "ring", s_ring, sizeof(s_ring));
+    mem_budget_add("dlog", "dlog stack", s_task_stack, sizeof(s_task_stack));
+    return ESP_OK;
+}
+
+void dlog_set_raw(bool raw) {
+    s_raw = raw;
+}
+
+void dlog_flush(void) {
+    if (s_drain_lock) drain();
+}
+
+void dlog_get_stats(dlog_stats_t *stats) {
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
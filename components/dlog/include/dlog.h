@@ -0,0 +1,119 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deferred logging for hot paths. DLOGx() stores the format string's
+// address, the tag and the raw arguments in a ring buffer (no formatting,
+// no UART); a low-priority task formats and prints them later, or, in raw
+// mode, prints them as hex for tools/dlog_decode.py to decode with the ELF.
+//
+// Arguments: integers, floating point, strings (copied, up to
+// DLOG_STR_MAX bytes) and void pointers. Cast other pointers to (void *).
+// At most 8 arguments; '*' widths are not supported.
+//
+// Build with -DDLOG_DEFERRED=0 to turn every DLOGx() into ESP_LOGx().
+#ifndef DLOG_DEFERRED
+#define DLOG_DEFERRED 1
+#endif
+
+#define DLOG_BUFFER_SIZE 8192       // Power of two
+#define DLOG_RECORD_MAX 320         // Larger records are cut at the last whole argument
+#define DLOG_STR_MAX 255
+#define DLOG_DRAIN_PERIOD_MS 50
+
+// Record under construction, on the caller's stack
+typedef struct {
+    uint16_t len;
+    uint8_t data[DLOG_RECORD_MAX];
+} dlog_record_t;
+
+typedef struct {
+    uint32_t written;
+    uint32_t dropped;               // Ring full, the record was lost
+    uint32_t truncated;             // Arguments left out for lack of room
+    uint32_t high_water;            // Most bytes waiting at once
+} dlog_stats_t;
+
+void dlog_begin(dlog_record_t *r, esp_log_level_t level, const char *tag, const char *fmt);
+void dlog_put_i32(dlog_record_t *r, int32_t value);
+void dlog_put_i64(dlog_record_t *r, int64_t value);
+void dlog_put_f64(dlog_record_t *r, double value);
+void dlog_put_str(dlog_record_t *r, const char *value);
+void dlog_put_ptr(dlog_record_t *r, const void *value);
+void dlog_commit(const dlog_record_t *r);
+
+#define dlog_put(r, x) _Generic((x),                                        \
+    char *: dlog_put_str, const char *: dlog_put_str,                      \
+    void *: dlog_put_ptr, const void *: dlog_put_ptr,                      \
+    float: dlog_put_f64, double: dlog_put_f64,                             \
+    long: dlog_put_i64, unsigned long: dlog_put_i64,                       \
+    long long: dlog_put_i64, unsigned long long: dlog_put_i64,             \
+    default: dlog_put_i32)((r), (x))
+
+#define DLOG_NARG_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define DLOG_NARG(...) DLOG_NARG_(_0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_PUT_0(r)
+#define DLOG_PUT_1(r, x) dlog_put(r, x);
+#define DLOG_PUT_2(r, x, ...) dlog_put(r, x); DLOG_PUT_1(r, __VA_ARGS__)
+#define DLOG_PUT_3(r, x, ...) dlog_put(r, x); DLOG_PUT_2(r, __VA_ARGS__)
+#define DLOG_PUT_4(r, x, ...) dlog_put(r, x); DLOG_PUT_3(r, __VA_ARGS__)
+#define DLOG_PUT_5(r, x, ...) dlog_put(r, x); DLOG_PUT_4(r, __VA_ARGS__)
+#define DLOG_PUT_6(r, x, ...) dlog_put(r, x); DLOG_PUT_5(r, __VA_ARGS__)
+#define DLOG_PUT_7(r, x, ...) dlog_put(r, x); DLOG_PUT_6(r, __VA_ARGS__)
+#define DLOG_PUT_8(r, x, ...) dlog_put(r, x); DLOG_PUT_7(r, __VA_ARGS__)
+
+#if DLOG_DEFERRED
+// Same filter as ESP_LOGx(): compile-time level, then the tag's run-time level
+#define DLOG_LEVEL(level, tag, fmt, ...) do {                               \
+        if ((level) <= LOG_LOCAL_LEVEL && (level) <= esp_log_level_get(tag)) { \
+            dlog_record_t dlog_rec_;                                        \
+            dlog_begin(&dlog_rec_, (level), (tag), (fmt));                  \
+            DLOG_CAT(DLOG_PUT_, DLOG_NARG(__VA_ARGS__))(&dlog_rec_, ##__VA_ARGS__) \
+            dlog_commit(&dlog_rec_);                                        \
+        }                                                                   \
+    } while (0)
+#else
+#define DLOG_LEVEL(level, tag, fmt, ...) ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__)
+#endif
+
+#define DLOGE(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define DLOGV(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief Start the drain task; records written before this are kept
+ * @param raw Print records as "DLOG:<hex>" lines for the host decoder
+ */
+esp_err_t dlog_init(bool raw);
+
+/**
+ * @brief Switch between formatted and raw output at run time
+ */
+void dlog_set_raw(bool raw);
+
+/**
+ * @brief Format every waiting record now (e.g. before a restart)
+ */
+void dlog_flush(void);
+
+/**
+ * @brief Format one record's message, without the level/time/tag prefix
+ * @return Length written (truncated to size - 1)
+ */
+size_t dlog_format(const uint8_t *record, size_t len, char *out, size_t size);
+
+/**
+ * @brief Ring counters
+ */
+void dlog_get_stats(dlog_stats_t *stats);
+
+#endif // DLOG_H
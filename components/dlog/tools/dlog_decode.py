@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+Decode raw deferred-log records ("DLOG:<hex>" lines, dlog_init(true))
+Format strings and tags are read from the firmware ELF at the addresses
+the records carry; every other line passes through unchanged.
+
+    idf.py monitor | python3 dlog_decode.py build/attendance_system.elf
+    python3 dlog_decode.py build/attendance_system.elf console.log
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+ARG_I32, ARG_I64, ARG_F64, ARG_STR, ARG_PTR = range(5)
+LEVELS = {1: 'E', 2: 'W', 3: 'I', 4: 'D', 5: 'V'}
+
+# Same conversions as dlog_format(): length modifiers are dropped, the
+# stored argument type decides
+SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|L|q|j|z|t)?([diouxXcsfFeEgGaAp%])')
+
+
+class Elf:
+    """Allocated sections of an ELF file, for reading strings by address"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError(f'{path} is not an ELF file')
+        self.is64 = self.data[4] == 2
+        self.ptr_size = 8 if self.is64 else 4
+
+        if self.is64:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x3A)
+        else:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            base = shoff + i * shentsize
+            if self.is64:
+                sh_type, flags, addr, offset, size = struct.unpack_from('<IQQQQ', self.data, base + 4)
+            else:
+                sh_type, flags, addr, offset, size = struct.unpack_from('<IIIII', self.data, base + 4)
+            if flags & SHF_ALLOC and sh_type != SHT_NOBITS and size:
+                self.sections.append((addr, size, offset))
+
+    def string(self, addr):
+        for start, size, offset in self.sections:
+            if start <= addr < start + size:
+                pos = offset + addr - start
+                end = self.data.index(b'\0', pos)
+                return self.data[pos:end].decode('utf-8', 'replace')
+        return f'<0x{addr:x}?>'
+
+
+def read_args(record, pos, ptr_size):
+    args = []
+    while pos < len(record):
+        kind = record[pos]
+        pos += 1
+        if kind == ARG_I32:
+            args.append((kind, struct.unpack_from('<i', record, pos)[0]))
+            pos += 4
+        elif kind == ARG_I64:
+            args.append((kind, struct.unpack_from('<q', record, pos)[0]))
+            pos += 8
+        elif kind == ARG_F64:
+            args.append((kind, struct.unpack_from('<d', record, pos)[0]))
+            pos += 8
+        elif kind == ARG_STR:
+            n = record[pos]
+            args.append((kind, record[pos + 1:pos + 1 + n].decode('utf-8', 'replace')))
+            pos += 1 + n
+        elif kind == ARG_PTR:
+            fmt = '<Q' if ptr_size == 8 else '<I'
+            args.append((kind, struct.unpack_from(fmt, record, pos)[0]))
+            pos += ptr_size
+        else:
+            break
+    return args
+
+
+def format_message(fmt, args):
+    args = iter(args)
+
+    def convert(match):
+        flags, conv = match.groups()
+        if conv == '%':
+            return '%'
+        arg = next(args, None)
+        if arg is None:
+            return '<missing>'
+        kind, value = arg
+        if conv == 'p' or kind == ARG_PTR:
+            return f'0x{value:x}'
+        if conv == 's':
+            return f'%{flags}s' % value if kind == ARG_STR else '<?>'
+        if conv in 'fFeEgGaA':
+            return f'%{flags}{conv if conv not in "aA" else "e"}' % (value if kind == ARG_F64 else 0.0)
+        if kind not in (ARG_I32, ARG_I64):
+            return '<?>'
+        if conv in 'uxXoc':
+            value &= 0xFFFFFFFF if kind == ARG_I32 else 0xFFFFFFFFFFFFFFFF
+        if conv == 'c':
+            return chr(value)
+        return f'%{flags}{"d" if conv in "iu" else conv}' % value
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(line, elf):
+    record = bytes.fromhex(line[5:].strip())
+    p = elf.ptr_size
+    level, = struct.unpack_from('<B', record, 2)
+    ms, = struct.unpack_from('<I', record, 4)
+    fmt_addr, tag_addr = struct.unpack_from('<QQ' if p == 8 else '<II', record, 8)
+    message = format_message(elf.string(fmt_addr), read_args(record, 8 + 2 * p, p))
+    tag = elf.string(tag_addr)
+    return f'{LEVELS.get(level, "?")} ({ms}) {tag}: {message}'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('elf', help='firmware ELF the log was produced by')
+    parser.add_argument('log', nargs='?', help='console log (default: stdin)')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    source = open(args.log, errors='replace') if args.log else sys.stdin
+    for line in source:
+        start = line.find('DLOG:')
+        if start < 0:
+            sys.stdout.write(line)
+            continue
+        try:
+            print(decode(line[start:], elf))
+        except (ValueError, struct.error) as e:
+            print(f'{line.rstrip()}  <undecodable: {e}>')
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,171 @@
+#include "event_bus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mem_budget.h"
+#include <string.h>
+
+static const char *TAG = "EVENT_BUS";
+
+_Static_assert(EVENT_BUS_POOL_SIZE <= 32, "free mask is a uint32_t");
+
+// The event comes first so a subscriber's pointer converts back to its slot
+typedef struct {
+    event_t event;
+    uint32_t refs;
+} event_slot_t;
+
+struct event_subscriber {
+    const char *name;
+    uint32_t topics;
+    uint32_t depth;
+    QueueHandle_t queue;            // const event_t *
+    StaticQueue_t queue_buf;
+    uint32_t delivered;
+    uint32_t dropped;
+};
+
+static event_slot_t s_pool[EVENT_BUS_POOL_SIZE];
+static uint32_t s_free_mask = (EVENT_BUS_POOL_SIZE == 32) ? 0xFFFFFFFFu
+                                                          : ((1u << EVENT_BUS_POOL_SIZE) - 1);
+static struct event_subscriber s_subs[EVENT_BUS_MAX_SUBSCRIBERS];
+static size_t s_sub_count = 0;
+// Queues are carved out of one static array, nothing comes from the heap
+static uint8_t s_queue_storage[EVENT_BUS_QUEUE_SLOTS * sizeof(const event_t *)];
+static size_t s_queue_slots_used = 0;
+static event_bus_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static event_slot_t *slot_alloc(void) {
+    event_slot_t *slot = NULL;
+    portENTER_CRITICAL(&s_lock);
+    if (s_free_mask) {
+        int i = __builtin_ctz(s_free_mask);
+        s_free_mask &= ~(1u << i);
+        slot = &s_pool[i];
+        if (++s_stats.slots_in_use > s_stats.slots_high_water) {
+            s_stats.slots_high_water = s_stats.slots_in_use;
+        }
+    } else {
+        s_stats.pool_exhausted++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return slot;
+}
+
+static void slot_free(event_slot_t *slot) {
+    portENTER_CRITICAL(&s_lock);
+    s_free_mask |= 1u << (slot - s_pool);
+    s_stats.slots_in_use--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t event_bus_subscribe(const char *name, uint32_t topics, size_t depth,
+                              event_subscriber_t *subscriber) {
+    if (!name || !topics || !depth || !subscriber) return ESP_ERR_INVALID_ARG;
+    if (s_sub_count >= EVENT_BUS_MAX_SUBSCRIBERS) return ESP_ERR_NO_MEM;
+
+    if (s_queue_slots_used + depth > EVENT_BUS_QUEUE_SLOTS) return ESP_ERR_NO_MEM;
+
+    if (s_sub_count == 0) {
+        mem_budget_add("event_bus", "event pool", s_pool, sizeof(s_pool));
+        mem_budget_add("event_bus", "subscriber queues", s_queue_storage,
+                       sizeof(s_queue_storage) + sizeof(s_subs));
+    }
+
+    struct event_subscriber *sub = &s_subs[s_sub_count];
+    uint8_t *storage = &s_queue_storage[s_queue_slots_used * sizeof(const event_t *)];
+    sub->queue = xQueueCreateStatic(depth, sizeof(const event_t *), storage, &sub->queue_buf);
+    if (!sub->queue) return ESP_ERR_NO_MEM;
+    s_queue_slots_used += depth;
+    sub->name = name;
+    sub->topics = topics;
+    sub->depth = depth;
+    // Publishers may already run: the entry is complete before it is counted
+    __atomic_store_n(&s_sub_count, s_sub_count + 1, __ATOMIC_RELEASE);
+
+    *subscriber = sub;
+    return ESP_OK;
+}
+
+QueueHandle_t event_bus_queue(event_subscriber_t subscriber) {
+    return subscriber ? subscriber->queue : NULL;
+}
+
+esp_err_t event_bus_publish(uint8_t topic, const void *payload, size_t len) {
+    if (topic >= 32 || len > EVENT_BUS_PAYLOAD_MAX || (len && !payload)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    event_slot_t *slot = slot_alloc();
+    if (!slot) {
+        ESP_LOGW(TAG, "Pool exhausted, topic %u lost", (unsigned)topic);
+        return ESP_ERR_NO_MEM;
+    }
+
+    event_t *ev = &slot->event;
+    ev->topic = topic;
+    ev->len = (uint16_t)len;
+    ev->published_us = esp_timer_get_time();
+    if (len) memcpy(ev->payload, payload, len);
+
+    // The publisher holds a reference until every queue has the pointer, so
+    // a fast subscriber cannot free the slot under the remaining sends
+    __atomic_store_n(&slot->refs, 1, __ATOMIC_RELAXED);
+
+    uint32_t mask = EVENT_TOPIC_MASK(topic);
+    uint32_t dropped = 0;
+    size_t sub_count = __atomic_load_n(&s_sub_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < sub_count; i++) {
+        struct event_subscriber *sub = &s_subs[i];
+        if (!(sub->topics & mask)) continue;
+
+        __atomic_add_fetch(&slot->refs, 1, __ATOMIC_RELAXED);
+        const event_t *ptr = ev;
+        if (xQueueSend(sub->queue, &ptr, 0) == pdTRUE) {
+            __atomic_add_fetch(&sub->delivered, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_sub_fetch(&slot->refs, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&sub->dropped, 1, __ATOMIC_RELAXED);
+            dropped++;
+        }
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.published++;
+    s_stats.dropped += dropped;
+    portEXIT_CRITICAL(&s_lock);
+
+    event_bus_release(ev);
+    return dropped ? ESP_FAIL : ESP_OK;
+}
+
+const event_t *event_bus_receive(event_subscriber_t subscriber, TickType_t wait) {
+    const event_t *ev = NULL;
+    if (!subscriber || xQueueReceive(subscriber->queue, &ev, wait) != pdTRUE) return NULL;
+    return ev;
+}
+
+void event_bus_release(const event_t *event) {
+    if (!event) return;
+    event_slot_t *slot = (event_slot_t *)event;
+    if (__atomic_sub_fetch(&slot->refs, 1, __ATOMIC_ACQ_REL) == 0) slot_free(slot);
+}
+
+void event_bus_get_stats(event_bus_stats_t *stats) {
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t event_bus_get_subscriber_stats(size_t index, event_subscriber_stats_t *stats) {
+    if (!stats) return ESP_ERR_INVALID_ARG;
+    if (index >= s_sub_count) return ESP_ERR_NOT_FOUND;
+
+    const struct event_subscriber *sub = &s_subs[index];
+    stats->name = sub->name;
+    stats->delivered = __atomic_load_n(&sub->delivered, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&sub->dropped, __ATOMIC_RELAXED);
+    stats->waiting = uxQueueMessagesWaiting(sub->queue);
+    stats->depth = sub->depth;
+    return ESP_OK;
+}
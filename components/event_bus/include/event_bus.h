@@ -0,0 +1,88 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVENT_BUS_POOL_SIZE 32          // Events in flight across all subscribers (max 32)
+#define EVENT_BUS_PAYLOAD_MAX 64
+#define EVENT_BUS_MAX_SUBSCRIBERS 8
+#define EVENT_BUS_QUEUE_SLOTS 64        // Queue entries shared out to all subscribers
+
+#define EVENT_TOPIC_MASK(topic) (1u << (topic))
+
+// A published event, shared read-only by every subscriber that received it
+typedef struct {
+    uint8_t topic;
+    uint16_t len;
+    int64_t published_us;               // esp_timer_get_time() at publish
+    uint8_t payload[EVENT_BUS_PAYLOAD_MAX] __attribute__((aligned(8)));
+} event_t;
+
+typedef struct event_subscriber *event_subscriber_t;
+
+typedef struct {
+    uint32_t published;
+    uint32_t pool_exhausted;            // Publishes lost because every slot was in use
+    uint32_t dropped;                   // Deliveries lost to full subscriber queues
+    uint32_t slots_in_use;
+    uint32_t slots_high_water;
+} event_bus_stats_t;
+
+typedef struct {
+    const char *name;
+    uint32_t delivered;
+    uint32_t dropped;                   // Its queue was full
+    uint32_t waiting;                   // Events queued right now
+    uint32_t depth;
+} event_subscriber_stats_t;
+
+/**
+ * @brief Register a subscriber (during start-up, from one task; events
+ *        published before it registers are not delivered to it)
+ * @param topics EVENT_TOPIC_MASK() of the topics to receive
+ * @param depth Events it may have queued before further ones are dropped
+ * @return ESP_ERR_NO_MEM once EVENT_BUS_MAX_SUBSCRIBERS or EVENT_BUS_QUEUE_SLOTS run out
+ */
+esp_err_t event_bus_subscribe(const char *name, uint32_t topics, size_t depth,
+                              event_subscriber_t *subscriber);
+
+/**
+ * @brief Underlying queue of event_t pointers, e.g. to add to a queue set
+ */
+QueueHandle_t event_bus_queue(event_subscriber_t subscriber);
+
+/**
+ * @brief Publish once: the payload is copied into a pooled slot and every
+ * subscriber of the topic receives a pointer to it (never blocks)
+ * @return ESP_ERR_NO_MEM if the pool is exhausted, ESP_FAIL if at least one
+ *         subscriber's queue was full (counted), ESP_OK otherwise
+ */
+esp_err_t event_bus_publish(uint8_t topic, const void *payload, size_t len);
+
+/**
+ * @brief Wait for the next event; NULL on timeout
+ * Every event returned must be given back with event_bus_release().
+ */
+const event_t *event_bus_receive(event_subscriber_t subscriber, TickType_t wait);
+
+/**
+ * @brief Drop this subscriber's reference; the slot is freed after the last one
+ */
+void event_bus_release(const event_t *event);
+
+/**
+ * @brief Bus-wide counters
+ */
+void event_bus_get_stats(event_bus_stats_t *stats);
+
+/**
+ * @brief Per-subscriber counters
+ * @return ESP_ERR_NOT_FOUND past the last subscriber
+ */
+esp_err_t event_bus_get_subscriber_stats(size_t index, event_subscriber_stats_t *stats);
+
+#endif // EVENT_BUS_H
@@ -0,0 +1,20 @@
+#include "fingerprint_driver.h"
+
+// Shared by the sensor driver and the host fake
+const char *fingerprint_code_name(uint8_t code) {
+    switch (code) {
+        case FP_OK:             return "ok";
+        case FP_ERROR_RECV:     return "comm";
+        case FP_NO_FINGER:      return "no_finger";
+        case FP_IMAGEFAIL:      return "image_fail";
+        case FP_IMAGEMESS:      return "image_mess";
+        case FP_FEATUREFAIL:    return "feature_fail";
+        case FP_NOMATCH:        return "no_match";
+        case FP_NOTFOUND:       return "not_found";
+        case FP_ENROLLMISMATCH: return "enroll_mismatch";
+        case FP_BADLOCATION:    return "bad_location";
+        case FP_INVALIDIMAGE:   return "invalid_image";
+        case FP_FLASH_ERR:      return "flash";
+        default:                return "other";
+    }
+}
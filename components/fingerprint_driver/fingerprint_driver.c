@@ -4,6 +4,8 @@
 #include "esp_log.h"
 #include <string.h>
 
+#define FP_PACKET_TIMEOUT_MS 200
+
 static struct fingerprint_driver {
     int uart_num;
     int tx_pin;
@@ -33,11 +35,45 @@ static void send_packet(int uart_num, uint8_t pid, uint8_t cmd, uint8_t *data, u
 static esp_err_t read_ack(int uart_num, uint8_t *confirm_code) {
     uint8_t buf[20];
     int len = uart_read_bytes(uart_num, buf, 12, pdMS_TO_TICKS(1000));
-    if (len >= 9 && buf[0] == 0xEF && buf[1] == 0x01) {
+    if (len >= 10 && buf[0] == 0xEF && buf[1] == 0x01) {
         *confirm_code = buf[9];
         return ESP_OK;
     }
-    return ESP_ERR_TIMEOUT;
+    return len > 0 ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_TIMEOUT;
+}
+
+// One packet after a command's acknowledgement: header, payload, checksum
+static esp_err_t read_packet(int uart_num, uint8_t *pid, uint8_t *payload, size_t *len) {
+    TickType_t wait = pdMS_TO_TICKS(FP_PACKET_TIMEOUT_MS);
+    uint8_t head[9];
+    if (uart_read_bytes(uart_num, head, sizeof(head), wait) != sizeof(head)) return ESP_ERR_TIMEOUT;
+    if (head[0] != 0xEF || head[1] != 0x01) return ESP_ERR_INVALID_RESPONSE;
+
+    uint16_t packet_len = (head[7] << 8) | head[8];
+    if (packet_len < 2 || packet_len - 2 > FP_PACKET_DATA_MAX) return ESP_ERR_INVALID_RESPONSE;
+    int n = packet_len - 2;
+    uint8_t sum[2];
+    if ((n && uart_read_bytes(uart_num, payload, n, wait) != n) ||
+        uart_read_bytes(uart_num, sum, 2, wait) != 2) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint16_t checksum = head[6] + head[7] + head[8];
+    for (int i = 0; i < n; i++) checksum += payload[i];
+    if (checksum != ((sum[0] << 8) | sum[1])) return ESP_ERR_INVALID_CRC;
+    *pid = head[6];
+    *len = n;
+    return ESP_OK;
+}
+
+// One command answered by a plain acknowledgement
+static fp_result_t command(uint8_t cmd, uint8_t *data, uint16_t data_len) {
+    uart_flush_input(g_fp_dev.uart_num);
+    send_packet(g_fp_dev.uart_num, 0x01, cmd, data, data_len);
+    fp_result_t r = {.code = FP_ERROR_RECV};
+    r.err = read_ack(g_fp_dev.uart_num, &r.code);
+    if (r.err == ESP_OK && r.code != FP_OK) r.err = ESP_FAIL;
+    return r;
 }
 
 esp_err_t fingerprint_init(const fingerprint_config_t *config, fingerprint_handle_t *handle) {
@@ -47,7 +83,8 @@ esp_err_t fingerprint_init(const fingerprint_config_t *config, fingerprint_handl
         .parity = UART_PARITY_DISABLE, .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE, .source_clk = UART_SCLK_DEFAULT
     };
-    ESP_ERROR_CHECK(uart_driver_install(config->uart_num, 1024, 0, 0, NULL, 0));
+    // Room for a few image packets while the consumer draws
+    ESP_ERROR_CHECK(uart_driver_install(config->uart_num, 2048, 0, 0, NULL, 0));
     ESP_ERROR_CHECK(uart_param_config(config->uart_num, &uart_cfg));
     ESP_ERROR_CHECK(uart_set_pin(config->uart_num, config->tx_pin, config->rx_pin, -1, -1));
 
@@ -59,18 +96,55 @@ esp_err_t fingerprint_init(const fingerprint_config_t *config, fingerprint_handl
     return ESP_OK;
 }
 
+fp_result_t fingerprint_get_image_ex(fingerprint_handle_t handle) {
+    return command(FP_CMD_GETIMAGE, NULL, 0);
+}
+
 esp_err_t fingerprint_get_image(fingerprint_handle_t handle) {
-    uart_flush_input(g_fp_dev.uart_num);
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_GETIMAGE, NULL, 0);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    return fingerprint_get_image_ex(handle).err;
+}
+
+fp_result_t fingerprint_image_to_tz_ex(fingerprint_handle_t handle, uint8_t buffer_id) {
+    return command(FP_CMD_IMAGE2TZ, &buffer_id, 1);
 }
 
 esp_err_t fingerprint_image_to_tz(fingerprint_handle_t handle, uint8_t buffer_id) {
-    uart_flush_input(g_fp_dev.uart_num);
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_IMAGE2TZ, &buffer_id, 1);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    return fingerprint_image_to_tz_ex(handle, buffer_id).err;
+}
+
+esp_err_t fingerprint_upload_image(fingerprint_handle_t handle, fingerprint_image_sink_t sink, void *ctx) {
+    if (!sink) return ESP_ERR_INVALID_ARG;
+    fp_result_t r = command(FP_CMD_UPLOADIMAGE, NULL, 0);
+    if (r.err != ESP_OK) return r.err;
+
+    // The sensor sends the whole image regardless: after a sink error the
+    // rest is read and dropped so the next command starts clean
+    uint8_t payload[FP_PACKET_DATA_MAX];
+    esp_err_t sink_ret = ESP_OK;
+    while (1) {
+        uint8_t pid;
+        size_t len;
+        esp_err_t ret = read_packet(g_fp_dev.uart_num, &pid, payload, &len);
+        if (ret != ESP_OK) return ret;
+        if (pid != FP_PID_DATA && pid != FP_PID_END) return ESP_ERR_INVALID_RESPONSE;
+        if (sink_ret == ESP_OK) sink_ret = sink(payload, len, ctx);
+        if (pid == FP_PID_END) return sink_ret;
+    }
+}
+
+esp_err_t fingerprint_set_baud_rate(fingerprint_handle_t handle, int baud_rate) {
+    if (baud_rate < 9600 || baud_rate > 115200 || baud_rate % 9600) return ESP_ERR_INVALID_ARG;
+    uint8_t data[] = {4, (uint8_t)(baud_rate / 9600)};     // Parameter 4: baud rate N x 9600
+    esp_err_t ret = command(FP_CMD_SETSYSPARAM, data, 2).err;
+    if (ret != ESP_OK) return ret;
+    // The acknowledgement still comes at the old rate
+    return fingerprint_set_uart_baud_rate(handle, baud_rate);
+}
+
+esp_err_t fingerprint_set_uart_baud_rate(fingerprint_handle_t handle, int baud_rate) {
+    esp_err_t ret = uart_set_baudrate(g_fp_dev.uart_num, baud_rate);
+    if (ret == ESP_OK) g_fp_dev.baud_rate = baud_rate;
+    return ret;
 }
 
 esp_err_t fingerprint_search(fingerprint_handle_t handle, uint16_t *id, uint16_t *score) {
@@ -86,32 +160,51 @@ esp_err_t fingerprint_search(fingerprint_handle_t handle, uint16_t *id, uint16_t
     return ESP_FAIL;
 }
 
-esp_err_t fingerprint_create_model(fingerprint_handle_t handle) {
+esp_err_t fingerprint_load_model(fingerprint_handle_t handle, uint8_t buffer_id, uint16_t loc) {
+    uint8_t data[] = {buffer_id, (uint8_t)(loc >> 8), (uint8_t)(loc & 0xFF)};
+    return command(FP_CMD_LOAD, data, 3).err;
+}
+
+esp_err_t fingerprint_match(fingerprint_handle_t handle, uint16_t *score) {
     uart_flush_input(g_fp_dev.uart_num);
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_REGMODEL, NULL, 0);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_MATCH, NULL, 0);
+    // Header(6) + PID(1) + Len(2) + Confirm(1) + Score(2) + Checksum(2)
+    uint8_t buf[14];
+    if (uart_read_bytes(g_fp_dev.uart_num, buf, sizeof(buf), pdMS_TO_TICKS(1000)) >= 12 &&
+        buf[0] == 0xEF && buf[1] == 0x01 && buf[9] == FP_OK) {
+        *score = (buf[10] << 8) | buf[11];
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t fingerprint_create_model(fingerprint_handle_t handle) {
+    return command(FP_CMD_REGMODEL, NULL, 0).err;
 }
 
 esp_err_t fingerprint_store_model(fingerprint_handle_t handle, uint16_t loc) {
-    uart_flush_input(g_fp_dev.uart_num);
     uint8_t data[] = {0x01, (uint8_t)(loc >> 8), (uint8_t)(loc & 0xFF)};
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_STORE, data, 3);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    return command(FP_CMD_STORE, data, 3).err;
 }
 
 esp_err_t fingerprint_delete_model(fingerprint_handle_t handle, uint16_t loc) {
-    uart_flush_input(g_fp_dev.uart_num);
     uint8_t data[] = {(uint8_t)(loc >> 8), (uint8_t)(loc & 0xFF), 0x00, 0x01};
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_DELETE, data, 4);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    return command(FP_CMD_DELETE, data, 4).err;
 }
 
-esp_err_t fingerprint_self_test(fingerprint_handle_t handle) {
+esp_err_t fingerprint_read_index(fingerprint_handle_t handle, uint8_t page, uint8_t index[32]) {
     uart_flush_input(g_fp_dev.uart_num);
-    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_READSYSPARAM, NULL, 0);
-    uint8_t code;
-    return (read_ack(g_fp_dev.uart_num, &code) == ESP_OK && code == FP_OK) ? ESP_OK : ESP_FAIL;
+    send_packet(g_fp_dev.uart_num, 0x01, FP_CMD_READINDEX, &page, 1);
+    // Header(6) + PID(1) + Len(2) + Confirm(1) + Index(32) + Checksum(2)
+    uint8_t buf[44];
+    if (uart_read_bytes(g_fp_dev.uart_num, buf, sizeof(buf), pdMS_TO_TICKS(1000)) == sizeof(buf) &&
+        buf[0] == 0xEF && buf[1] == 0x01 && buf[9] == FP_OK) {
+        memcpy(index, &buf[10], 32);
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t fingerprint_self_test(fingerprint_handle_t handle) {
+    return command(FP_CMD_READSYSPARAM, NULL, 0).err;
 }
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "fingerprint_driver.h"
+#include "fingerprint_driver_fake.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "FP_FAKE";
+
+#define FP_FAKE_SLOTS 256
+#define FP_FAKE_NO_FINGER 0xFFFE
+
+// Roughly an R307S at 57600 baud
+static fingerprint_fake_timing_t s_timing = {
+    .get_image_ms = 60, .image_to_tz_ms = 250, .search_ms = 150, .store_ms = 120,
+    .load_ms = 40, .match_ms = 30,
+};
+
+// Fingers are plain numbers; a slot holds the finger enrolled into it
+struct fingerprint_driver {
+    uint16_t slots[FP_FAKE_SLOTS];      // Finger per slot, FP_FAKE_NO_FINGER = empty
+    volatile uint16_t finger;           // On the sensor now
+    uint16_t image;                     // Last captured image
+    fingerprint_fake_image_t image_kind;
+    uint16_t buffers[2];                // Character buffers 1 and 2
+    uint16_t model;                     // Result of create_model
+};
+static struct fingerprint_driver g_fp_dev;
+static bool s_ready = false;
+static int s_baud_rate = 57600;
+static volatile uint8_t s_fault = FP_OK;
+static volatile uint32_t s_fault_count = 0;
+static volatile fingerprint_fake_image_t s_image_kind = FP_FAKE_IMAGE_GOOD;
+static volatile uint32_t s_image_count = 0;
+
+// Template of a poor image: converts, but matches no slot
+#define FP_FAKE_POOR_TEMPLATE 0xFFFD
+
+static void reset_state(void) {
+    if (s_ready) return;
+    for (int i = 0; i < FP_FAKE_SLOTS; i++) g_fp_dev.slots[i] = FP_FAKE_NO_FINGER;
+    g_fp_dev.finger = FP_FAKE_NO_FINGER;
+    g_fp_dev.image = FP_FAKE_NO_FINGER;
+    g_fp_dev.buffers[0] = g_fp_dev.buffers[1] = FP_FAKE_NO_FINGER;
+    g_fp_dev.model = FP_FAKE_NO_FINGER;
+    s_ready = true;
+}
+
+static void busy(uint32_t ms) {
+    if (ms) vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void fingerprint_fake_place_finger(uint16_t id) {
+    g_fp_dev.finger = id;
+}
+
+void fingerprint_fake_lift_finger(void) {
+    g_fp_dev.finger = FP_FAKE_NO_FINGER;
+}
+
+esp_err_t fingerprint_fake_enroll(uint16_t id) {
+    if (id >= FP_FAKE_SLOTS) return ESP_ERR_INVALID_ARG;
+    reset_state();
+    g_fp_dev.slots[id] = id;
+    return ESP_OK;
+}
+
+void fingerprint_fake_set_fault(uint8_t code, uint32_t count) {
+    s_fault_count = count;
+    s_fault = code;
+}
+
+void fingerprint_fake_set_image(fingerprint_fake_image_t kind, uint32_t count) {
+    s_image_count = count;
+    s_image_kind = kind;
+}
+
+void fingerprint_fake_set_timing(const fingerprint_fake_timing_t *timing) {
+    s_timing = *timing;
+}
+
+esp_err_t fingerprint_init(const fingerprint_config_t *config, fingerprint_handle_t *handle) {
+    if (!config || !handle) return ESP_ERR_INVALID_ARG;
+    reset_state();
+    s_baud_rate = config->baud_rate;
+    *handle = &g_fp_dev;
+    ESP_LOGI(TAG, "Simulated sensor ready");
+    return ESP_OK;
+}
+
+static fp_result_t result(uint8_t code) {
+    return (fp_result_t){.err = code == FP_OK ? ESP_OK : ESP_FAIL, .code = code};
+}
+
+// A dead link costs the driver's full read timeout
+static bool link_down(fp_result_t *r) {
+    if (s_fault != FP_ERROR_RECV) return false;
+    busy(1000);
+    *r = (fp_result_t){.err = ESP_ERR_TIMEOUT, .code = FP_ERROR_RECV};
+    return true;
+}
+
+fp_result_t fingerprint_get_image_ex(fingerprint_handle_t handle) {
+    fp_result_t r;
+    if (link_down(&r)) return r;
+    busy(s_timing.get_image_ms);
+    uint16_t finger = handle->finger;
+    if (finger == FP_FAKE_NO_FINGER) return result(FP_NO_FINGER);
+    handle->image = finger;
+    handle->image_kind = FP_FAKE_IMAGE_GOOD;
+    if (s_image_count) {
+        handle->image_kind = s_image_kind;
+        s_image_count--;
+    }
+    return result(FP_OK);
+}
+
+esp_err_t fingerprint_get_image(fingerprint_handle_t handle) {
+    return fingerprint_get_image_ex(handle).err;
+}
+
+fp_result_t fingerprint_image_to_tz_ex(fingerprint_handle_t handle, uint8_t buffer_id) {
+    fp_result_t r;
+    if (buffer_id < 1 || buffer_id > 2) return (fp_result_t){.err = ESP_ERR_INVALID_ARG};
+    if (link_down(&r)) return r;
+    busy(s_timing.image_to_tz_ms);
+    if (s_fault != FP_OK && s_fault_count) {
+        uint8_t code = s_fault;
+        if (--s_fault_count == 0) s_fault = FP_OK;
+        return result(code);
+    }
+    if (handle->image == FP_FAKE_NO_FINGER) return result(FP_FEATUREFAIL);
+    handle->buffers[buffer_id - 1] =
+        handle->image_kind == FP_FAKE_IMAGE_GOOD ? handle->image : FP_FAKE_POOR_TEMPLATE;
+    return result(FP_OK);
+}
+
+esp_err_t fingerprint_image_to_tz(fingerprint_handle_t handle, uint8_t buffer_id) {
+    return fingerprint_image_to_tz_ex(handle, buffer_id).err;
+}
+
+// A finger is an ellipse of concentric ridges, their spacing set by the
+// finger number; outside it the sensor reads bright background. A partial
+// finger is centred on the corner, a faint one has grey ridges, a smudged
+// one ridges three times as wide.
+static uint8_t image_pixel(uint16_t finger, fingerprint_fake_image_t kind, int x, int y) {
+    bool corner = kind == FP_FAKE_IMAGE_PARTIAL;
+    int dx = x - (corner ? 0 : FP_IMAGE_WIDTH / 2);
+    int dy = (y - (corner ? 0 : FP_IMAGE_HEIGHT / 2)) * 8 / 10;
+    int r2 = dx * dx + dy * dy;
+    if (finger == FP_FAKE_NO_FINGER || r2 > 110 * 110) return 14;
+    int period = (7 + finger % 5) * (kind == FP_FAKE_IMAGE_SMUDGED ? 3 : 1);
+    int r = 0;
+    while ((r + 1) * (r + 1) <= r2) r++;
+    bool ridge = (r % period) < period / 2;
+    if (kind == FP_FAKE_IMAGE_FAINT) return ridge ? 7 : 9;
+    return ridge ? 2 : 12;
+}
+
+esp_err_t fingerprint_upload_image(fingerprint_handle_t handle, fingerprint_image_sink_t sink, void *ctx) {
+    if (!sink) return ESP_ERR_INVALID_ARG;
+    if (s_fault == FP_ERROR_RECV) {
+        busy(1000);
+        return ESP_ERR_TIMEOUT;
+    }
+    // One 128-byte packet per row; wire time at the current rate (+11 bytes framing)
+    uint32_t packet_ms = (FP_IMAGE_ROW_BYTES + 11) * 10 * 1000 / s_baud_rate;
+    uint8_t row[FP_IMAGE_ROW_BYTES];
+    esp_err_t ret = ESP_OK;
+    for (int y = 0; y < FP_IMAGE_HEIGHT; y++) {
+        busy(packet_ms);
+        if (ret != ESP_OK) continue;
+        for (int x = 0; x < FP_IMAGE_WIDTH; x += 2) {
+            row[x / 2] = (image_pixel(handle->image, handle->image_kind, x, y) << 4) |
+                         image_pixel(handle->image, handle->image_kind, x + 1, y);
+        }
+        ret = sink(row, sizeof(row), ctx);
+    }
+    return ret;
+}
+
+esp_err_t fingerprint_set_baud_rate(fingerprint_handle_t handle, int baud_rate) {
+    if (baud_rate < 9600 || baud_rate > 115200 || baud_rate % 9600) return ESP_ERR_INVALID_ARG;
+    return fingerprint_set_uart_baud_rate(handle, baud_rate);
+}
+
+esp_err_t fingerprint_set_uart_baud_rate(fingerprint_handle_t handle, int baud_rate) {
+    s_baud_rate = baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_search(fingerprint_handle_t handle, uint16_t *fingerprint_id, uint16_t *score) {
+    busy(s_timing.search_ms);
+    uint16_t finger = handle->buffers[0];
+    if (finger == FP_FAKE_NO_FINGER) return ESP_FAIL;
+    for (int slot = 0; slot < FP_FAKE_SLOTS; slot++) {
+        if (handle->slots[slot] == finger) {
+            *fingerprint_id = (uint16_t)slot;
+            *score = 150;
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t fingerprint_load_model(fingerprint_handle_t handle, uint8_t buffer_id, uint16_t location) {
+    if (buffer_id < 1 || buffer_id > 2) return ESP_ERR_INVALID_ARG;
+    busy(s_timing.load_ms);
+    if (location >= FP_FAKE_SLOTS || handle->slots[location] == FP_FAKE_NO_FINGER) return ESP_FAIL;
+    handle->buffers[buffer_id - 1] = handle->slots[location];
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_match(fingerprint_handle_t handle, uint16_t *score) {
+    busy(s_timing.match_ms);
+    if (handle->buffers[0] == FP_FAKE_NO_FINGER || handle->buffers[0] != handle->buffers[1]) {
+        return ESP_FAIL;
+    }
+    *score = 150;
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_create_model(fingerprint_handle_t handle) {
+    busy(s_timing.image_to_tz_ms);
+    // Both captures must be the same finger
+    if (handle->buffers[0] == FP_FAKE_NO_FINGER || handle->buffers[0] != handle->buffers[1]) {
+        return ESP_FAIL;
+    }
+    handle->model = handle->buffers[0];
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_store_model(fingerprint_handle_t handle, uint16_t location) {
+    busy(s_timing.store_ms);
+    if (location >= FP_FAKE_SLOTS || handle->model == FP_FAKE_NO_FINGER) return ESP_FAIL;
+    handle->slots[location] = handle->model;
+    ESP_LOGI(TAG, "Stored template in slot %u", location);
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_get_template_count(fingerprint_handle_t handle, uint16_t *count) {
+    uint16_t n = 0;
+    for (int slot = 0; slot < FP_FAKE_SLOTS; slot++) n += handle->slots[slot] != FP_FAKE_NO_FINGER;
+    *count = n;
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_delete_model(fingerprint_handle_t handle, uint16_t location) {
+    busy(s_timing.store_ms);
+    if (location >= FP_FAKE_SLOTS) return ESP_FAIL;
+    handle->slots[location] = FP_FAKE_NO_FINGER;
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_empty_database(fingerprint_handle_t handle) {
+    for (int slot = 0; slot < FP_FAKE_SLOTS; slot++) handle->slots[slot] = FP_FAKE_NO_FINGER;
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_read_index(fingerprint_handle_t handle, uint8_t page, uint8_t index[32]) {
+    memset(index, 0, 32);
+    for (int bit = 0; bit < 256; bit++) {
+        int slot = page * 256 + bit;
+        if (slot < FP_FAKE_SLOTS && handle->slots[slot] != FP_FAKE_NO_FINGER) {
+            index[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t fingerprint_self_test(fingerprint_handle_t handle) {
+    return ESP_OK;
+}
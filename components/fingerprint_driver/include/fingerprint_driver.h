@@ -2,6 +2,7 @@
 #define FINGERPRINT_DRIVER_H
 
 #include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 
 // R307S Command Codes
@@ -21,6 +22,19 @@
 #define FP_CMD_SETSYSPARAM      0x0E
 #define FP_CMD_READSYSPARAM     0x0F
 #define FP_CMD_TEMPLATECOUNT    0x1D
+#define FP_CMD_READINDEX        0x1F
+
+// Packet Identifiers
+#define FP_PID_COMMAND          0x01
+#define FP_PID_DATA             0x02
+#define FP_PID_ACK              0x07
+#define FP_PID_END              0x08    // Last data packet
+
+// Image buffer: 256x288, 4 bits per pixel, two pixels per byte (high nibble first)
+#define FP_IMAGE_WIDTH          256
+#define FP_IMAGE_HEIGHT         288
+#define FP_IMAGE_ROW_BYTES      (FP_IMAGE_WIDTH / 2)
+#define FP_PACKET_DATA_MAX      256
 
 // Confirmation Codes
 #define FP_OK                   0x00
@@ -42,6 +56,14 @@
 #define FP_ADDRCODE             0x20
 #define FP_PASSVERIFY           0x21
 
+// Outcome of one sensor command. err is ESP_OK, ESP_FAIL when the sensor
+// answered with a non-OK code, or ESP_ERR_TIMEOUT / ESP_ERR_INVALID_RESPONSE
+// when no valid answer came back (code is then FP_ERROR_RECV).
+typedef struct {
+    esp_err_t err;
+    uint8_t code;           // Confirmation code, FP_OK ... FP_PASSVERIFY
+} fp_result_t;
+
 // Fingerprint Driver Configuration
 typedef struct {
     int uart_num;
@@ -54,6 +76,10 @@ typedef struct {
 // Fingerprint Driver Handle
 typedef struct fingerprint_driver* fingerprint_handle_t;
 
+// Receives an uploaded image in order, one data packet at a time; anything
+// but ESP_OK stops delivery (the rest of the upload is still drained)
+typedef esp_err_t (*fingerprint_image_sink_t)(const uint8_t *data, size_t len, void *ctx);
+
 /**
  * @brief Initialize fingerprint sensor
  */
@@ -64,17 +90,44 @@ esp_err_t fingerprint_init(const fingerprint_config_t *config, fingerprint_handl
  */
 esp_err_t fingerprint_get_image(fingerprint_handle_t handle);
 
+/**
+ * @brief Capture fingerprint image, keeping the sensor's answer
+ * @return code FP_NO_FINGER when nothing is on the sensor, FP_IMAGEFAIL
+ *         when imaging failed
+ */
+fp_result_t fingerprint_get_image_ex(fingerprint_handle_t handle);
+
 /**
  * @brief Convert image to template (buffer 1 or 2)
  */
 esp_err_t fingerprint_image_to_tz(fingerprint_handle_t handle, uint8_t buffer_id);
 
+/**
+ * @brief Convert image to template, keeping the sensor's answer
+ * @return code FP_IMAGEMESS / FP_FEATUREFAIL / FP_INVALIDIMAGE when the
+ *         finger was badly placed
+ */
+fp_result_t fingerprint_image_to_tz_ex(fingerprint_handle_t handle, uint8_t buffer_id);
+
 /**
  * @brief Search for fingerprint in database
  * @return ESP_OK if found, fingerprint_id populated
  */
 esp_err_t fingerprint_search(fingerprint_handle_t handle, uint16_t *fingerprint_id, uint16_t *score);
 
+/**
+ * @brief Load a stored template from flash into a character buffer (1 or 2)
+ * @return ESP_FAIL if the slot is empty or cannot be read
+ */
+esp_err_t fingerprint_load_model(fingerprint_handle_t handle, uint8_t buffer_id, uint16_t location);
+
+/**
+ * @brief Match character buffer 1 against buffer 2 (1:1 verification)
+ * @return ESP_OK if they match, score populated; takes the same time
+ *         whatever the size of the library
+ */
+esp_err_t fingerprint_match(fingerprint_handle_t handle, uint16_t *score);
+
 /**
  * @brief Create model from two templates
  */
@@ -100,6 +153,37 @@ esp_err_t fingerprint_delete_model(fingerprint_handle_t handle, uint16_t locatio
  */
 esp_err_t fingerprint_empty_database(fingerprint_handle_t handle);
 
+/**
+ * @brief Read the template index table (which slots hold a template)
+ * @param page Index page (0 covers slots 0-255)
+ * @param index Output bitmap, 32 bytes, bit n of byte k set = slot k*8+n used
+ */
+esp_err_t fingerprint_read_index(fingerprint_handle_t handle, uint8_t page, uint8_t index[32]);
+
+/**
+ * @brief Stream the image buffer (last capture) to sink as packets arrive
+ * @return ESP_OK, the sink's error, or ESP_ERR_TIMEOUT / ESP_ERR_INVALID_CRC
+ *         / ESP_ERR_INVALID_RESPONSE on a link error
+ */
+esp_err_t fingerprint_upload_image(fingerprint_handle_t handle, fingerprint_image_sink_t sink, void *ctx);
+
+/**
+ * @brief Switch the sensor to another baud rate, then follow it
+ * @param baud_rate Multiple of 9600, up to 115200
+ * @note The sensor keeps the rate across power cycles
+ */
+esp_err_t fingerprint_set_baud_rate(fingerprint_handle_t handle, int baud_rate);
+
+/**
+ * @brief Change only the local UART rate, to find a sensor left at another rate
+ */
+esp_err_t fingerprint_set_uart_baud_rate(fingerprint_handle_t handle, int baud_rate);
+
+/**
+ * @brief Short name of a confirmation code, for logs and metrics labels
+ */
+const char *fingerprint_code_name(uint8_t code);
+
 /**
  * @brief Self-test: Checks if sensor is connected and communicating
  * @return ESP_OK on success, ESP_FAIL otherwise
@@ -0,0 +1,67 @@
+#ifndef FINGERPRINT_DRIVER_FAKE_H
+#define FINGERPRINT_DRIVER_FAKE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// Host build only: controls for the simulated sensor. Fingers are
+// numbers; fingerprint_fake_enroll(n) pre-enrolls finger n into slot n,
+// enrolling through the firmware stores whichever finger is placed.
+
+#define FP_FAKE_UNKNOWN_FINGER 0xFFFF   // Matches nothing unless enrolled on the device
+
+// What the next captures look like, for the image quality check
+typedef enum {
+    FP_FAKE_IMAGE_GOOD,
+    FP_FAKE_IMAGE_PARTIAL,      // Finger on the edge of the glass
+    FP_FAKE_IMAGE_FAINT,        // Dry finger: little contrast
+    FP_FAKE_IMAGE_SMUDGED,      // Wet finger: ridges run together
+} fingerprint_fake_image_t;
+
+// Time each command takes on the wire plus in the sensor
+typedef struct {
+    uint32_t get_image_ms;
+    uint32_t image_to_tz_ms;
+    uint32_t search_ms;
+    uint32_t store_ms;
+    uint32_t load_ms;
+    uint32_t match_ms;
+} fingerprint_fake_timing_t;
+
+/**
+ * @brief Put a finger on the sensor; it stays there until lifted
+ * @param id Finger number, or FP_FAKE_UNKNOWN_FINGER
+ */
+void fingerprint_fake_place_finger(uint16_t id);
+
+/**
+ * @brief Take the finger off the sensor
+ */
+void fingerprint_fake_lift_finger(void);
+
+/**
+ * @brief Enroll finger id into slot id (before or while the firmware runs)
+ */
+esp_err_t fingerprint_fake_enroll(uint16_t id);
+
+/**
+ * @brief Make the next image conversions fail with a confirmation code
+ * @param code e.g. FP_IMAGEMESS for a badly placed finger; FP_ERROR_RECV
+ *        makes captures time out instead (a dead link) until FP_OK
+ * @param count Conversions to fail (ignored for FP_ERROR_RECV)
+ */
+void fingerprint_fake_set_fault(uint8_t code, uint32_t count);
+
+/**
+ * @brief Make the next captured images poor; they still convert, but
+ *        their templates match nothing (a false reject without the check)
+ * @param count Captures affected, after which images are good again
+ */
+void fingerprint_fake_set_image(fingerprint_fake_image_t kind, uint32_t count);
+
+/**
+ * @brief Replace the simulated command timings
+ */
+void fingerprint_fake_set_timing(const fingerprint_fake_timing_t *timing);
+
+#endif // FINGERPRINT_DRIVER_FAKE_H
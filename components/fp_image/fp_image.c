@@ -0,0 +1,129 @@
+#include "fp_image.h"
+#include "esp_log.h"
+#include "mem_budget.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "FP_IMAGE";
+
+// Sum of a 2x2 block of 4-bit pixels (0..60) to a grey panel colour
+static uint16_t s_gray[61];
+static bool s_gray_ready = false;
+
+static void build_gray_table(void) {
+    for (int sum = 0; sum <= 60; sum++) {
+        uint16_t v = sum * 17 / 4;              // 0..255
+        uint16_t rgb = ((v >> 3) << 11) | ((v >> 2) << 5) | (v >> 3);
+        s_gray[sum] = DISPLAY_PANEL_COLOR(rgb);
+    }
+    s_gray_ready = true;
+}
+
+void fp_image_decimate_rows(const uint8_t *rows, uint16_t *out) {
+    if (!s_gray_ready) build_gray_table();
+    const uint8_t *upper = rows;
+    const uint8_t *lower = rows + FP_IMAGE_ROW_BYTES;
+    // One byte holds the two horizontal pixels of a block
+    for (int i = 0; i < FP_PREVIEW_W; i++) {
+        uint8_t a = upper[i];
+        uint8_t b = lower[i];
+        out[i] = s_gray[(a >> 4) + (a & 0x0F) + (b >> 4) + (b & 0x0F)];
+    }
+}
+
+typedef struct {
+    display_handle_t display;                   // NULL: no preview
+    int x;
+    int y;
+    uint8_t rows[2 * FP_IMAGE_ROW_BYTES];       // Row pair being filled
+    size_t fill;
+    uint16_t strip[FP_PREVIEW_STRIP_ROWS * FP_PREVIEW_W];
+    int strip_rows;
+    int drawn_rows;
+    fp_quality_acc_t *quality;                  // NULL: no quality check
+    uint8_t band[FP_QUALITY_BAND_BYTES];        // Block row being filled
+    size_t band_fill;
+} inspect_t;
+
+static esp_err_t flush_strip(inspect_t *p) {
+    if (!p->strip_rows) return ESP_OK;
+    esp_err_t ret = display_draw_bitmap(p->display, p->x, p->y + p->drawn_rows, FP_PREVIEW_W,
+                                        p->strip_rows, p->strip);
+    p->drawn_rows += p->strip_rows;
+    p->strip_rows = 0;
+    return ret;
+}
+
+static esp_err_t preview_bytes(inspect_t *p, const uint8_t *data, size_t len) {
+    while (len) {
+        size_t n = sizeof(p->rows) - p->fill;
+        if (n > len) n = len;
+        memcpy(p->rows + p->fill, data, n);
+        p->fill += n;
+        data += n;
+        len -= n;
+        if (p->fill < sizeof(p->rows)) break;
+
+        p->fill = 0;
+        if (p->drawn_rows + p->strip_rows >= FP_PREVIEW_H) continue;   // Longer than expected
+        fp_image_decimate_rows(p->rows, &p->strip[p->strip_rows * FP_PREVIEW_W]);
+        if (++p->strip_rows == FP_PREVIEW_STRIP_ROWS) {
+            esp_err_t ret = flush_strip(p);
+            if (ret != ESP_OK) return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static void quality_bytes(inspect_t *p, const uint8_t *data, size_t len) {
+    while (len) {
+        size_t n = sizeof(p->band) - p->band_fill;
+        if (n > len) n = len;
+        memcpy(p->band + p->band_fill, data, n);
+        p->band_fill += n;
+        data += n;
+        len -= n;
+        if (p->band_fill < sizeof(p->band)) break;
+
+        p->band_fill = 0;
+        if (p->quality->blocks < FP_QUALITY_BLOCKS_X * FP_QUALITY_BLOCKS_Y) {
+            fp_quality_add_band(p->quality, p->band);
+        }
+    }
+}
+
+// Packets need not line up with rows: bytes are gathered into row pairs
+// for the preview and into block rows for the quality check
+static esp_err_t inspect_sink(const uint8_t *data, size_t len, void *ctx) {
+    inspect_t *p = ctx;
+    if (p->quality) quality_bytes(p, data, len);
+    return p->display ? preview_bytes(p, data, len) : ESP_OK;
+}
+
+esp_err_t fp_image_inspect(fingerprint_handle_t fp, display_handle_t display, int x, int y,
+                           fp_quality_t *quality) {
+    // ~4.3 KB, kept off the caller's stack; one upload at a time
+    static inspect_t p;
+    static fp_quality_acc_t acc;
+    static bool registered = false;
+    if (!registered) {
+        mem_budget_add("fp_image", "inspect buffers", &p, sizeof(p));
+        registered = true;
+    }
+    p = (inspect_t){.display = display, .x = x, .y = y, .quality = quality ? &acc : NULL};
+    fp_quality_reset(&acc);
+
+    esp_err_t ret = fingerprint_upload_image(fp, inspect_sink, &p);
+    if (ret == ESP_OK && display) ret = flush_strip(&p);
+    if (ret == ESP_OK && quality) {
+        // A short image would be judged on part of the glass only
+        if (acc.blocks < FP_QUALITY_BLOCKS_X * FP_QUALITY_BLOCKS_Y) ret = ESP_ERR_INVALID_SIZE;
+        fp_quality_result(&acc, quality);
+    }
+    if (ret != ESP_OK) ESP_LOGW(TAG, "Image upload stopped: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+esp_err_t fp_image_preview(fingerprint_handle_t fp, display_handle_t display, int x, int y) {
+    return fp_image_inspect(fp, display, x, y, NULL);
+}
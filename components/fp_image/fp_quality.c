@@ -0,0 +1,260 @@
+#include "fp_quality.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "FP_QUALITY";
+
+#define BLOCK_BYTES (FP_QUALITY_BLOCK / 2)
+#define BLOCK_PIXELS (FP_QUALITY_BLOCK * FP_QUALITY_BLOCK)
+#define BLOCK_PAIRS (FP_QUALITY_BLOCK * (FP_QUALITY_BLOCK - 1))  // Neighbour pairs per direction
+
+// Packed 4-bit pixels, 8 to a 32-bit word: a byte holds pixel 2k in its
+// high nibble and 2k+1 in its low one. Words are loaded little-endian
+// (both targets are), so byte k of a row segment is bits 8k..8k+7.
+#define NIBBLES_LO 0x0F0F0F0Fu
+#define BYTE_ONES 0x01010101u
+
+static inline uint32_t load_word(const uint8_t *p) {
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+// Adds up the four byte lanes of a word (each lane <= 63)
+static inline uint32_t lane_sum(uint32_t lanes) {
+    return (lanes * BYTE_ONES) >> 24;
+}
+
+static inline uint8_t pixel(const uint8_t *row, int x) {
+    uint8_t b = row[x / 2];
+    return (x & 1) ? (b & 0x0F) : (b >> 4);
+}
+
+// Squares of both pixels of a byte: the one step with no lane-wise form
+static uint16_t s_sq[256];
+static bool s_sq_ready = false;
+
+static void build_square_table(void) {
+    for (int b = 0; b < 256; b++) s_sq[b] = (b >> 4) * (b >> 4) + (b & 0x0F) * (b & 0x0F);
+    s_sq_ready = true;
+}
+
+void fp_quality_moments(const uint8_t *band, fp_quality_moments_t *out) {
+    if (!s_sq_ready) build_square_table();
+    for (int bx = 0; bx < FP_QUALITY_BLOCKS_X; bx++) {
+        uint32_t sum = 0;
+        uint32_t sum_sq = 0;
+        const uint8_t *p = band + bx * BLOCK_BYTES;
+        for (int y = 0; y < FP_QUALITY_BLOCK; y++, p += FP_IMAGE_ROW_BYTES) {
+            uint32_t w0 = load_word(p);
+            uint32_t w1 = load_word(p + 4);
+            // Both nibbles of both words side by side: <= 60 per lane
+            sum += lane_sum((w0 & NIBBLES_LO) + ((w0 >> 4) & NIBBLES_LO) +
+                            (w1 & NIBBLES_LO) + ((w1 >> 4) & NIBBLES_LO));
+            sum_sq += s_sq[p[0]] + s_sq[p[1]] + s_sq[p[2]] + s_sq[p[3]] +
+                      s_sq[p[4]] + s_sq[p[5]] + s_sq[p[6]] + s_sq[p[7]];
+        }
+        out->sum[bx] = sum;
+        out->sum_sq[bx] = sum_sq;
+    }
+}
+
+// Bit 8k: pixel 2k >= threshold, bit 8k+1: pixel 2k+1 >= threshold.
+// add is (16 - threshold) in every lane; a nibble reaches bit 4 of its
+// lane exactly when it is at or above the threshold.
+static inline uint32_t above_mask(uint32_t w, uint32_t add) {
+    uint32_t hi = (((w >> 4) & NIBBLES_LO) + add) & 0x10101010u;
+    uint32_t lo = ((w & NIBBLES_LO) + add) & 0x10101010u;
+    return (hi >> 4) | (lo >> 3);
+}
+
+// Changes along the 8 pixels of a mask word, as byte lanes (<= 2 each)
+static inline uint32_t mask_changes(uint32_t m) {
+    uint32_t within = (m ^ (m >> 1)) & BYTE_ONES;                // Pixels 2k, 2k+1
+    uint32_t between = ((m ^ (m >> 7)) >> 1) & 0x00010101u;     // Pixels 2k+1, 2k+2
+    return within + between;
+}
+
+// Set bits of a mask difference, as byte lanes (<= 2 each)
+static inline uint32_t mask_bits(uint32_t d) {
+    return (d & BYTE_ONES) + ((d >> 1) & BYTE_ONES);
+}
+
+void fp_quality_crossings(const uint8_t *band, const uint8_t *threshold, fp_quality_crossings_t *out) {
+    for (int bx = 0; bx < FP_QUALITY_BLOCKS_X; bx++) {
+        uint32_t add = (16u - threshold[bx]) * BYTE_ONES;
+        uint32_t h = 0;
+        uint32_t v = 0;
+        uint32_t prev0 = 0;
+        uint32_t prev1 = 0;
+        const uint8_t *p = band + bx * BLOCK_BYTES;
+        for (int y = 0; y < FP_QUALITY_BLOCK; y++, p += FP_IMAGE_ROW_BYTES) {
+            uint32_t m0 = above_mask(load_word(p), add);
+            uint32_t m1 = above_mask(load_word(p + 4), add);
+            h += lane_sum(mask_changes(m0) + mask_changes(m1)) + (((m0 >> 25) ^ m1) & 1);
+            if (y) v += lane_sum(mask_bits(m0 ^ prev0) + mask_bits(m1 ^ prev1));
+            prev0 = m0;
+            prev1 = m1;
+        }
+        out->h[bx] = h;
+        out->v[bx] = v;
+    }
+}
+
+void fp_quality_moments_scalar(const uint8_t *band, fp_quality_moments_t *out) {
+    memset(out, 0, sizeof(*out));
+    for (int y = 0; y < FP_QUALITY_BLOCK; y++) {
+        const uint8_t *row = band + y * FP_IMAGE_ROW_BYTES;
+        for (int x = 0; x < FP_IMAGE_WIDTH; x++) {
+            uint32_t p = pixel(row, x);
+            out->sum[x / FP_QUALITY_BLOCK] += p;
+            out->sum_sq[x / FP_QUALITY_BLOCK] += p * p;
+        }
+    }
+}
+
+void fp_quality_crossings_scalar(const uint8_t *band, const uint8_t *threshold, fp_quality_crossings_t *out) {
+    memset(out, 0, sizeof(*out));
+    for (int y = 0; y < FP_QUALITY_BLOCK; y++) {
+        const uint8_t *row = band + y * FP_IMAGE_ROW_BYTES;
+        for (int x = 0; x < FP_IMAGE_WIDTH; x++) {
+            int bx = x / FP_QUALITY_BLOCK;
+            bool above = pixel(row, x) >= threshold[bx];
+            if (x % FP_QUALITY_BLOCK && above != (pixel(row, x - 1) >= threshold[bx])) out->h[bx]++;
+            if (y && above != (pixel(row - FP_IMAGE_ROW_BYTES, x) >= threshold[bx])) out->v[bx]++;
+        }
+    }
+}
+
+static uint32_t isqrt(uint32_t n) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void fp_quality_reset(fp_quality_acc_t *acc) {
+    memset(acc, 0, sizeof(*acc));
+}
+
+void fp_quality_add_band(fp_quality_acc_t *acc, const uint8_t *band) {
+    fp_quality_moments_t m;
+    fp_quality_moments(band, &m);
+
+    // Each block is binarised at its own (rounded) mean
+    uint8_t threshold[FP_QUALITY_BLOCKS_X];
+    for (int bx = 0; bx < FP_QUALITY_BLOCKS_X; bx++) {
+        threshold[bx] = (m.sum[bx] + BLOCK_PIXELS / 2) / BLOCK_PIXELS;
+    }
+    fp_quality_crossings_t c;
+    fp_quality_crossings(band, threshold, &c);
+
+    for (int bx = 0; bx < FP_QUALITY_BLOCKS_X; bx++) {
+        acc->blocks++;
+        // Variance times BLOCK_PIXELS^2, exact: at most 14.4e6
+        uint32_t var_n2 = BLOCK_PIXELS * m.sum_sq[bx] - m.sum[bx] * m.sum[bx];
+        uint32_t std_10 = isqrt(var_n2 * 100) / BLOCK_PIXELS;
+        if (std_10 < FP_QUALITY_RIDGE_STD_10) continue;
+        acc->ridge_blocks++;
+        acc->std_10_sum += std_10;
+
+        // A ridge pattern of period P crosses the threshold 2/P times per
+        // pixel across the ridges: P = 2 / |(h, v) per pair|
+        uint32_t c2 = (uint32_t)c.h[bx] * c.h[bx] + (uint32_t)c.v[bx] * c.v[bx];
+        if (c2) {
+            acc->period_10_sum += 2 * BLOCK_PAIRS * 100 / isqrt(c2 * 100);
+            acc->period_blocks++;
+        }
+    }
+}
+
+void fp_quality_result(const fp_quality_acc_t *acc, fp_quality_t *out) {
+    *out = (fp_quality_t){0};
+    if (!acc->blocks) return;
+    out->coverage_pct = acc->ridge_blocks * 100 / acc->blocks;
+    if (acc->ridge_blocks) {
+        // The widest spread of 4-bit pixels is 7.5 levels
+        uint32_t contrast = acc->std_10_sum * 100 / (acc->ridge_blocks * 75);
+        out->contrast_pct = contrast > 100 ? 100 : contrast;
+    }
+    if (acc->period_blocks) out->period_10 = acc->period_10_sum / acc->period_blocks;
+}
+
+fp_quality_issue_t fp_quality_check(const fp_quality_t *quality, const fp_quality_limits_t *limits) {
+    if (quality->coverage_pct < limits->min_coverage_pct) return FP_QUALITY_PARTIAL;
+    if (quality->contrast_pct < limits->min_contrast_pct) return FP_QUALITY_FAINT;
+    if (quality->period_10 < limits->min_period_10 || quality->period_10 > limits->max_period_10) {
+        return FP_QUALITY_SMUDGED;
+    }
+    return FP_QUALITY_OK;
+}
+
+const char *fp_quality_issue_name(fp_quality_issue_t issue) {
+    switch (issue) {
+        case FP_QUALITY_OK:         return "ok";
+        case FP_QUALITY_PARTIAL:    return "partial";
+        case FP_QUALITY_FAINT:      return "faint";
+        case FP_QUALITY_SMUDGED:    return "smudged";
+        default:                    return "other";
+    }
+}
+
+static uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Bands: flat extremes, alternating pixels, then noise; each against
+// every uniform threshold and one random threshold per block
+esp_err_t fp_quality_self_test(void) {
+    static uint8_t band[FP_QUALITY_BAND_BYTES];
+    uint32_t seed = 0x2545F491;
+    for (int n = 0; n < 24; n++) {
+        for (int i = 0; i < FP_QUALITY_BAND_BYTES; i++) {
+            switch (n) {
+                case 0:  band[i] = 0x00; break;
+                case 1:  band[i] = 0xFF; break;
+                case 2:  band[i] = (i & 1) ? 0x0F : 0xF0; break;
+                case 3:  band[i] = (i / FP_IMAGE_ROW_BYTES) & 1 ? 0xFF : 0x00; break;
+                default: band[i] = next_random(&seed) >> 24; break;
+            }
+        }
+
+        fp_quality_moments_t fast_m, ref_m;
+        fp_quality_moments(band, &fast_m);
+        fp_quality_moments_scalar(band, &ref_m);
+        if (memcmp(&fast_m, &ref_m, sizeof(fast_m)) != 0) {
+            ESP_LOGE(TAG, "Moments differ from the reference on band %d", n);
+            return ESP_FAIL;
+        }
+
+        uint8_t threshold[FP_QUALITY_BLOCKS_X];
+        for (int t = 0; t <= 17; t++) {
+            for (int bx = 0; bx < FP_QUALITY_BLOCKS_X; bx++) {
+                threshold[bx] = t <= 16 ? (uint8_t)t : (uint8_t)(next_random(&seed) % 17);
+            }
+            fp_quality_crossings_t fast_c, ref_c;
+            fp_quality_crossings(band, threshold, &fast_c);
+            fp_quality_crossings_scalar(band, threshold, &ref_c);
+            if (memcmp(&fast_c, &ref_c, sizeof(fast_c)) != 0) {
+                ESP_LOGE(TAG, "Crossings differ from the reference on band %d, threshold %d", n, t);
+                return ESP_FAIL;
+            }
+        }
+    }
+    ESP_LOGI(TAG, "Kernels match the reference");
+    return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef FP_IMAGE_H
+#define FP_IMAGE_H
+
+#include "display_driver.h"
+#include "esp_err.h"
+#include "fingerprint_driver.h"
+#include "fp_quality.h"
+#include <stdint.h>
+
+// Preview: the sensor image halved in both directions
+#define FP_PREVIEW_W (FP_IMAGE_WIDTH / 2)
+#define FP_PREVIEW_H (FP_IMAGE_HEIGHT / 2)
+#define FP_PREVIEW_STRIP_ROWS 8        // Preview rows sent to the display at once
+
+/**
+ * @brief Upload the last capture and draw it at (x, y) as the packets arrive
+ * Only FP_PREVIEW_STRIP_ROWS preview rows are held at a time, never the
+ * whole image. The first strip is on screen after about 16 image rows.
+ */
+esp_err_t fp_image_preview(fingerprint_handle_t fp, display_handle_t display, int x, int y);
+
+/**
+ * @brief Upload the last capture once, for the preview and/or its quality
+ * @param display Where to draw the preview, or NULL for none
+ * @param quality Filled with the image's metrics, or NULL to skip them
+ * @return ESP_ERR_INVALID_SIZE if the image came short of a full frame
+ */
+esp_err_t fp_image_inspect(fingerprint_handle_t fp, display_handle_t display, int x, int y,
+                           fp_quality_t *quality);
+
+/**
+ * @brief Decimation kernel: two packed 4-bit image rows to one preview row
+ * Each output pixel is the mean of a 2x2 block as grey RGB565, in panel
+ * byte order.
+ * @param rows FP_IMAGE_ROW_BYTES of the upper row, then the lower row
+ * @param out FP_PREVIEW_W pixels
+ */
+void fp_image_decimate_rows(const uint8_t *rows, uint16_t *out);
+
+#endif // FP_IMAGE_H
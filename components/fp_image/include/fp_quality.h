@@ -0,0 +1,112 @@
+#ifndef FP_QUALITY_H
+#define FP_QUALITY_H
+
+#include "esp_err.h"
+#include "fingerprint_driver.h"
+#include <stdint.h>
+
+// Image quality from the raw sensor image, judged per 16x16-pixel block
+// and fed one band of blocks (16 image rows) at a time
+#define FP_QUALITY_BLOCK 16
+#define FP_QUALITY_BLOCKS_X (FP_IMAGE_WIDTH / FP_QUALITY_BLOCK)
+#define FP_QUALITY_BLOCKS_Y (FP_IMAGE_HEIGHT / FP_QUALITY_BLOCK)
+#define FP_QUALITY_BAND_BYTES (FP_QUALITY_BLOCK * FP_IMAGE_ROW_BYTES)
+
+// A block holds ridges if its pixels spread at least this much (standard
+// deviation in tenths of a 4-bit grey level); the rest is background
+#define FP_QUALITY_RIDGE_STD_10 8
+
+typedef enum {
+    FP_QUALITY_OK,
+    FP_QUALITY_PARTIAL,     // Too little of the finger on the glass
+    FP_QUALITY_FAINT,       // Low contrast: dry finger or light touch
+    FP_QUALITY_SMUDGED,     // Ridge spacing out of range: wet or moving finger
+    FP_QUALITY_ISSUE_COUNT
+} fp_quality_issue_t;
+
+typedef struct {
+    uint8_t coverage_pct;   // Ridge blocks, of all blocks
+    uint8_t contrast_pct;   // Mean ridge block deviation, of the 4-bit maximum
+    uint16_t period_10;     // Mean ridge period in tenths of a pixel (0: none)
+} fp_quality_t;
+
+typedef struct {
+    uint8_t min_coverage_pct;
+    uint8_t min_contrast_pct;
+    uint16_t min_period_10;
+    uint16_t max_period_10;
+} fp_quality_limits_t;
+
+// Kernel outputs for one band, per block column
+typedef struct {
+    uint32_t sum[FP_QUALITY_BLOCKS_X];
+    uint32_t sum_sq[FP_QUALITY_BLOCKS_X];
+} fp_quality_moments_t;
+
+typedef struct {
+    uint16_t h[FP_QUALITY_BLOCKS_X];    // Threshold crossings between horizontal neighbours
+    uint16_t v[FP_QUALITY_BLOCKS_X];    // ... and between vertical neighbours
+} fp_quality_crossings_t;
+
+// Running totals over the bands seen so far
+typedef struct {
+    uint32_t blocks;
+    uint32_t ridge_blocks;
+    uint32_t std_10_sum;        // Over ridge blocks
+    uint32_t period_10_sum;     // Over ridge blocks with crossings
+    uint32_t period_blocks;
+} fp_quality_acc_t;
+
+/**
+ * @brief Start a new image
+ */
+void fp_quality_reset(fp_quality_acc_t *acc);
+
+/**
+ * @brief Add one band: FP_QUALITY_BAND_BYTES of packed rows
+ */
+void fp_quality_add_band(fp_quality_acc_t *acc, const uint8_t *band);
+
+/**
+ * @brief Metrics of the bands added since the reset
+ */
+void fp_quality_result(const fp_quality_acc_t *acc, fp_quality_t *out);
+
+/**
+ * @brief First limit the metrics miss, in the order coverage, contrast,
+ *        ridge period; FP_QUALITY_OK if none
+ */
+fp_quality_issue_t fp_quality_check(const fp_quality_t *quality, const fp_quality_limits_t *limits);
+
+/**
+ * @brief Short name of an issue, for logs and metric labels
+ */
+const char *fp_quality_issue_name(fp_quality_issue_t issue);
+
+/**
+ * @brief Moments kernel: per block column, sum and sum of squares of the
+ *        band's pixels. Works on 8 pixels per 32-bit word.
+ */
+void fp_quality_moments(const uint8_t *band, fp_quality_moments_t *out);
+
+/**
+ * @brief Crossings kernel: per block column, neighbouring pixels on
+ *        opposite sides of the block's threshold (pixel >= threshold[bx])
+ *        Only pairs inside a block count. Works on 8 pixels per word.
+ * @param threshold FP_QUALITY_BLOCKS_X values, 0..16
+ */
+void fp_quality_crossings(const uint8_t *band, const uint8_t *threshold, fp_quality_crossings_t *out);
+
+/**
+ * @brief Pixel-by-pixel versions of the kernels, the reference for them
+ */
+void fp_quality_moments_scalar(const uint8_t *band, fp_quality_moments_t *out);
+void fp_quality_crossings_scalar(const uint8_t *band, const uint8_t *threshold, fp_quality_crossings_t *out);
+
+/**
+ * @brief Run both kernel versions over generated bands and compare
+ * @return ESP_OK if every output is bit-identical, ESP_FAIL otherwise
+ */
+esp_err_t fp_quality_self_test(void);
+
+#endif // FP_QUALITY_H
@@ -0,0 +1,290 @@
+#include "host_sim.h"
+#include "attendance_journal.h"
+#include "display_driver_fake.h"
+#include "fingerprint_driver.h"
+#include "fingerprint_driver_fake.h"
+#include "fp_quality.h"
+#include "keypad_driver_fake.h"
+#include "mp3_driver_fake.h"
+#include "network_manager_fake.h"
+#include "push_channel_fake.h"
+#include "time_manager_fake.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "metrics.h"
+#include "nvs.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "HOST_SIM";
+
+#define HOST_SIM_LINE_MAX 160
+#define HOST_SIM_EXPECT_TIMEOUT_MS 3000
+#define HOST_SIM_EXPECT_POLL_MS 10
+#define HOST_SIM_JOURNAL_TIMEOUT_MS 1000
+#define HOST_SIM_KEY_HOLD_MS 80
+#define HOST_SIM_KEY_GAP_MS 120
+
+// Display draws and time of the last input; expect searches from here
+static uint32_t s_mark = 0;
+static uint32_t s_mark_seq = 0;     // Next journal seq at the last input
+static int64_t s_mark_us = 0;
+static int s_failures = 0;
+
+static uint32_t journal_next_seq(void) {
+    journal_stats_t stats;
+    journal_get_stats(&stats);
+    return stats.next_seq;
+}
+
+static void mark_input(void) {
+    s_mark = display_fake_draw_count();
+    s_mark_seq = journal_next_seq();
+    s_mark_us = esp_timer_get_time();
+}
+
+static void sleep_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1);
+}
+
+static esp_err_t write_stdout(const char *data, size_t len, void *ctx) {
+    return fwrite(data, 1, len, stdout) == len ? ESP_OK : ESP_FAIL;
+}
+
+static bool parse_on_off(const char *arg, const char *on, const char *off, bool *value) {
+    if (!arg) return false;
+    if (strcmp(arg, on) == 0) *value = true;
+    else if (strcmp(arg, off) == 0) *value = false;
+    else return false;
+    return true;
+}
+
+static void expect(const char *text, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int64_t drawn_us;
+    while (!display_fake_find_text(text, s_mark, &drawn_us)) {
+        if (esp_timer_get_time() >= deadline) {
+            printf("FAIL expect \"%s\": not drawn within %lu ms\n", text, (unsigned long)timeout_ms);
+            s_failures++;
+            return;
+        }
+        sleep_ms(HOST_SIM_EXPECT_POLL_MS);
+    }
+    printf("ok   expect \"%s\": %.1f ms after input\n", text, (drawn_us - s_mark_us) / 1000.0);
+}
+
+// Records reach the journal (and from there the upload) only through the
+// network task, so this counts the network work an input caused
+static void expect_journal(uint32_t delta, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    uint32_t seen;
+    while ((seen = journal_next_seq() - s_mark_seq) < delta || delta == 0) {
+        if (esp_timer_get_time() >= deadline) break;
+        sleep_ms(HOST_SIM_EXPECT_POLL_MS);
+    }
+    if (seen != delta) {
+        printf("FAIL journal: %lu record(s) since the input, expected %lu\n", (unsigned long)seen,
+               (unsigned long)delta);
+        s_failures++;
+        return;
+    }
+    printf("ok   journal: %lu record(s) since the input\n", (unsigned long)seen);
+}
+
+static void expect_pending(uint32_t pending, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    journal_stats_t stats;
+    journal_get_stats(&stats);
+    while (stats.pending != pending) {
+        if (esp_timer_get_time() >= deadline) {
+            printf("FAIL pending: %lu record(s) still waiting for upload, expected %lu\n",
+                   (unsigned long)stats.pending, (unsigned long)pending);
+            s_failures++;
+            return;
+        }
+        sleep_ms(HOST_SIM_EXPECT_POLL_MS);
+        journal_get_stats(&stats);
+    }
+    printf("ok   pending: %lu record(s) waiting for upload\n", (unsigned long)stats.pending);
+}
+
+// Overwrites the flash slot of the Nth pending record (1 = oldest) with
+// garbage, then reloads the journal as a reboot would
+static bool corrupt_journal(uint32_t n) {
+    journal_stats_t stats;
+    journal_get_stats(&stats);
+    if (n == 0 || n > stats.pending) return false;
+
+    nvs_handle_t nvs;
+    if (nvs_open("journal", NVS_READWRITE, &nvs) != ESP_OK) return false;
+    char key[8];
+    // Same key scheme as attendance_journal.c
+    snprintf(key, sizeof(key), "r%02lu",
+             (unsigned long)((journal_first_seq() + n - 1) % JOURNAL_CAPACITY));
+    static const uint8_t garbage[] = {0xde, 0xad};
+    esp_err_t ret = nvs_set_blob(nvs, key, garbage, sizeof(garbage));
+    if (ret == ESP_OK) ret = nvs_commit(nvs);
+    nvs_close(nvs);
+    return ret == ESP_OK && journal_init() == ESP_OK;
+}
+
+// Returns false if the line did not parse
+static bool run_line(char *line) {
+    char *cmd = line + strspn(line, " \t");
+    size_t cmd_len = strcspn(cmd, " \t\r\n");
+    // Whole-line comments only: '#' is also a key
+    if (cmd_len == 0 || *cmd == '#') return true;
+    char *rest = cmd + cmd_len;
+    if (*rest) *rest++ = '\0';
+
+    // expect "TEXT WITH SPACES" [TIMEOUT_MS]
+    if (strcmp(cmd, "expect") == 0) {
+        char *text = rest + strspn(rest, " \t");
+        char *end;
+        if (*text == '"') {
+            end = strchr(++text, '"');
+            if (!end) return false;
+        } else {
+            end = text + strcspn(text, " \t\r\n");
+        }
+        if (end == text) return false;
+        char *timeout = *end ? end + 1 : end;
+        *end = '\0';
+        uint32_t timeout_ms = strtoul(timeout, NULL, 10);
+        expect(text, timeout_ms ? timeout_ms : HOST_SIM_EXPECT_TIMEOUT_MS);
+        return true;
+    }
+
+    char *save;
+    char *arg = strtok_r(rest, " \t\r\n", &save);
+    char *arg2 = strtok_r(NULL, " \t\r\n", &save);
+
+    if (strcmp(cmd, "wait") == 0 && arg) {
+        sleep_ms(strtoul(arg, NULL, 10));
+    } else if (strcmp(cmd, "journal") == 0 && arg) {
+        expect_journal(strtoul(arg, NULL, 10), arg2 ? strtoul(arg2, NULL, 10) : HOST_SIM_JOURNAL_TIMEOUT_MS);
+    } else if (strcmp(cmd, "pending") == 0 && arg) {
+        expect_pending(strtoul(arg, NULL, 10), arg2 ? strtoul(arg2, NULL, 10) : HOST_SIM_EXPECT_TIMEOUT_MS);
+    } else if (strcmp(cmd, "journal_corrupt") == 0 && arg) {
+        return corrupt_journal(strtoul(arg, NULL, 10));
+    } else if (strcmp(cmd, "enroll") == 0 && arg) {
+        return fingerprint_fake_enroll(strtoul(arg, NULL, 10)) == ESP_OK;
+    } else if (strcmp(cmd, "finger") == 0 && arg) {
+        mark_input();
+        if (strcmp(arg, "none") == 0) fingerprint_fake_lift_finger();
+        else if (strcmp(arg, "unknown") == 0) fingerprint_fake_place_finger(FP_FAKE_UNKNOWN_FINGER);
+        else fingerprint_fake_place_finger(strtoul(arg, NULL, 10));
+    } else if (strcmp(cmd, "press") == 0 && arg && arg[1] == '\0') {
+        mark_input();
+        keypad_fake_press(arg[0], arg2 ? strtoul(arg2, NULL, 10) : HOST_SIM_KEY_HOLD_MS);
+    } else if (strcmp(cmd, "keys") == 0 && arg) {
+        mark_input();
+        for (const char *k = arg; *k; k++) {
+            keypad_fake_press(*k, HOST_SIM_KEY_HOLD_MS);
+            sleep_ms(HOST_SIM_KEY_GAP_MS);
+        }
+    } else if (strcmp(cmd, "link") == 0) {
+        bool up;
+        if (!parse_on_off(arg, "up", "down", &up)) return false;
+        mark_input();
+        network_fake_set_link(up);
+    } else if (strcmp(cmd, "channel") == 0) {
+        bool up;
+        if (!parse_on_off(arg, "up", "down", &up)) return false;
+        mark_input();
+        push_channel_fake_set_connected(up);
+    } else if (strcmp(cmd, "clock") == 0) {
+        bool synced;
+        if (!parse_on_off(arg, "synced", "lost", &synced)) return false;
+        time_fake_set_synced(synced);
+    } else if (strcmp(cmd, "post") == 0 && arg) {
+        network_fake_set_post(strtoul(arg, NULL, 10), arg2 ? strtoul(arg2, NULL, 10) : 0);
+    } else if (strcmp(cmd, "fp_timing") == 0 && arg && arg2) {
+        char *search = strtok_r(NULL, " \t\r\n", &save);
+        char *store = strtok_r(NULL, " \t\r\n", &save);
+        char *load = strtok_r(NULL, " \t\r\n", &save);
+        char *match = strtok_r(NULL, " \t\r\n", &save);
+        if (!search || !store) return false;
+        fingerprint_fake_timing_t timing = {
+            .get_image_ms = strtoul(arg, NULL, 10), .image_to_tz_ms = strtoul(arg2, NULL, 10),
+            .search_ms = strtoul(search, NULL, 10), .store_ms = strtoul(store, NULL, 10),
+            .load_ms = load ? strtoul(load, NULL, 10) : 40,
+            .match_ms = match ? strtoul(match, NULL, 10) : 30,
+        };
+        fingerprint_fake_set_timing(&timing);
+    } else if (strcmp(cmd, "fp_fault") == 0 && arg) {
+        static const struct { const char *name; uint8_t code; } faults[] = {
+            {"mess", FP_IMAGEMESS}, {"feature", FP_FEATUREFAIL}, {"comm", FP_ERROR_RECV}, {"none", FP_OK},
+        };
+        size_t i = 0;
+        while (i < sizeof(faults) / sizeof(faults[0]) && strcmp(arg, faults[i].name) != 0) i++;
+        if (i == sizeof(faults) / sizeof(faults[0])) return false;
+        fingerprint_fake_set_fault(faults[i].code, arg2 ? strtoul(arg2, NULL, 10) : 1);
+    } else if (strcmp(cmd, "fp_image") == 0 && arg) {
+        static const char *kinds[] = {"good", "partial", "faint", "smudged"};
+        size_t i = 0;
+        while (i < sizeof(kinds) / sizeof(kinds[0]) && strcmp(arg, kinds[i]) != 0) i++;
+        if (i == sizeof(kinds) / sizeof(kinds[0])) return false;
+        fingerprint_fake_set_image((fingerprint_fake_image_t)i, arg2 ? strtoul(arg2, NULL, 10) : 1);
+    } else if (strcmp(cmd, "fp_selftest") == 0) {
+        return fp_quality_self_test() == ESP_OK;
+    } else if (strcmp(cmd, "audio") == 0 && arg && arg2) {
+        mp3_fake_set_timing(strtoul(arg, NULL, 10), strtoul(arg2, NULL, 10));
+    } else if (strcmp(cmd, "command") == 0 && arg) {
+        esp_err_t ret;
+        mark_input();
+        if (strcmp(arg, "delete") == 0 && arg2) {
+            ret = push_channel_fake_command(PUSH_CMD_DELETE_SLOT, strtol(arg2, NULL, 10));
+        } else if (strcmp(arg, "refresh") == 0) {
+            ret = push_channel_fake_command(PUSH_CMD_REFRESH_USERS, 0);
+        } else if (strcmp(arg, "volume") == 0 && arg2) {
+            ret = push_channel_fake_command(PUSH_CMD_SET_VOLUME, strtol(arg2, NULL, 10));
+        } else {
+            return false;
+        }
+        return ret == ESP_OK;
+    } else if (strcmp(cmd, "metrics") == 0) {
+        metrics_write_prometheus(write_stdout, NULL);
+        fflush(stdout);
+    } else if (strcmp(cmd, "trace") == 0) {
+        trace_dump_uart();
+    } else if (strcmp(cmd, "quit") == 0) {
+        fflush(stdout);
+        exit(arg ? atoi(arg) : (s_failures ? 1 : 0));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void host_sim_run(void) {
+    const char *path = getenv("ATTENDANCE_SCRIPT");
+    FILE *script = path ? fopen(path, "r") : stdin;
+    if (!script) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        exit(2);
+    }
+    ESP_LOGI(TAG, "Running %s", path ? path : "stdin");
+
+    char line[HOST_SIM_LINE_MAX];
+    unsigned line_no = 0;
+    mark_input();
+    while (fgets(line, sizeof(line), script)) {
+        line_no++;
+        char copy[HOST_SIM_LINE_MAX];
+        strcpy(copy, line);
+        if (!run_line(line)) {
+            printf("FAIL line %u: %s", line_no, copy);
+            s_failures++;
+        }
+    }
+    if (script != stdin) fclose(script);
+
+    printf("%d failure(s)\n", s_failures);
+    fflush(stdout);
+    exit(s_failures ? 1 : 0);
+}
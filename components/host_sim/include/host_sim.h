@@ -0,0 +1,48 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+// Host (linux target) build only.
+//
+// Plays a script against the running firmware, one command per line
+// (lines starting with '#' are comments):
+//
+//   wait MS                     sleep
+//   enroll N                    pre-enroll finger N into slot N
+//   finger N|unknown|none       place a finger on the sensor / lift it
+//   press KEY [HOLD_MS]         press and release one key
+//   keys KEYS                   type a sequence, e.g. "keys 12#"
+//   expect TEXT [TIMEOUT_MS]    wait for TEXT ("quoted" if it has spaces)
+//                               on the display since the last input,
+//                               print the latency, fail if it never shows
+//   journal DELTA [TIMEOUT_MS]  DELTA attendance records journaled for
+//                               upload since the last input; 0 waits the
+//                               whole timeout (default 1000) for none
+//   pending N [TIMEOUT_MS]      wait until N records wait for upload
+//   journal_corrupt N           make the Nth pending record unreadable in
+//                               flash and reload the journal (a reboot)
+//   link up|down                Wi-Fi link
+//   channel up|down             push channel to the server
+//   clock synced|lost           wall clock validity
+//   post LATENCY_MS [FAIL_PCT]  simulated server round trip
+//   fp_timing IMG TZ SEARCH STORE [LOAD MATCH]
+//                               sensor command timings (ms)
+//   fp_fault mess|feature|comm|none [COUNT]
+//                               fail the next COUNT conversions with that
+//                               code; comm times out until "none"
+//   fp_image good|partial|faint|smudged [COUNT]
+//                               what the next COUNT captures look like
+//   fp_selftest                 compare the image quality kernels with
+//                               their scalar reference, fail on a mismatch
+//   audio ACK_MS TRACK_MS       DFPlayer timings
+//   command delete N|refresh|volume N   server-pushed command
+//   metrics                     print the Prometheus metrics
+//   trace                       print the trace ring
+//   quit [CODE]                 exit the process
+
+/**
+ * @brief Run the script in $ATTENDANCE_SCRIPT, or stdin if unset, then exit
+ * The process exit code is 1 if any expect failed or a line did not parse.
+ */
+void host_sim_run(void);
+
+#endif // HOST_SIM_H
@@ -9,14 +9,30 @@
 typedef struct {
     int row_pins[4];
     int col_pins[4];
-    uint32_t scan_interval_ms;
+    uint32_t scan_interval_ms;   // Poll period while a key is down (idle is interrupt-driven)
+    uint32_t long_press_ms;      // Held this long -> KEYPAD_EVENT_LONG_PRESS
 } keypad_config_t;
 
+#define KEYPAD_EVENT_RING_SIZE 32   // Power of two
+
+typedef enum {
+    KEYPAD_EVENT_PRESS,
+    KEYPAD_EVENT_RELEASE,
+    KEYPAD_EVENT_LONG_PRESS        // Once per press, while still held
+} keypad_event_type_t;
+
+typedef struct {
+    int64_t timestamp_us;          // esp_timer_get_time() when it happened
+    char key;
+    uint8_t type;                  // keypad_event_type_t
+} keypad_event_t;
+
 // Keypad Driver Handle
 typedef struct keypad_driver* keypad_handle_t;
 
-// Key callback function type
-typedef void (*keypad_callback_t)(char key, void *user_data);
+// Called from the scan timer after new events were published; keep it
+// short (wake the consumer)
+typedef void (*keypad_notify_t)(void *user_data);
 
 /**
  * @brief Initialize keypad driver
@@ -24,12 +40,30 @@ typedef void (*keypad_callback_t)(char key, void *user_data);
 esp_err_t keypad_init(const keypad_config_t *config, keypad_handle_t *handle);
 
 /**
- * @brief Register callback for key press events
+ * @brief Register the consumer's wake-up for new events
+ */
+esp_err_t keypad_register_notify(keypad_handle_t handle, keypad_notify_t notify, void *user_data);
+
+/**
+ * @brief Take the oldest event from the ring (lock-free, single consumer)
+ * @return false if the ring is empty
+ */
+bool keypad_read_event(keypad_handle_t handle, keypad_event_t *event);
+
+/**
+ * @brief Events waiting in the ring
+ */
+uint32_t keypad_events_pending(keypad_handle_t handle);
+
+/**
+ * @brief Events dropped because the consumer fell behind
  */
-esp_err_t keypad_register_callback(keypad_handle_t handle, keypad_callback_t callback, void *user_data);
+uint32_t keypad_events_dropped(keypad_handle_t handle);
 
 /**
- * @brief Start keypad scanning
+ * @brief Start the keypad
+ * Idles with all rows low and column interrupts armed; a press starts
+ * scanning, which stops again once all keys are released.
  */
 esp_err_t keypad_start(keypad_handle_t handle);
 
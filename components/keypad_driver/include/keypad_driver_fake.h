@@ -0,0 +1,21 @@
+#ifndef KEYPAD_DRIVER_FAKE_H
+#define KEYPAD_DRIVER_FAKE_H
+
+#include "keypad_driver.h"
+#include <stdint.h>
+
+// Host build only: scripted key presses
+
+/**
+ * @brief Publish one event as the scan timer would (single producer)
+ * @return false if the keypad is stopped/disabled or the ring is full
+ */
+bool keypad_fake_inject(char key, keypad_event_type_t type);
+
+/**
+ * @brief Press, hold and release a key; blocks the caller for hold_ms
+ * A long-press event is published once the hold reaches long_press_ms.
+ */
+void keypad_fake_press(char key, uint32_t hold_ms);
+
+#endif // KEYPAD_DRIVER_FAKE_H
@@ -1,4 +1,5 @@
 #include "keypad_driver.h"
+#include "driver/dedic_gpio.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_log.h"
@@ -16,77 +17,187 @@ static const char keypad_map[4][4] = {
     {'*', '0', '#', 'D'}
 };
 
+// Empty scans before a key counts as released and the scanner goes idle
+#define KEYPAD_RELEASE_SCANS 3
+
+#define KEYPAD_ALL_ROWS 0x0F
+
+// Idle: all rows driven low, columns armed with a low-level interrupt, no
+// timer running. A press fires the interrupt, which starts the scan timer;
+// once every key is released the driver goes back to idle.
+//
+// Dedicated GPIO channels belong to one CPU, so the bundles are created and
+// used only from the scan timer callback (the esp_timer task's core).
+//
+// Key events go into a single-producer/single-consumer ring: the scan timer
+// only writes head, the consumer only writes tail, so no lock is needed.
 struct keypad_driver {
     int row_pins[4];
     int col_pins[4];
     uint32_t scan_interval_ms;
     esp_timer_handle_t scan_timer;
-    keypad_callback_t callback;
+    dedic_gpio_bundle_handle_t rows;   // Written in one instruction
+    dedic_gpio_bundle_handle_t cols;   // Read in one instruction
+    keypad_notify_t notify;
     void *user_data;
+    keypad_event_t events[KEYPAD_EVENT_RING_SIZE];
+    uint32_t head;                     // Next slot to write (scan timer)
+    uint32_t tail;                     // Next slot to read (consumer)
+    uint32_t dropped;
+    int64_t long_press_us;
+    int64_t wake_us;                   // Column interrupt time, stamps the first press
+    int64_t pressed_at;
+    int64_t released_at;               // First empty scan
+    bool long_sent;
     char last_key;
+    uint8_t empty_scans;
+    volatile bool scanning;
+    bool started;
     bool enabled;
 };
+static struct keypad_driver g_keypad_dev;
 
-static void keypad_scan_timer_callback(void *arg) {
+static void set_column_interrupts(keypad_handle_t handle, bool enable) {
+    for (int col = 0; col < 4; col++) {
+        if (enable) gpio_intr_enable(handle->col_pins[col]);
+        else gpio_intr_disable(handle->col_pins[col]);
+    }
+}
+
+// Any column pulled low while all rows are low: a key went down
+static void keypad_column_isr(void *arg) {
     keypad_handle_t handle = (keypad_handle_t)arg;
-    
-    if (!handle->enabled) {
-        return;
+    // Level-triggered: mask until the scanner hands back
+    set_column_interrupts(handle, false);
+    if (!handle->scanning) {
+        handle->scanning = true;
+        handle->wake_us = esp_timer_get_time();
+        esp_timer_start_periodic(handle->scan_timer, handle->scan_interval_ms * 1000);
     }
-    
-    // Scan each row
-    for (int row = 0; row < 4; row++) {
-        // Set current row LOW, others HIGH
-        for (int r = 0; r < 4; r++) {
-            gpio_set_level(handle->row_pins[r], (r == row) ? 0 : 1);
-        }
-        
-        // Small delay for signal to settle
-        esp_rom_delay_us(5);
-        
-        // Check columns
-        for (int col = 0; col < 4; col++) {
-            if (gpio_get_level(handle->col_pins[col]) == 0) {
-                char key = keypad_map[row][col];
-                
-                // Debounce: only trigger if different from last key
-                if (key != handle->last_key) {
-                    handle->last_key = key;
-                    
-                    if (handle->callback) {
-                        handle->callback(key, handle->user_data);
-                    }
-                    
-                    ESP_LOGI(TAG, "Key pressed: %c", key);
-                }
-                return;
+}
+
+static void enter_idle(keypad_handle_t handle) {
+    handle->last_key = 0;
+    handle->empty_scans = 0;
+    handle->scanning = false;
+    dedic_gpio_bundle_write(handle->rows, KEYPAD_ALL_ROWS, 0);
+    // A key pressed in the meantime holds its column low and fires at once
+    set_column_interrupts(handle, true);
+}
+
+// Returns the key held down, or 0
+static char scan_matrix(keypad_handle_t handle) {
+    char key = 0;
+    for (int row = 0; row < 4 && !key; row++) {
+        // Current row LOW, others HIGH
+        dedic_gpio_bundle_write(handle->rows, KEYPAD_ALL_ROWS, KEYPAD_ALL_ROWS & ~(1u << row));
+        esp_rom_delay_us(5);   // Let the column lines settle
+
+        uint32_t cols = ~dedic_gpio_bundle_read_in(handle->cols) & 0x0F;
+        if (cols) key = keypad_map[row][__builtin_ctz(cols)];
+    }
+    return key;
+}
+
+// Producer side, scan timer only. Returns true if the event was queued.
+static bool publish(keypad_handle_t handle, keypad_event_type_t type, char key,
+                    int64_t timestamp_us) {
+    if (!handle->enabled) return false;
+
+    uint32_t head = handle->head;
+    uint32_t tail = __atomic_load_n(&handle->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= KEYPAD_EVENT_RING_SIZE) {
+        handle->dropped++;
+        return false;
+    }
+    handle->events[head % KEYPAD_EVENT_RING_SIZE] =
+        (keypad_event_t){.timestamp_us = timestamp_us, .key = key, .type = type};
+    // Slot contents become visible before the new head
+    __atomic_store_n(&handle->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Scan timer only: the first run creates the bundles on the timer's core
+static void create_bundles(keypad_handle_t handle) {
+    dedic_gpio_bundle_config_t rows_conf = {
+        .gpio_array = handle->row_pins, .array_size = 4, .flags = {.out_en = 1}
+    };
+    dedic_gpio_bundle_config_t cols_conf = {
+        .gpio_array = handle->col_pins, .array_size = 4, .flags = {.in_en = 1}
+    };
+    ESP_ERROR_CHECK(dedic_gpio_new_bundle(&rows_conf, &handle->rows));
+    ESP_ERROR_CHECK(dedic_gpio_new_bundle(&cols_conf, &handle->cols));
+}
+
+static void keypad_scan_timer_callback(void *arg) {
+    keypad_handle_t handle = (keypad_handle_t)arg;
+    int64_t now = esp_timer_get_time();
+    bool published = false;
+
+    if (!handle->rows) create_bundles(handle);
+
+    char key = scan_matrix(handle);
+    if (key) {
+        handle->empty_scans = 0;
+        // Debounce: only trigger if different from last key
+        if (key != handle->last_key) {
+            if (handle->last_key) {
+                published |= publish(handle, KEYPAD_EVENT_RELEASE, handle->last_key, now);
             }
+            // The first key after a wake-up went down when the interrupt fired
+            int64_t pressed_at = handle->last_key ? now : handle->wake_us;
+            handle->last_key = key;
+            handle->pressed_at = pressed_at;
+            handle->long_sent = false;
+            published |= publish(handle, KEYPAD_EVENT_PRESS, key, pressed_at);
+        } else if (!handle->long_sent && now - handle->pressed_at >= handle->long_press_us) {
+            handle->long_sent = true;
+            published |= publish(handle, KEYPAD_EVENT_LONG_PRESS, key, now);
         }
+    } else if (handle->empty_scans++ == 0) {
+        handle->released_at = now;
     }
-    
-    // No key pressed
-    handle->last_key = 0;
-    
-    // Set all rows HIGH
-    for (int r = 0; r < 4; r++) {
-        gpio_set_level(handle->row_pins[r], 1);
+
+    bool released = !key && handle->empty_scans >= KEYPAD_RELEASE_SCANS;
+    if (released && handle->last_key) {
+        published |= publish(handle, KEYPAD_EVENT_RELEASE, handle->last_key,
+                             handle->released_at);
+    }
+    if (published && handle->notify) handle->notify(handle->user_data);
+    if (!released) return;
+
+    // Released: stop polling until the next press
+    esp_timer_stop(handle->scan_timer);
+    if (handle->started) {
+        enter_idle(handle);
+    } else {
+        handle->last_key = 0;
+        handle->scanning = false;
     }
 }
 
 esp_err_t keypad_init(const keypad_config_t *config, keypad_handle_t *handle) {
     ESP_LOGI(TAG, "Initializing keypad driver");
     
-    keypad_handle_t h = malloc(sizeof(struct keypad_driver));
-    if (!h) {
-        return ESP_ERR_NO_MEM;
-    }
+    keypad_handle_t h = &g_keypad_dev;
     
     memcpy(h->row_pins, config->row_pins, sizeof(h->row_pins));
     memcpy(h->col_pins, config->col_pins, sizeof(h->col_pins));
     h->scan_interval_ms = config->scan_interval_ms;
-    h->callback = NULL;
+    h->notify = NULL;
     h->user_data = NULL;
+    h->head = 0;
+    h->tail = 0;
+    h->dropped = 0;
+    h->long_press_us = (int64_t)(config->long_press_ms ? config->long_press_ms : 1000) * 1000;
+    h->wake_us = 0;
+    h->pressed_at = 0;
+    h->released_at = 0;
+    h->long_sent = false;
     h->last_key = 0;
+    h->empty_scans = 0;
+    h->scanning = false;
+    h->started = false;
     h->enabled = true;
     
     // Configure row pins as OUTPUT
@@ -100,22 +211,32 @@ esp_err_t keypad_init(const keypad_config_t *config, keypad_handle_t *handle) {
             .intr_type = GPIO_INTR_DISABLE,
         };
         ESP_ERROR_CHECK(gpio_config(&row_conf));
-        gpio_set_level(config->row_pins[i], 1);
     }
     
-    // Configure column pins as INPUT with pull-up
+    // Configure column pins as INPUT with pull-up, interrupt armed by keypad_start
     for (int i = 0; i < 4; i++) {
         gpio_config_t col_conf = {
             .pin_bit_mask = (1ULL << config->col_pins[i]),
             .mode = GPIO_MODE_INPUT,
             .pull_up_en = GPIO_PULLUP_ENABLE,
             .pull_down_en = GPIO_PULLDOWN_DISABLE,
-            .intr_type = GPIO_INTR_DISABLE,
+            .intr_type = GPIO_INTR_LOW_LEVEL,
         };
         ESP_ERROR_CHECK(gpio_config(&col_conf));
+        gpio_intr_disable(config->col_pins[i]);
+    }
+
+    // Another driver may have installed the shared GPIO ISR service already
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "GPIO ISR service failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    for (int i = 0; i < 4; i++) {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(config->col_pins[i], keypad_column_isr, h));
     }
     
-    // Create periodic timer for scanning
+    // Scan timer, only runs while a key is down
     esp_timer_create_args_t timer_args = {
         .callback = keypad_scan_timer_callback,
         .arg = h,
@@ -129,20 +250,49 @@ esp_err_t keypad_init(const keypad_config_t *config, keypad_handle_t *handle) {
     return ESP_OK;
 }
 
-esp_err_t keypad_register_callback(keypad_handle_t handle, keypad_callback_t callback, void *user_data) {
-    handle->callback = callback;
+esp_err_t keypad_register_notify(keypad_handle_t handle, keypad_notify_t notify, void *user_data) {
     handle->user_data = user_data;
+    handle->notify = notify;
     return ESP_OK;
 }
 
+bool keypad_read_event(keypad_handle_t handle, keypad_event_t *event) {
+    uint32_t tail = handle->tail;
+    uint32_t head = __atomic_load_n(&handle->head, __ATOMIC_ACQUIRE);
+    if (tail == head) return false;
+
+    *event = handle->events[tail % KEYPAD_EVENT_RING_SIZE];
+    // Hand the slot back only after it has been copied out
+    __atomic_store_n(&handle->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t keypad_events_pending(keypad_handle_t handle) {
+    return __atomic_load_n(&handle->head, __ATOMIC_ACQUIRE) - handle->tail;
+}
+
+uint32_t keypad_events_dropped(keypad_handle_t handle) {
+    return handle->dropped;
+}
+
 esp_err_t keypad_start(keypad_handle_t handle) {
-    ESP_LOGI(TAG, "Starting keypad scanning");
+    ESP_LOGI(TAG, "Starting keypad (interrupt wake-up)");
+    handle->started = true;
+    if (handle->scanning) return ESP_OK;
+
+    // One scan pass from the timer; it goes idle by itself once no key is down
+    handle->scanning = true;
+    handle->wake_us = esp_timer_get_time();
     return esp_timer_start_periodic(handle->scan_timer, handle->scan_interval_ms * 1000);
 }
 
 esp_err_t keypad_stop(keypad_handle_t handle) {
     ESP_LOGI(TAG, "Stopping keypad scanning");
-    return esp_timer_stop(handle->scan_timer);
+    handle->started = false;
+    set_column_interrupts(handle, false);
+    esp_timer_stop(handle->scan_timer);
+    handle->scanning = false;
+    return ESP_OK;
 }
 
 esp_err_t keypad_set_enabled(keypad_handle_t handle, bool enabled) {
@@ -0,0 +1,103 @@
+#include "keypad_driver.h"
+#include "keypad_driver_fake.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "KEYPAD_FAKE";
+
+// Same ring as the real driver; the script is the producer
+struct keypad_driver {
+    uint32_t long_press_ms;
+    bool started;
+    bool enabled;
+    keypad_notify_t notify;
+    void *user_data;
+
+    keypad_event_t events[KEYPAD_EVENT_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+};
+static struct keypad_driver g_keypad_dev;
+
+bool keypad_fake_inject(char key, keypad_event_type_t type) {
+    keypad_handle_t handle = &g_keypad_dev;
+    if (!handle->started || !handle->enabled) return false;
+
+    uint32_t head = handle->head;
+    uint32_t tail = __atomic_load_n(&handle->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= KEYPAD_EVENT_RING_SIZE) {
+        handle->dropped++;
+        return false;
+    }
+    handle->events[head % KEYPAD_EVENT_RING_SIZE] = (keypad_event_t){
+        .timestamp_us = esp_timer_get_time(), .key = key, .type = type};
+    __atomic_store_n(&handle->head, head + 1, __ATOMIC_RELEASE);
+
+    if (handle->notify) handle->notify(handle->user_data);
+    return true;
+}
+
+void keypad_fake_press(char key, uint32_t hold_ms) {
+    keypad_fake_inject(key, KEYPAD_EVENT_PRESS);
+    uint32_t long_press_ms = g_keypad_dev.long_press_ms;
+    if (long_press_ms && hold_ms >= long_press_ms) {
+        vTaskDelay(pdMS_TO_TICKS(long_press_ms));
+        keypad_fake_inject(key, KEYPAD_EVENT_LONG_PRESS);
+        hold_ms -= long_press_ms;
+    }
+    if (hold_ms) vTaskDelay(pdMS_TO_TICKS(hold_ms));
+    keypad_fake_inject(key, KEYPAD_EVENT_RELEASE);
+}
+
+esp_err_t keypad_init(const keypad_config_t *config, keypad_handle_t *handle) {
+    if (!config || !handle) return ESP_ERR_INVALID_ARG;
+    memset(&g_keypad_dev, 0, sizeof(g_keypad_dev));
+    g_keypad_dev.long_press_ms = config->long_press_ms;
+    g_keypad_dev.enabled = true;
+    *handle = &g_keypad_dev;
+    ESP_LOGI(TAG, "Simulated keypad ready");
+    return ESP_OK;
+}
+
+esp_err_t keypad_register_notify(keypad_handle_t handle, keypad_notify_t notify, void *user_data) {
+    handle->user_data = user_data;
+    handle->notify = notify;
+    return ESP_OK;
+}
+
+bool keypad_read_event(keypad_handle_t handle, keypad_event_t *event) {
+    uint32_t tail = handle->tail;
+    uint32_t head = __atomic_load_n(&handle->head, __ATOMIC_ACQUIRE);
+    if (tail == head) return false;
+
+    *event = handle->events[tail % KEYPAD_EVENT_RING_SIZE];
+    __atomic_store_n(&handle->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t keypad_events_pending(keypad_handle_t handle) {
+    return __atomic_load_n(&handle->head, __ATOMIC_ACQUIRE) - handle->tail;
+}
+
+uint32_t keypad_events_dropped(keypad_handle_t handle) {
+    return handle->dropped;
+}
+
+esp_err_t keypad_start(keypad_handle_t handle) {
+    handle->started = true;
+    return ESP_OK;
+}
+
+esp_err_t keypad_stop(keypad_handle_t handle) {
+    handle->started = false;
+    return ESP_OK;
+}
+
+esp_err_t keypad_set_enabled(keypad_handle_t handle, bool enabled) {
+    handle->enabled = enabled;
+    return ESP_OK;
+}
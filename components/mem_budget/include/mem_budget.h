@@ -0,0 +1,49 @@
+#ifndef MEM_BUDGET_H
+#define MEM_BUDGET_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MEM_BUDGET_MAX_ENTRIES 32
+
+typedef enum {
+    MEM_REGION_INTERNAL,
+    MEM_REGION_PSRAM,
+    MEM_REGION_COUNT
+} mem_region_t;
+
+// One statically allocated, long-lived object
+typedef struct {
+    const char *component;
+    const char *object;
+    mem_region_t region;
+    size_t bytes;
+} mem_budget_entry_t;
+
+/**
+ * @brief Record a static object; its region is taken from its address
+ * Call once per object, from the owner's init (strings must stay valid).
+ */
+esp_err_t mem_budget_add(const char *component, const char *object, const void *addr, size_t bytes);
+
+/**
+ * @brief Get entry by index; ESP_ERR_NOT_FOUND past the last one
+ */
+esp_err_t mem_budget_get(size_t index, mem_budget_entry_t *entry);
+
+/**
+ * @brief Sum of the recorded objects in a region
+ */
+size_t mem_budget_total(mem_region_t region);
+
+const char *mem_region_name(mem_region_t region);
+
+/**
+ * @brief Log the objects per component, the heap per region, and whether
+ * internal static memory exceeds internal_limit (0 = no limit)
+ * @return false if over the limit
+ */
+bool mem_budget_report(size_t internal_limit);
+
+#endif // MEM_BUDGET_H
@@ -0,0 +1,120 @@
+#include "mem_budget.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <string.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#endif
+
+static const char *TAG = "MEM_BUDGET";
+
+static mem_budget_entry_t s_entries[MEM_BUDGET_MAX_ENTRIES];
+static size_t s_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+const char *mem_region_name(mem_region_t region) {
+    switch (region) {
+        case MEM_REGION_INTERNAL: return "internal";
+        case MEM_REGION_PSRAM:    return "psram";
+        default:                  return "unknown";
+    }
+}
+
+esp_err_t mem_budget_add(const char *component, const char *object, const void *addr, size_t bytes) {
+    if (!component || !object || !addr) return ESP_ERR_INVALID_ARG;
+
+    mem_region_t region = MEM_REGION_INTERNAL;
+#if !CONFIG_IDF_TARGET_LINUX
+    if (esp_ptr_external_ram(addr)) region = MEM_REGION_PSRAM;
+#endif
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (s_count < MEM_BUDGET_MAX_ENTRIES) {
+        s_entries[s_count++] = (mem_budget_entry_t){
+            .component = component, .object = object, .region = region, .bytes = bytes,
+        };
+    } else {
+        ret = ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+esp_err_t mem_budget_get(size_t index, mem_budget_entry_t *entry) {
+    if (!entry) return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&s_lock);
+    if (index < s_count) {
+        *entry = s_entries[index];
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+size_t mem_budget_total(mem_region_t region) {
+    size_t total = 0;
+    mem_budget_entry_t e;
+    for (size_t i = 0; mem_budget_get(i, &e) == ESP_OK; i++) {
+        if (e.region == region) total += e.bytes;
+    }
+    return total;
+}
+
+bool mem_budget_report(size_t internal_limit) {
+    mem_budget_entry_t e;
+
+    ESP_LOGI(TAG, "%-16s %-20s %-8s %8s", "component", "object", "region", "bytes");
+    for (size_t i = 0; mem_budget_get(i, &e) == ESP_OK; i++) {
+        ESP_LOGI(TAG, "%-16s %-20s %-8s %8u", e.component, e.object, mem_region_name(e.region),
+                 (unsigned)e.bytes);
+    }
+
+    // Per-component subtotals, in order of first appearance
+    for (size_t i = 0; mem_budget_get(i, &e) == ESP_OK; i++) {
+        mem_budget_entry_t prev;
+        bool seen = false;
+        for (size_t j = 0; j < i && mem_budget_get(j, &prev) == ESP_OK; j++) {
+            if (strcmp(prev.component, e.component) == 0) seen = true;
+        }
+        if (seen) continue;
+
+        size_t totals[MEM_REGION_COUNT] = {0};
+        mem_budget_entry_t other;
+        for (size_t j = i; mem_budget_get(j, &other) == ESP_OK; j++) {
+            if (strcmp(other.component, e.component) == 0) totals[other.region] += other.bytes;
+        }
+        ESP_LOGI(TAG, "%-16s internal %6u  psram %6u", e.component,
+                 (unsigned)totals[MEM_REGION_INTERNAL], (unsigned)totals[MEM_REGION_PSRAM]);
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    static const struct {
+        mem_region_t region;
+        uint32_t caps;
+    } heaps[] = {
+        {MEM_REGION_INTERNAL, MALLOC_CAP_INTERNAL},
+        {MEM_REGION_PSRAM, MALLOC_CAP_SPIRAM},
+    };
+    for (size_t i = 0; i < sizeof(heaps) / sizeof(heaps[0]); i++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, heaps[i].caps);
+        ESP_LOGI(TAG, "heap %-8s free %7u  min free %7u  largest block %7u",
+                 mem_region_name(heaps[i].region), (unsigned)info.total_free_bytes,
+                 (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block);
+    }
+#endif
+
+    size_t internal = mem_budget_total(MEM_REGION_INTERNAL);
+    ESP_LOGI(TAG, "static total: internal %u, psram %u", (unsigned)internal,
+             (unsigned)mem_budget_total(MEM_REGION_PSRAM));
+    if (internal_limit && internal > internal_limit) {
+        ESP_LOGW(TAG, "Internal static memory %u over budget %u", (unsigned)internal,
+                 (unsigned)internal_limit);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_PREFIX "attendance_"
+#define METRICS_MAX_COLLECTORS 8
+
+// Latency histograms: id, metric name (seconds), help text
+#define METRICS_HISTOGRAMS(X)                                                         \
+    X(METRIC_SCAN_LATENCY,   "scan_duration_seconds",   "Scan start to match result") \
+    X(METRIC_UPLOAD_LATENCY, "upload_post_duration_seconds", "Attendance HTTP POST round trip")
+
+// Upper bounds in milliseconds, shared by every histogram (+Inf is implicit)
+#define METRICS_BUCKETS_MS {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000}
+
+#define METRICS_ENUM_ENTRY(id, name, help) id,
+typedef enum {
+    METRICS_HISTOGRAMS(METRICS_ENUM_ENTRY)
+    METRIC_HISTOGRAM_COUNT
+} metrics_histogram_t;
+#undef METRICS_ENUM_ENTRY
+
+// Writer for the exposition (HTTP chunks, UART, ...)
+typedef esp_err_t (*metrics_write_fn_t)(const char *data, size_t len, void *ctx);
+
+typedef struct metrics_writer metrics_writer_t;
+
+// Adds module-owned series to every scrape; runs in the HTTP server's task
+typedef void (*metrics_collector_t)(metrics_writer_t *w, void *user_data);
+
+/**
+ * @brief Record one latency sample
+ */
+void metrics_observe_us(metrics_histogram_t id, int64_t duration_us);
+
+/**
+ * @brief Add a collector (during start-up)
+ */
+esp_err_t metrics_register_collector(metrics_collector_t collector, void *user_data);
+
+/**
+ * @brief Append formatted text to a scrape (for collectors)
+ */
+void metrics_printf(metrics_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Write every metric in the Prometheus text format (version 0.0.4)
+ * Tasks, heap, event bus, histograms and registered collectors.
+ */
+esp_err_t metrics_write_prometheus(metrics_write_fn_t write, void *ctx);
+
+#endif // METRICS_H
@@ -0,0 +1,265 @@
+#include "metrics.h"
+#include "dlog.h"
+#include "event_bus.h"
+#include "mem_budget.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "METRICS";
+
+#define METRICS_WRITE_CHUNK 1024
+#define METRICS_TASK_SLACK 4        // Tasks created between counting and sampling
+
+typedef struct {
+    uint32_t buckets[10 + 1];       // Non-cumulative; the last one is +Inf
+    uint32_t count;
+    int64_t sum_us;
+} histogram_t;
+
+static const uint32_t s_bounds_ms[] = METRICS_BUCKETS_MS;
+#define BUCKET_COUNT (sizeof(s_bounds_ms) / sizeof(s_bounds_ms[0]))
+_Static_assert(BUCKET_COUNT + 1 == sizeof(((histogram_t *)0)->buckets) / sizeof(uint32_t),
+               "histogram_t.buckets must match METRICS_BUCKETS_MS");
+
+#define METRICS_NAME_ENTRY(id, name, help) [id] = name,
+#define METRICS_HELP_ENTRY(id, name, help) [id] = help,
+static const char *const s_hist_names[METRIC_HISTOGRAM_COUNT] = { METRICS_HISTOGRAMS(METRICS_NAME_ENTRY) };
+static const char *const s_hist_help[METRIC_HISTOGRAM_COUNT] = { METRICS_HISTOGRAMS(METRICS_HELP_ENTRY) };
+
+static histogram_t s_hist[METRIC_HISTOGRAM_COUNT];
+static struct {
+    metrics_collector_t fn;
+    void *user_data;
+} s_collectors[METRICS_MAX_COLLECTORS];
+static size_t s_collector_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+struct metrics_writer {
+    metrics_write_fn_t write;
+    void *ctx;
+    char buf[METRICS_WRITE_CHUNK];
+    size_t len;
+    esp_err_t err;
+};
+
+void metrics_observe_us(metrics_histogram_t id, int64_t duration_us) {
+    if (id >= METRIC_HISTOGRAM_COUNT) return;
+    if (duration_us < 0) duration_us = 0;
+
+    size_t b = 0;
+    while (b < BUCKET_COUNT && duration_us > (int64_t)s_bounds_ms[b] * 1000) b++;
+
+    portENTER_CRITICAL(&s_lock);
+    s_hist[id].buckets[b]++;
+    s_hist[id].count++;
+    s_hist[id].sum_us += duration_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t metrics_register_collector(metrics_collector_t collector, void *user_data) {
+    if (!collector) return ESP_ERR_INVALID_ARG;
+    if (s_collector_count >= METRICS_MAX_COLLECTORS) return ESP_ERR_NO_MEM;
+    s_collectors[s_collector_count].fn = collector;
+    s_collectors[s_collector_count].user_data = user_data;
+    s_collector_count++;
+    return ESP_OK;
+}
+
+static void flush(metrics_writer_t *w) {
+    if (w->len && w->err == ESP_OK) w->err = w->write(w->buf, w->len, w->ctx);
+    w->len = 0;
+}
+
+void metrics_printf(metrics_writer_t *w, const char *fmt, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+
+    if (w->len + n > sizeof(w->buf)) flush(w);
+    memcpy(w->buf + w->len, line, n);
+    w->len += n;
+}
+
+static void write_header(metrics_writer_t *w, const char *name, const char *type, const char *help) {
+    metrics_printf(w, "# HELP " METRICS_PREFIX "%s %s\n", name, help);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "%s %s\n", name, type);
+}
+
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY (+ GENERATE_RUN_TIME_STATS for CPU time)
+static void write_tasks(metrics_writer_t *w) {
+#if configUSE_TRACE_FACILITY
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + METRICS_TASK_SLACK;
+    TaskStatus_t *tasks = malloc(capacity * sizeof(TaskStatus_t));
+    if (!tasks) return;
+    UBaseType_t count = uxTaskGetSystemState(tasks, capacity, NULL);
+
+    write_header(w, "task_stack_free_min_bytes", "gauge", "Lowest free stack space seen");
+    for (UBaseType_t i = 0; i < count; i++) {
+        metrics_printf(w, METRICS_PREFIX "task_stack_free_min_bytes{task=\"%s\"} %lu\n",
+                       tasks[i].pcTaskName, (unsigned long)tasks[i].usStackHighWaterMark);
+    }
+#if configGENERATE_RUN_TIME_STATS
+    write_header(w, "task_cpu_seconds_total", "counter", "CPU time spent running the task");
+    for (UBaseType_t i = 0; i < count; i++) {
+        // The run-time counter ticks in microseconds (esp_timer)
+        metrics_printf(w, METRICS_PREFIX "task_cpu_seconds_total{task=\"%s\"} %.6f\n",
+                       tasks[i].pcTaskName, (double)tasks[i].ulRunTimeCounter / 1e6);
+    }
+#endif
+    free(tasks);
+#endif
+}
+
+static void write_heap(metrics_writer_t *w) {
+#if !CONFIG_IDF_TARGET_LINUX
+    static const struct {
+        const char *region;
+        uint32_t caps;
+    } regions[] = {
+        {"internal", MALLOC_CAP_INTERNAL},
+        {"psram", MALLOC_CAP_SPIRAM},
+    };
+
+    write_header(w, "heap_size_bytes", "gauge", "Heap size");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w, METRICS_PREFIX "heap_size_bytes{region=\"%s\"} %u\n", regions[i].region,
+                       (unsigned)heap_caps_get_total_size(regions[i].caps));
+    }
+    write_header(w, "heap_free_bytes", "gauge", "Free heap");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w, METRICS_PREFIX "heap_free_bytes{region=\"%s\"} %u\n", regions[i].region,
+                       (unsigned)heap_caps_get_free_size(regions[i].caps));
+    }
+    write_header(w, "heap_free_min_bytes", "gauge", "Lowest free heap since boot");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w, METRICS_PREFIX "heap_free_min_bytes{region=\"%s\"} %u\n", regions[i].region,
+                       (unsigned)heap_caps_get_minimum_free_size(regions[i].caps));
+    }
+    write_header(w, "heap_largest_free_block_bytes", "gauge", "Largest allocatable block");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w, METRICS_PREFIX "heap_largest_free_block_bytes{region=\"%s\"} %u\n",
+                       regions[i].region, (unsigned)heap_caps_get_largest_free_block(regions[i].caps));
+    }
+#endif
+}
+
+static void write_static_memory(metrics_writer_t *w) {
+    mem_budget_entry_t e;
+    write_header(w, "static_bytes", "gauge", "Long-lived static objects by owner and region");
+    for (size_t i = 0; mem_budget_get(i, &e) == ESP_OK; i++) {
+        metrics_printf(w, METRICS_PREFIX "static_bytes{component=\"%s\",object=\"%s\","
+                       "region=\"%s\"} %u\n", e.component, e.object, mem_region_name(e.region),
+                       (unsigned)e.bytes);
+    }
+}
+
+static void write_event_bus(metrics_writer_t *w) {
+    event_bus_stats_t bus;
+    event_bus_get_stats(&bus);
+
+    write_header(w, "events_published_total", "counter", "Messages published on the event bus");
+    metrics_printf(w, METRICS_PREFIX "events_published_total %lu\n", (unsigned long)bus.published);
+    write_header(w, "events_pool_exhausted_total", "counter", "Publishes lost because no slot was free");
+    metrics_printf(w, METRICS_PREFIX "events_pool_exhausted_total %lu\n",
+                   (unsigned long)bus.pool_exhausted);
+    write_header(w, "event_slots_in_use", "gauge", "Event slots held by subscribers");
+    metrics_printf(w, METRICS_PREFIX "event_slots_in_use %lu\n", (unsigned long)bus.slots_in_use);
+    write_header(w, "event_slots_high_water", "gauge", "Most event slots held at once");
+    metrics_printf(w, METRICS_PREFIX "event_slots_high_water %lu\n",
+                   (unsigned long)bus.slots_high_water);
+
+    event_subscriber_stats_t sub;
+    write_header(w, "events_delivered_total", "counter", "Events queued to a subscriber");
+    for (size_t i = 0; event_bus_get_subscriber_stats(i, &sub) == ESP_OK; i++) {
+        metrics_printf(w, METRICS_PREFIX "events_delivered_total{subscriber=\"%s\"} %lu\n",
+                       sub.name, (unsigned long)sub.delivered);
+    }
+    write_header(w, "events_dropped_total", "counter", "Events lost to a full subscriber queue");
+    for (size_t i = 0; event_bus_get_subscriber_stats(i, &sub) == ESP_OK; i++) {
+        metrics_printf(w, METRICS_PREFIX "events_dropped_total{subscriber=\"%s\"} %lu\n",
+                       sub.name, (unsigned long)sub.dropped);
+    }
+    write_header(w, "queue_depth", "gauge", "Events waiting in a subscriber queue");
+    for (size_t i = 0; event_bus_get_subscriber_stats(i, &sub) == ESP_OK; i++) {
+        metrics_printf(w, METRICS_PREFIX "queue_depth{subscriber=\"%s\"} %lu\n",
+                       sub.name, (unsigned long)sub.waiting);
+    }
+    write_header(w, "queue_capacity", "gauge", "Subscriber queue length");
+    for (size_t i = 0; event_bus_get_subscriber_stats(i, &sub) == ESP_OK; i++) {
+        metrics_printf(w, METRICS_PREFIX "queue_capacity{subscriber=\"%s\"} %lu\n",
+                       sub.name, (unsigned long)sub.depth);
+    }
+}
+
+static void write_dlog(metrics_writer_t *w) {
+    dlog_stats_t log;
+    dlog_get_stats(&log);
+
+    write_header(w, "log_records_total", "counter", "Deferred log records queued");
+    metrics_printf(w, METRICS_PREFIX "log_records_total %lu\n", (unsigned long)log.written);
+    write_header(w, "log_dropped_total", "counter", "Deferred log records lost to a full ring");
+    metrics_printf(w, METRICS_PREFIX "log_dropped_total %lu\n", (unsigned long)log.dropped);
+    write_header(w, "log_ring_high_water_bytes", "gauge", "Most deferred log bytes waiting at once");
+    metrics_printf(w, METRICS_PREFIX "log_ring_high_water_bytes %lu\n",
+                   (unsigned long)log.high_water);
+}
+
+static void write_histograms(metrics_writer_t *w) {
+    for (int id = 0; id < METRIC_HISTOGRAM_COUNT; id++) {
+        portENTER_CRITICAL(&s_lock);
+        histogram_t h = s_hist[id];
+        portEXIT_CRITICAL(&s_lock);
+
+        const char *name = s_hist_names[id];
+        write_header(w, name, "histogram", s_hist_help[id]);
+        uint32_t cumulative = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; b++) {
+            cumulative += h.buckets[b];
+            metrics_printf(w, METRICS_PREFIX "%s_bucket{le=\"%g\"} %lu\n", name,
+                           s_bounds_ms[b] / 1000.0, (unsigned long)cumulative);
+        }
+        metrics_printf(w, METRICS_PREFIX "%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long)h.count);
+        metrics_printf(w, METRICS_PREFIX "%s_sum %.6f\n", name, h.sum_us / 1e6);
+        metrics_printf(w, METRICS_PREFIX "%s_count %lu\n", name, (unsigned long)h.count);
+    }
+}
+
+esp_err_t metrics_write_prometheus(metrics_write_fn_t write, void *ctx) {
+    if (!write) return ESP_ERR_INVALID_ARG;
+
+    metrics_writer_t *w = malloc(sizeof(metrics_writer_t));
+    if (!w) return ESP_ERR_NO_MEM;
+    *w = (metrics_writer_t){.write = write, .ctx = ctx};
+
+    write_header(w, "uptime_seconds", "gauge", "Time since boot");
+    metrics_printf(w, METRICS_PREFIX "uptime_seconds %.3f\n", esp_timer_get_time() / 1e6);
+    write_tasks(w);
+    write_heap(w);
+    write_static_memory(w);
+    write_event_bus(w);
+    write_dlog(w);
+    write_histograms(w);
+    for (size_t i = 0; i < s_collector_count; i++) {
+        s_collectors[i].fn(w, s_collectors[i].user_data);
+    }
+    flush(w);
+
+    esp_err_t ret = w->err;
+    free(w);
+    if (ret != ESP_OK) ESP_LOGW(TAG, "Scrape aborted: %s", esp_err_to_name(ret));
+    return ret;
+}
@@ -15,11 +15,31 @@ typedef struct {
 
 typedef struct mp3_driver* mp3_handle_t;
 
+// Unsolicited frames from the DFPlayer, parsed by the driver's UART reader
+typedef enum {
+    MP3_EVENT_ACK,              // Command accepted (sent with feedback requested)
+    MP3_EVENT_ERROR,            // param: DFPlayer error code (busy, checksum, ...)
+    MP3_EVENT_TRACK_FINISHED    // param: track number, once per track (repeat frame dropped)
+} mp3_event_type_t;
+
+typedef struct {
+    mp3_event_type_t type;
+    uint16_t param;
+} mp3_event_t;
+
+// Called from the driver's reader task; keep it short (post to a queue)
+typedef void (*mp3_event_callback_t)(const mp3_event_t *event, void *user_data);
+
 /**
  * @brief Initialize MP3 player
  */
 esp_err_t mp3_init(const mp3_config_t *config, mp3_handle_t *handle);
 
+/**
+ * @brief Register callback for player events
+ */
+esp_err_t mp3_register_callback(mp3_handle_t handle, mp3_event_callback_t callback, void *user_data);
+
 /**
  * @brief Query number of files (and check if SD is present)
  */
@@ -32,6 +52,8 @@ esp_err_t mp3_set_volume(mp3_handle_t handle, uint8_t volume);
 
 /**
  * @brief Play specific track by index (0001.mp3 = 1)
+ * Interrupts whatever is playing. The module answers with MP3_EVENT_ACK
+ * (or MP3_EVENT_ERROR) and should not get another command before that.
  */
 esp_err_t mp3_play_track(mp3_handle_t handle, uint8_t track_num);
 
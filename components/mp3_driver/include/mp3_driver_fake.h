@@ -0,0 +1,23 @@
+#ifndef MP3_DRIVER_FAKE_H
+#define MP3_DRIVER_FAKE_H
+
+#include <stdint.h>
+
+// Host build only: controls for the simulated DFPlayer
+
+/**
+ * @brief Delay before the ack of a play command, and how long every track plays
+ */
+void mp3_fake_set_timing(uint32_t ack_ms, uint32_t track_ms);
+
+/**
+ * @brief Files reported on the SD card (default 20)
+ */
+void mp3_fake_set_file_count(uint16_t count);
+
+/**
+ * @brief Play commands received so far
+ */
+uint32_t mp3_fake_play_count(void);
+
+#endif // MP3_DRIVER_FAKE_H
@@ -2,107 +2,260 @@
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "mem_budget.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include <string.h>
 
 static const char *TAG = "MP3_DRIVER";
 
+#define MP3_FRAME_LEN 10
+#define MP3_RX_TASK_STACK 3072
+#define MP3_RX_TASK_PRIORITY 8
+#define MP3_UART_EVENT_QUEUE_LEN 16
+#define MP3_QUERY_TIMEOUT_MS 500
+#define MP3_FINISHED_DEDUP_MS 150   // The module reports each track end twice
+
+// DFPlayer commands and responses
+#define MP3_CMD_PLAY_TRACK 0x03
+#define MP3_CMD_SET_VOLUME 0x06
+#define MP3_CMD_STOP 0x16
+#define MP3_RSP_TRACK_FINISHED 0x3D
+#define MP3_RSP_ONLINE 0x3F
+#define MP3_RSP_ERROR 0x40
+#define MP3_RSP_ACK 0x41
+#define MP3_QUERY_FILE_COUNT 0x48
+
 struct mp3_driver {
     int uart_num;
     int tx_pin;
     int rx_pin;
     int baud_rate;
+    QueueHandle_t uart_queue;
+    mp3_event_callback_t callback;
+    void *user_data;
+
+    // Frame assembly (reader task only)
+    uint8_t rx[MP3_FRAME_LEN];
+    size_t rx_len;
+    uint16_t last_finished;
+    TickType_t last_finished_at;
+
+    // One synchronous query at a time (boot checks)
+    SemaphoreHandle_t query_lock;
+    SemaphoreHandle_t query_done;
+    StaticSemaphore_t query_lock_buf;
+    StaticSemaphore_t query_done_buf;
+    volatile uint8_t query_cmd;
+    volatile uint16_t query_param;
+    volatile esp_err_t query_err;
 };
-static struct mp3_driver g_mp3_dev; 
+static struct mp3_driver g_mp3_dev;
+// Small, and on the ack path that paces audio: kept in internal RAM
+static StackType_t s_rx_stack[MP3_RX_TASK_STACK];
+static StaticTask_t s_rx_task;
 
 // Helper to calculate checksum and send
-static void mp3_send_cmd(int uart_num, uint8_t cmd, uint16_t param) {
-    // 7E FF 06 CMD 00 [ParamH] [ParamL] [ChkH] [ChkL] EF
+static void mp3_send_cmd(int uart_num, uint8_t cmd, uint16_t param, bool feedback) {
+    // 7E FF 06 CMD [Feedback] [ParamH] [ParamL] [ChkH] [ChkL] EF
     uint8_t param_h = (uint8_t)(param >> 8);
     uint8_t param_l = (uint8_t)(param & 0xFF);
-    
-    uint16_t sum = 0xFF + 0x06 + cmd + 0x00 + param_h + param_l;
+    uint8_t fb = feedback ? 0x01 : 0x00;
+
+    uint16_t sum = 0xFF + 0x06 + cmd + fb + param_h + param_l;
     uint16_t checksum = 0 - sum;
-    
+
     const uint8_t packet[] = {
-        0x7E, 0xFF, 0x06, cmd, 0x00, param_h, param_l,
+        0x7E, 0xFF, 0x06, cmd, fb, param_h, param_l,
         (uint8_t)(checksum >> 8), (uint8_t)(checksum & 0xFF),
         0xEF
     };
-    
+
     uart_write_bytes(uart_num, (const char*)packet, sizeof(packet));
 }
 
+static bool frame_valid(const uint8_t *f) {
+    if (f[0] != 0x7E || f[1] != 0xFF || f[2] != 0x06 || f[9] != 0xEF) return false;
+    uint16_t sum = 0;
+    for (int i = 1; i < 7; i++) sum += f[i];
+    return (uint16_t)(sum + ((f[7] << 8) | f[8])) == 0;
+}
+
+static void emit(struct mp3_driver *dev, mp3_event_type_t type, uint16_t param) {
+    if (!dev->callback) return;
+    mp3_event_t event = {.type = type, .param = param};
+    dev->callback(&event, dev->user_data);
+}
+
+static void handle_frame(struct mp3_driver *dev, const uint8_t *f) {
+    uint8_t cmd = f[3];
+    uint16_t param = (f[5] << 8) | f[6];
+
+    if (dev->query_cmd && (cmd == dev->query_cmd || cmd == MP3_RSP_ERROR)) {
+        dev->query_param = param;
+        dev->query_err = (cmd == MP3_RSP_ERROR) ? ESP_FAIL : ESP_OK;
+        dev->query_cmd = 0;
+        xSemaphoreGive(dev->query_done);
+        if (cmd != MP3_RSP_ERROR) return;
+    }
+
+    switch (cmd) {
+        case MP3_RSP_ACK:            emit(dev, MP3_EVENT_ACK, param); break;
+        case MP3_RSP_ERROR:          emit(dev, MP3_EVENT_ERROR, param); break;
+        case MP3_RSP_TRACK_FINISHED: {
+            // Drop the repeat so a playlist does not skip a track
+            TickType_t now = xTaskGetTickCount();
+            if (param == dev->last_finished &&
+                now - dev->last_finished_at < pdMS_TO_TICKS(MP3_FINISHED_DEDUP_MS)) {
+                break;
+            }
+            dev->last_finished = param;
+            dev->last_finished_at = now;
+            emit(dev, MP3_EVENT_TRACK_FINISHED, param);
+            break;
+        }
+        default: break;   // Card inserted/removed, power-on "online", ...
+    }
+}
+
+// Reassembles 10-byte frames, resynchronising on the 0x7E start byte
+static void feed_byte(struct mp3_driver *dev, uint8_t b) {
+    if (dev->rx_len == 0 && b != 0x7E) return;
+    dev->rx[dev->rx_len++] = b;
+    if (dev->rx_len < MP3_FRAME_LEN) return;
+
+    if (frame_valid(dev->rx)) {
+        handle_frame(dev, dev->rx);
+        dev->rx_len = 0;
+        return;
+    }
+    // Garbage: restart at the next start byte inside what we have
+    size_t next = 1;
+    while (next < MP3_FRAME_LEN && dev->rx[next] != 0x7E) next++;
+    dev->rx_len = MP3_FRAME_LEN - next;
+    memmove(dev->rx, dev->rx + next, dev->rx_len);
+}
+
+// Sleeps on the UART driver's event queue; no polling
+static void mp3_rx_task(void *arg) {
+    struct mp3_driver *dev = (struct mp3_driver *)arg;
+    uart_event_t event;
+    uint8_t buf[64];
+
+    while (1) {
+        if (xQueueReceive(dev->uart_queue, &event, portMAX_DELAY) != pdTRUE) continue;
+
+        switch (event.type) {
+            case UART_DATA: {
+                int len;
+                while ((len = uart_read_bytes(dev->uart_num, buf, sizeof(buf), 0)) > 0) {
+                    for (int i = 0; i < len; i++) feed_byte(dev, buf[i]);
+                }
+                break;
+            }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW(TAG, "RX overflow, resyncing");
+                uart_flush_input(dev->uart_num);
+                xQueueReset(dev->uart_queue);
+                dev->rx_len = 0;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Sends a query and waits for the reader task to hand over the answer
+// (the module answers with a frame carrying the same command byte)
+static esp_err_t mp3_query(struct mp3_driver *dev, uint8_t cmd, uint16_t *param) {
+    xSemaphoreTake(dev->query_lock, portMAX_DELAY);
+    xSemaphoreTake(dev->query_done, 0);   // Drop a stale answer
+    dev->query_cmd = cmd;
+    mp3_send_cmd(dev->uart_num, cmd, 0, false);
+
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    if (xSemaphoreTake(dev->query_done, pdMS_TO_TICKS(MP3_QUERY_TIMEOUT_MS)) == pdTRUE) {
+        ret = dev->query_err;
+        *param = dev->query_param;
+    }
+    dev->query_cmd = 0;
+    xSemaphoreGive(dev->query_lock);
+    return ret;
+}
+
 esp_err_t mp3_init(const mp3_config_t *config, mp3_handle_t *handle) {
     if (!config || !handle) return ESP_ERR_INVALID_ARG;
-    
+
     uart_config_t uart_cfg = {
         .baud_rate = config->baud_rate, .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE, .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE, .source_clk = UART_SCLK_DEFAULT,
     };
 
-    ESP_ERROR_CHECK(uart_driver_install(config->uart_num, 1024, 0, 0, NULL, 0));
+    struct mp3_driver *dev = &g_mp3_dev;
+    ESP_ERROR_CHECK(uart_driver_install(config->uart_num, 1024, 0, MP3_UART_EVENT_QUEUE_LEN,
+                                        &dev->uart_queue, 0));
     ESP_ERROR_CHECK(uart_param_config(config->uart_num, &uart_cfg));
     ESP_ERROR_CHECK(uart_set_pin(config->uart_num, config->tx_pin, config->rx_pin, -1, -1));
+    // Report a frame as soon as its 10 bytes are in
+    uart_set_rx_full_threshold(config->uart_num, MP3_FRAME_LEN);
+
+    dev->uart_num = config->uart_num;
+    dev->query_lock = xSemaphoreCreateMutexStatic(&dev->query_lock_buf);
+    dev->query_done = xSemaphoreCreateBinaryStatic(&dev->query_done_buf);
+    xTaskCreateStatic(mp3_rx_task, "mp3_rx", MP3_RX_TASK_STACK, dev, MP3_RX_TASK_PRIORITY,
+                      s_rx_stack, &s_rx_task);
+    mem_budget_add("mp3_driver", "mp3_rx stack", s_rx_stack, sizeof(s_rx_stack) + sizeof(s_rx_task));
+    *handle = dev;
 
-    g_mp3_dev.uart_num = config->uart_num;
-    *handle = &g_mp3_dev;
-    
     mp3_set_volume(*handle, config->volume);
     return ESP_OK;
 }
 
+esp_err_t mp3_register_callback(mp3_handle_t handle, mp3_event_callback_t callback, void *user_data) {
+    handle->user_data = user_data;
+    handle->callback = callback;
+    return ESP_OK;
+}
+
 esp_err_t mp3_set_volume(mp3_handle_t handle, uint8_t volume) {
     struct mp3_driver *dev = (struct mp3_driver *)handle;
     if (volume > 30) volume = 30;
-    mp3_send_cmd(dev->uart_num, 0x06, volume); // 0x06 = Set Volume
+    mp3_send_cmd(dev->uart_num, MP3_CMD_SET_VOLUME, volume, false);
     return ESP_OK;
 }
 
 esp_err_t mp3_play_track(mp3_handle_t handle, uint8_t track_num) {
     struct mp3_driver *dev = (struct mp3_driver *)handle;
-    // 0x03 = Specify Tracking (0-2999)
-    mp3_send_cmd(dev->uart_num, 0x03, track_num);
+    // Specify Tracking (0-2999), acknowledged so callers can pace commands
+    mp3_send_cmd(dev->uart_num, MP3_CMD_PLAY_TRACK, track_num, true);
     return ESP_OK;
 }
 
 esp_err_t mp3_stop(mp3_handle_t handle) {
     struct mp3_driver *dev = (struct mp3_driver *)handle;
-    // 0x16 = Stop
-    mp3_send_cmd(dev->uart_num, 0x16, 0);
+    mp3_send_cmd(dev->uart_num, MP3_CMD_STOP, 0, false);
     return ESP_OK;
 }
 
 esp_err_t mp3_get_file_count(mp3_handle_t handle, uint16_t *count) {
     struct mp3_driver *dev = (struct mp3_driver *)handle;
-    uart_flush_input(dev->uart_num);
+    uint16_t param = 0;
 
     // 1. Check Online Status (0x3F)
-    // 0 - (FF+06+3F) = 0 - 144 = FBBZ -> FE BC
-    const uint8_t cmd_online[] = {0x7E, 0xFF, 0x06, 0x3F, 0x00, 0x00, 0x00, 0xFE, 0xBC, 0xEF};
-    uart_write_bytes(dev->uart_num, (const char*)cmd_online, 10);
-    uint8_t buf[10];
-    int len = uart_read_bytes(dev->uart_num, buf, 10, pdMS_TO_TICKS(500));
-
-    if (len == 10 && buf[3] == 0x3F) {
-        if (!(buf[6] & 0x02)) { // SD Card bit check
-            ESP_LOGW(TAG, "SD Card not detected");
-            return ESP_ERR_NOT_FOUND;
-        }
-    } else {
-        return ESP_ERR_TIMEOUT;
+    esp_err_t ret = mp3_query(dev, MP3_RSP_ONLINE, &param);
+    if (ret != ESP_OK) return ESP_ERR_TIMEOUT;
+    if (!(param & 0x02)) { // SD Card bit check
+        ESP_LOGW(TAG, "SD Card not detected");
+        return ESP_ERR_NOT_FOUND;
     }
 
     // 2. Query File Count (0x48)
-    uart_flush_input(dev->uart_num);
-    // 0 - (FF+06+48) = 0 - 14D = FBB3 -> FE B3
-    const uint8_t cmd_count[] = {0x7E, 0xFF, 0x06, 0x48, 0x00, 0x00, 0x00, 0xFE, 0xB3, 0xEF};
-    uart_write_bytes(dev->uart_num, (const char*)cmd_count, 10);
-    len = uart_read_bytes(dev->uart_num, buf, 10, pdMS_TO_TICKS(500));
-
-    if (len == 10 && buf[3] == 0x48) {
-        *count = (buf[5] << 8) | buf[6];
-        return ESP_OK;
-    }
-    return ESP_ERR_TIMEOUT;
-}
\ No newline at end of file
+    ret = mp3_query(dev, MP3_QUERY_FILE_COUNT, &param);
+    if (ret != ESP_OK) return ESP_ERR_TIMEOUT;
+    *count = param;
+    return ESP_OK;
+}
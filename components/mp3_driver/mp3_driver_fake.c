@@ -0,0 +1,96 @@
+#include "mp3_driver.h"
+#include "mp3_driver_fake.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+static const char *TAG = "MP3_FAKE";
+
+struct mp3_driver {
+    mp3_event_callback_t callback;
+    void *user_data;
+    TimerHandle_t ack_timer;
+    TimerHandle_t finish_timer;
+    uint8_t track;
+    uint32_t ack_ms;
+    uint32_t track_ms;
+    uint16_t file_count;
+    uint32_t plays;
+};
+static struct mp3_driver g_mp3_dev = {.ack_ms = 30, .track_ms = 600, .file_count = 20};
+
+// Timer service task, like the real driver's reader task
+static void emit(struct mp3_driver *dev, mp3_event_type_t type, uint16_t param) {
+    if (!dev->callback) return;
+    mp3_event_t event = {.type = type, .param = param};
+    dev->callback(&event, dev->user_data);
+}
+
+static void ack_due(TimerHandle_t timer) {
+    struct mp3_driver *dev = pvTimerGetTimerID(timer);
+    emit(dev, MP3_EVENT_ACK, 0);
+}
+
+static void finish_due(TimerHandle_t timer) {
+    struct mp3_driver *dev = pvTimerGetTimerID(timer);
+    emit(dev, MP3_EVENT_TRACK_FINISHED, dev->track);
+}
+
+static TickType_t ticks(uint32_t ms) {
+    TickType_t t = pdMS_TO_TICKS(ms);
+    return t ? t : 1;
+}
+
+void mp3_fake_set_timing(uint32_t ack_ms, uint32_t track_ms) {
+    g_mp3_dev.ack_ms = ack_ms;
+    g_mp3_dev.track_ms = track_ms;
+}
+
+void mp3_fake_set_file_count(uint16_t count) {
+    g_mp3_dev.file_count = count;
+}
+
+uint32_t mp3_fake_play_count(void) {
+    return g_mp3_dev.plays;
+}
+
+esp_err_t mp3_init(const mp3_config_t *config, mp3_handle_t *handle) {
+    if (!config || !handle) return ESP_ERR_INVALID_ARG;
+    struct mp3_driver *dev = &g_mp3_dev;
+    dev->ack_timer = xTimerCreate("mp3_ack", 1, pdFALSE, dev, ack_due);
+    dev->finish_timer = xTimerCreate("mp3_end", 1, pdFALSE, dev, finish_due);
+    if (!dev->ack_timer || !dev->finish_timer) return ESP_ERR_NO_MEM;
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t mp3_register_callback(mp3_handle_t handle, mp3_event_callback_t callback, void *user_data) {
+    handle->user_data = user_data;
+    handle->callback = callback;
+    return ESP_OK;
+}
+
+esp_err_t mp3_get_file_count(mp3_handle_t handle, uint16_t *count) {
+    *count = handle->file_count;
+    return ESP_OK;
+}
+
+esp_err_t mp3_set_volume(mp3_handle_t handle, uint8_t volume) {
+    ESP_LOGD(TAG, "Volume %u", volume);
+    return ESP_OK;
+}
+
+esp_err_t mp3_play_track(mp3_handle_t handle, uint8_t track_num) {
+    // Playing a track stops the current one, as on the module
+    handle->track = track_num;
+    handle->plays++;
+    ESP_LOGI(TAG, "Playing track %03u", track_num);
+    xTimerChangePeriod(handle->ack_timer, ticks(handle->ack_ms), portMAX_DELAY);
+    xTimerChangePeriod(handle->finish_timer, ticks(handle->track_ms), portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t mp3_stop(mp3_handle_t handle) {
+    xTimerStop(handle->finish_timer, portMAX_DELAY);
+    return ESP_OK;
+}
@@ -3,15 +3,34 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 // Network event callback type
 typedef void (*network_event_callback_t)(bool connected, void *user_data);
 
+// Link statistics (time-to-online)
+typedef struct {
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t boot_to_online_ms;   // Power-on to first IP
+    uint32_t last_connect_ms;     // Start/link loss to IP, most recent
+} network_stats_t;
+
 /**
  * @brief Initialize network manager (Wi-Fi + HTTP client)
+ * Returns as soon as Wi-Fi is started; association, DHCP and reconnects
+ * (with backoff, never giving up) run in the background and are reported
+ * through the registered callback.
  */
 esp_err_t network_manager_init(const char *ssid, const char *password);
 
+/**
+ * @brief Use a static IP instead of DHCP (call before network_manager_init)
+ * @param dns Optional DNS server, may be NULL or ""
+ */
+esp_err_t network_manager_set_static_ip(const char *ip, const char *netmask,
+                                        const char *gateway, const char *dns);
+
 /**
  * @brief Register callback for network events
  */
@@ -22,6 +41,11 @@ esp_err_t network_manager_register_callback(network_event_callback_t callback, v
  */
 bool network_is_connected(void);
 
+/**
+ * @brief Get link statistics
+ */
+void network_get_stats(network_stats_t *stats);
+
 /**
  * @brief Send HTTP POST request with JSON payload
  * @param url Server URL
@@ -30,6 +54,14 @@ bool network_is_connected(void);
  */
 esp_err_t network_http_post(const char *url, const char *json_data);
 
+/**
+ * @brief Send HTTP POST request and keep the response body
+ * @param response Buffer for the body (truncated to fit, NUL-terminated)
+ * @return ESP_OK on a 2xx status
+ */
+esp_err_t network_http_post_read(const char *url, const char *json_data,
+                                 char *response, size_t response_size);
+
 /**
  * @brief Check if HTTP server is reachable
  */
@@ -40,4 +72,10 @@ bool network_is_server_reachable(const char *url);
  */
 esp_err_t network_hardware_check(void);
 
+/**
+ * @brief Get a stable device identifier (Wi-Fi STA MAC as 12 hex chars)
+ * @param buffer Output buffer, at least 13 bytes
+ */
+esp_err_t network_get_device_id(char *buffer, size_t buffer_size);
+
 #endif // NETWORK_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef NETWORK_MANAGER_FAKE_H
+#define NETWORK_MANAGER_FAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host build only: link state and a simulated attendance server that
+// acknowledges every POSTed batch
+
+/**
+ * @brief Bring the simulated link up or down (reported through the callback)
+ */
+void network_fake_set_link(bool connected);
+
+/**
+ * @brief Round trip of an HTTP POST; fail_pct of them fail outright
+ */
+void network_fake_set_post(uint32_t latency_ms, uint8_t fail_pct);
+
+/**
+ * @brief POSTs seen so far
+ */
+uint32_t network_fake_post_count(void);
+
+#endif // NETWORK_MANAGER_FAKE_H
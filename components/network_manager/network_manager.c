@@ -1,65 +1,182 @@
 #include "network_manager.h"
+#include "dlog.h"
 #include "esp_wifi.h"
+#include "esp_mac.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "nvs_flash.h"
+#include "nvs.h"
+#include "retry_scheduler.h"
+#include "time_manager.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 static const char *TAG = "NETWORK";
 
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+// Reconnect backoff: never gives up, caps at WIFI_RECONNECT_MAX_MS
+#define WIFI_RECONNECT_BASE_MS   250
+#define WIFI_RECONNECT_MAX_MS    30000
+// Failed fast-connect attempts before falling back to a full scan
+#define WIFI_FAST_CONNECT_TRIES  2
+
+#define NVS_NAMESPACE "netcache"
 
-static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 static bool s_is_connected = false;
 static network_event_callback_t s_callback = NULL;
 static void *s_callback_user_data = NULL;
 
+static esp_netif_t *s_sta_netif = NULL;
+static esp_timer_handle_t s_reconnect_timer = NULL;
+static wifi_config_t s_wifi_config;
+static bool s_fast_connect = false;
+
+static bool s_use_static_ip = false;
+static esp_netif_ip_info_t s_static_ip;
+static esp_netif_dns_info_t s_static_dns;
+
+static network_stats_t s_stats;
+static int64_t s_connect_started_us = 0;
+
+// --- Cached AP parameters (BSSID + channel) ---
+
+static bool load_cached_ap(uint8_t bssid[6], uint8_t *channel) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return false;
+    size_t len = 6;
+    bool ok = nvs_get_blob(nvs, "bssid", bssid, &len) == ESP_OK && len == 6 &&
+              nvs_get_u8(nvs, "channel", channel) == ESP_OK && *channel != 0;
+    nvs_close(nvs);
+    return ok;
+}
+
+static void store_cached_ap(const uint8_t bssid[6], uint8_t channel) {
+    uint8_t old_bssid[6];
+    uint8_t old_channel;
+    // Skip the flash write when nothing changed
+    if (load_cached_ap(old_bssid, &old_channel) &&
+        memcmp(old_bssid, bssid, 6) == 0 && old_channel == channel) {
+        return;
+    }
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_blob(nvs, "bssid", bssid, 6);
+    nvs_set_u8(nvs, "channel", channel);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d", MAC2STR(bssid), channel);
+}
+
+static void disable_fast_connect(void) {
+    ESP_LOGW(TAG, "Fast connect failed, falling back to full scan");
+    s_fast_connect = false;
+    s_wifi_config.sta.bssid_set = false;
+    s_wifi_config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+}
+
+static void reconnect_timer_callback(void *arg) {
+    esp_wifi_connect();
+}
+
+static void schedule_reconnect(void) {
+    if (s_fast_connect && s_retry_num >= WIFI_FAST_CONNECT_TRIES) {
+        disable_fast_connect();
+    }
+    uint32_t delay_ms = retry_backoff_delay_ms(WIFI_RECONNECT_BASE_MS, WIFI_RECONNECT_MAX_MS, s_retry_num);
+    s_retry_num++;
+    ESP_LOGI(TAG, "Reconnecting in %lu ms (attempt %d)", (unsigned long)delay_ms, s_retry_num);
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000 + 1);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                 int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        s_connect_started_us = esp_timer_get_time();
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        store_cached_ap(event->bssid, event->channel);
+        if (s_use_static_ip) {
+            // No DHCP round-trip: the address is usable as soon as we associate
+            esp_netif_dhcpc_stop(s_sta_netif);
+            esp_netif_set_ip_info(s_sta_netif, &s_static_ip);
+            if (s_static_dns.ip.u_addr.ip4.addr) {
+                esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &s_static_dns);
+            }
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < 5) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retry connecting to AP, attempt %d", s_retry_num);
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        if (s_is_connected) {
+            // Start timing the outage from the moment the link dropped
+            s_connect_started_us = esp_timer_get_time();
+            s_stats.disconnects++;
         }
         s_is_connected = false;
         if (s_callback) {
             s_callback(false, s_callback_user_data);
         }
         ESP_LOGI(TAG, "Connection to AP failed");
+        schedule_reconnect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        uint32_t online_ms = (uint32_t)((esp_timer_get_time() - s_connect_started_us) / 1000);
+        if (s_stats.connects == 0) {
+            s_stats.boot_to_online_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        }
+        s_stats.connects++;
+        s_stats.last_connect_ms = online_ms;
+        ESP_LOGI(TAG, "Got IP: " IPSTR " (%lu ms, %d retries)", IP2STR(&event->ip_info.ip),
+                 (unsigned long)online_ms, s_retry_num);
         s_retry_num = 0;
         s_is_connected = true;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         if (s_callback) {
             s_callback(true, s_callback_user_data);
         }
     }
 }
 
+esp_err_t network_manager_set_static_ip(const char *ip, const char *netmask,
+                                        const char *gateway, const char *dns) {
+    if (!ip || !netmask || !gateway) return ESP_ERR_INVALID_ARG;
+
+    memset(&s_static_ip, 0, sizeof(s_static_ip));
+    memset(&s_static_dns, 0, sizeof(s_static_dns));
+    if (esp_netif_str_to_ip4(ip, &s_static_ip.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(netmask, &s_static_ip.netmask) != ESP_OK ||
+        esp_netif_str_to_ip4(gateway, &s_static_ip.gw) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dns && dns[0]) {
+        if (esp_netif_str_to_ip4(dns, &s_static_dns.ip.u_addr.ip4) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_static_dns.ip.type = IPADDR_TYPE_V4;
+    }
+    s_use_static_ip = true;
+    return ESP_OK;
+}
+
 esp_err_t network_manager_init(const char *ssid, const char *password) {
     ESP_LOGI(TAG, "Initializing network manager");
     
-    s_wifi_event_group = xEventGroupCreate();
-    
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
     
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     
+    esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_callback,
+        .name = "wifi_reconnect"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_reconnect_timer));
+    
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
@@ -73,7 +190,7 @@ esp_err_t network_manager_init(const char *ssid, const char *password) {
                                                         NULL,
                                                         &instance_got_ip));
     
-    wifi_config_t wifi_config = {
+    s_wifi_config = (wifi_config_t){
         .sta = {
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
             .pmf_cfg = {
@@ -82,30 +199,26 @@ esp_err_t network_manager_init(const char *ssid, const char *password) {
             },
         },
     };
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+    strncpy((char *)s_wifi_config.sta.ssid, ssid, sizeof(s_wifi_config.sta.ssid) - 1);
+    strncpy((char *)s_wifi_config.sta.password, password, sizeof(s_wifi_config.sta.password) - 1);
+    
+    // Fast connect: go straight to the last AP on its channel, no scan
+    uint8_t channel;
+    if (load_cached_ap(s_wifi_config.sta.bssid, &channel)) {
+        s_wifi_config.sta.bssid_set = true;
+        s_wifi_config.sta.channel = channel;
+        s_fast_connect = true;
+        ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %d",
+                 MAC2STR(s_wifi_config.sta.bssid), channel);
+    }
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
     
+    // Association continues in the background; the callback reports the link
     ESP_LOGI(TAG, "Network manager initialized, connecting to %s", ssid);
-    
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-    
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP");
-        return ESP_OK;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGE(TAG, "Failed to connect to AP");
-        return ESP_FAIL;
-    }
-    
-    return ESP_ERR_TIMEOUT;
+    return ESP_OK;
 }
 
 esp_err_t network_manager_register_callback(network_event_callback_t callback, void *user_data) {
@@ -118,28 +231,84 @@ bool network_is_connected(void) {
     return s_is_connected;
 }
 
+void network_get_stats(network_stats_t *stats) {
+    *stats = s_stats;
+}
+
+// Response body and timing collected by http_event_handler
+typedef struct {
+    char *buffer;                 // May be NULL: body not kept
+    size_t size;
+    size_t len;
+    int64_t sent_us;              // Request headers written
+    int64_t date_rx_us;           // Date header received
+    int64_t date_us;              // Date header value (Unix µs), 0 if absent
+} http_response_t;
+
+// Days since 1970-01-01 for a proleptic Gregorian date (no timegm in newlib)
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+// RFC 7231 IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+static bool parse_http_date(const char *value, int64_t *unix_us) {
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4];
+    int day, year, hour, min, sec;
+
+    if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d GMT", &day, month, &year, &hour, &min, &sec) != 6) {
+        return false;
+    }
+    const char *found = strstr(months, month);
+    if (!found || strlen(month) != 3 || (found - months) % 3 != 0) return false;
+
+    int64_t days = days_from_civil(year, (int)(found - months) / 3 + 1, day);
+    *unix_us = ((days * 24 + hour) * 60 + min) * 60 * 1000000LL + sec * 1000000LL;
+    return true;
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+    http_response_t *response = (http_response_t *)evt->user_data;
+
     switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP_EVENT_ERROR");
+            DLOGE(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+            DLOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
             break;
         case HTTP_EVENT_HEADERS_SENT:
-            ESP_LOGI(TAG, "HTTP_EVENT_HEADERS_SENT");
+            DLOGI(TAG, "HTTP_EVENT_HEADERS_SENT");
+            if (response) response->sent_us = esp_timer_get_time();
             break;
         case HTTP_EVENT_ON_HEADER:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            DLOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (response && strcasecmp(evt->header_key, "Date") == 0 &&
+                parse_http_date(evt->header_value, &response->date_us)) {
+                response->date_rx_us = esp_timer_get_time();
+            }
             break;
         case HTTP_EVENT_ON_DATA:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+            DLOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+            if (response && response->buffer && response->size > 0) {
+                // Keep what fits, always NUL-terminated
+                size_t room = response->size - 1 - response->len;
+                size_t n = (size_t)evt->data_len < room ? (size_t)evt->data_len : room;
+                memcpy(response->buffer + response->len, evt->data, n);
+                response->len += n;
+                response->buffer[response->len] = '\0';
+            }
             break;
         case HTTP_EVENT_ON_FINISH:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
+            DLOGI(TAG, "HTTP_EVENT_ON_FINISH");
             break;
         case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
+            DLOGI(TAG, "HTTP_EVENT_DISCONNECTED");
             break;
         default:
             break;
@@ -148,17 +317,26 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
 }
 
 esp_err_t network_http_post(const char *url, const char *json_data) {
+    return network_http_post_read(url, json_data, NULL, 0);
+}
+
+esp_err_t network_http_post_read(const char *url, const char *json_data,
+                                 char *response, size_t response_size) {
     if (!s_is_connected) {
         ESP_LOGE(TAG, "Not connected to Wi-Fi");
         return ESP_ERR_INVALID_STATE;
     }
     
-    ESP_LOGI(TAG, "Sending HTTP POST to %s", url);
-    ESP_LOGI(TAG, "Payload: %s", json_data);
+    DLOGI(TAG, "Sending HTTP POST to %s", url);
+    DLOGD(TAG, "Payload: %s", json_data);
     
+    http_response_t body = {.buffer = response, .size = response ? response_size : 0};
+    if (body.size > 0) response[0] = '\0';
+
     esp_http_client_config_t config = {
         .url = url,
         .event_handler = http_event_handler,
+        .user_data = &body,
         .timeout_ms = 5000,
     };
     
@@ -172,7 +350,12 @@ esp_err_t network_http_post(const char *url, const char *json_data) {
     
     if (err == ESP_OK) {
         int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP POST Status = %d", status_code);
+        DLOGI(TAG, "HTTP POST Status = %d", status_code);
+
+        // Free time source: the server's Date header, timed by this round-trip
+        if (body.date_us && body.sent_us) {
+            time_feed_server_time(body.date_us, body.sent_us, body.date_rx_us, 1000000);
+        }
         
         if (status_code >= 200 && status_code < 300) {
             esp_http_client_cleanup(client);
@@ -216,4 +399,16 @@ esp_err_t network_hardware_check(void) {
         return ESP_OK;
     }
     return ret;
+}
+
+esp_err_t network_get_device_id(char *buffer, size_t buffer_size) {
+    if (!buffer || buffer_size < 13) return ESP_ERR_INVALID_ARG;
+
+    uint8_t mac[6];
+    esp_err_t ret = esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    if (ret != ESP_OK) return ret;
+
+    snprintf(buffer, buffer_size, "%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return ESP_OK;
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "network_manager.h"
+#include "network_manager_fake.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const char *TAG = "NET_FAKE";
+
+static network_event_callback_t s_callback = NULL;
+static void *s_callback_user_data = NULL;
+static volatile bool s_is_connected = false;
+static network_stats_t s_stats;
+static uint32_t s_post_latency_ms = 80;
+static uint8_t s_post_fail_pct = 0;
+static uint32_t s_posts = 0;
+
+void network_fake_set_link(bool connected) {
+    if (connected == s_is_connected) return;
+    s_is_connected = connected;
+    if (connected) {
+        s_stats.connects++;
+        if (!s_stats.boot_to_online_ms) {
+            s_stats.boot_to_online_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        }
+    } else {
+        s_stats.disconnects++;
+    }
+    ESP_LOGI(TAG, "Link %s", connected ? "up" : "down");
+    if (s_callback) s_callback(connected, s_callback_user_data);
+}
+
+void network_fake_set_post(uint32_t latency_ms, uint8_t fail_pct) {
+    s_post_latency_ms = latency_ms;
+    s_post_fail_pct = fail_pct > 100 ? 100 : fail_pct;
+}
+
+uint32_t network_fake_post_count(void) {
+    return s_posts;
+}
+
+// The server's answer: everything in the batch is stored, and like the
+// real server it acks only the contiguous run from base_seq
+static void build_ack(const char *json_data, char *response, size_t response_size) {
+    cJSON *root = cJSON_Parse(json_data);
+    cJSON *base = cJSON_GetObjectItem(root, "base_seq");
+    uint32_t ack_seq = cJSON_IsNumber(base) ? (uint32_t)base->valuedouble - 1 : 0;
+    cJSON *record = NULL;
+    cJSON_ArrayForEach(record, cJSON_GetObjectItem(root, "records")) {
+        cJSON *seq = cJSON_GetObjectItem(record, "seq");
+        if (cJSON_IsNumber(seq) && (uint32_t)seq->valuedouble == ack_seq + 1) {
+            ack_seq++;
+        }
+    }
+    cJSON_Delete(root);
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    snprintf(response, response_size, "{\"ack_seq\":%lu,\"server_time_ms\":%lld}",
+             (unsigned long)ack_seq, (long long)now.tv_sec * 1000 + now.tv_usec / 1000);
+}
+
+esp_err_t network_manager_init(const char *ssid, const char *password) {
+    ESP_LOGI(TAG, "Simulated link to %s", ssid);
+    network_fake_set_link(true);
+    return ESP_OK;
+}
+
+esp_err_t network_manager_set_static_ip(const char *ip, const char *netmask,
+                                        const char *gateway, const char *dns) {
+    if (!ip || !netmask || !gateway) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t network_manager_register_callback(network_event_callback_t callback, void *user_data) {
+    s_callback = callback;
+    s_callback_user_data = user_data;
+    return ESP_OK;
+}
+
+bool network_is_connected(void) {
+    return s_is_connected;
+}
+
+void network_get_stats(network_stats_t *stats) {
+    *stats = s_stats;
+}
+
+esp_err_t network_http_post(const char *url, const char *json_data) {
+    return network_http_post_read(url, json_data, NULL, 0);
+}
+
+esp_err_t network_http_post_read(const char *url, const char *json_data,
+                                 char *response, size_t response_size) {
+    if (!s_is_connected) return ESP_ERR_INVALID_STATE;
+
+    s_posts++;
+    if (s_post_latency_ms) vTaskDelay(pdMS_TO_TICKS(s_post_latency_ms));
+    if (s_post_fail_pct && (uint32_t)(rand() % 100) < s_post_fail_pct) {
+        return ESP_FAIL;
+    }
+    if (response && response_size) build_ack(json_data, response, response_size);
+    return ESP_OK;
+}
+
+bool network_is_server_reachable(const char *url) {
+    return s_is_connected;
+}
+
+esp_err_t network_hardware_check(void) {
+    return ESP_OK;
+}
+
+esp_err_t network_get_device_id(char *buffer, size_t buffer_size) {
+    if (!buffer || buffer_size < 13) return ESP_ERR_INVALID_ARG;
+    snprintf(buffer, buffer_size, "%s", "0000000000ff");
+    return ESP_OK;
+}
@@ -0,0 +1,75 @@
+#ifndef PUSH_CHANNEL_H
+#define PUSH_CHANNEL_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Commands the server can push down to the device
+typedef enum {
+    PUSH_CMD_DELETE_SLOT,
+    PUSH_CMD_REFRESH_USERS,
+    PUSH_CMD_SET_VOLUME
+} push_command_type_t;
+
+typedef struct {
+    uint32_t id;                // Server-assigned, echoed back in the result
+    push_command_type_t type;
+    int32_t arg;                // Slot number or volume, depending on type
+} push_command_t;
+
+// Called from the WebSocket client task; keep it short (post to a queue)
+typedef void (*push_command_callback_t)(const push_command_t *cmd, void *user_data);
+
+// Server confirmed every attendance record up to ack_seq (same task context).
+// server_time_ms is the server clock when it answered, 0 if not sent.
+typedef void (*push_ack_callback_t)(uint32_t ack_seq, int64_t server_time_ms, void *user_data);
+
+/**
+ * @brief Initialize the persistent device <-> server channel (WebSocket)
+ * @param uri Server endpoint, e.g. "ws://host:8063/ws"
+ * @param device_id Identifier appended to the URI so the server can route commands
+ */
+esp_err_t push_channel_init(const char *uri, const char *device_id);
+
+/**
+ * @brief Register callback for server commands
+ */
+esp_err_t push_channel_register_callback(push_command_callback_t callback, void *user_data);
+
+// Server clock in answer to a heartbeat that asked for it (same task context)
+typedef void (*push_time_callback_t)(int64_t server_time_ms, void *user_data);
+
+/**
+ * @brief Register callback for attendance acknowledgments
+ */
+esp_err_t push_channel_register_ack_callback(push_ack_callback_t callback, void *user_data);
+
+/**
+ * @brief Register callback for server time replies
+ */
+esp_err_t push_channel_register_time_callback(push_time_callback_t callback, void *user_data);
+
+/**
+ * @brief Start connecting (reconnects automatically in the background)
+ */
+esp_err_t push_channel_start(void);
+
+/**
+ * @brief Check if the channel is currently connected
+ */
+bool push_channel_is_connected(void);
+
+/**
+ * @brief Send a JSON text frame to the server
+ * @return ESP_ERR_INVALID_STATE if not connected, ESP_FAIL if the send failed
+ */
+esp_err_t push_channel_send(const char *json);
+
+/**
+ * @brief Report the outcome of a server command
+ * @param detail_json Optional extra JSON members (without braces), may be NULL
+ */
+esp_err_t push_channel_send_result(uint32_t cmd_id, bool success, const char *detail_json);
+
+#endif // PUSH_CHANNEL_H
\ No newline at end of file
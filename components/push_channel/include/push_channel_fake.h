@@ -0,0 +1,27 @@
+#ifndef PUSH_CHANNEL_FAKE_H
+#define PUSH_CHANNEL_FAKE_H
+
+#include "push_channel.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host build only: a loopback server on the other end of the channel.
+// Attendance frames are acknowledged and time requests answered after
+// the configured latency, from the channel's own task.
+
+/**
+ * @brief Connect or drop the channel (the firmware's server reachability)
+ */
+void push_channel_fake_set_connected(bool connected);
+
+/**
+ * @brief Delay of every server answer
+ */
+void push_channel_fake_set_latency(uint32_t latency_ms);
+
+/**
+ * @brief Push a command down to the device as the server would
+ */
+esp_err_t push_channel_fake_command(push_command_type_t type, int32_t arg);
+
+#endif // PUSH_CHANNEL_FAKE_H
@@ -0,0 +1,188 @@
+#include "push_channel.h"
+#include "esp_websocket_client.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "PUSH";
+
+#define PUSH_SEND_TIMEOUT_MS   1000
+#define PUSH_RECONNECT_MS      2000
+#define PUSH_PING_INTERVAL_SEC 10
+
+static esp_websocket_client_handle_t s_client = NULL;
+static char s_uri[160];
+static push_command_callback_t s_callback = NULL;
+static void *s_callback_user_data = NULL;
+static push_ack_callback_t s_ack_callback = NULL;
+static void *s_ack_user_data = NULL;
+static push_time_callback_t s_time_callback = NULL;
+static void *s_time_user_data = NULL;
+
+static bool parse_command(cJSON *root, push_command_t *cmd) {
+    bool ok = false;
+    cJSON *type = cJSON_GetObjectItem(root, "type");
+    cJSON *name = cJSON_GetObjectItem(root, "cmd");
+    cJSON *id = cJSON_GetObjectItem(root, "cmd_id");
+
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "command") == 0 &&
+        cJSON_IsString(name) && cJSON_IsNumber(id)) {
+        cmd->id = (uint32_t)id->valuedouble;
+        cmd->arg = 0;
+        ok = true;
+
+        if (strcmp(name->valuestring, "delete_slot") == 0) {
+            cJSON *slot = cJSON_GetObjectItem(root, "slot");
+            cmd->type = PUSH_CMD_DELETE_SLOT;
+            ok = cJSON_IsNumber(slot);
+            if (ok) cmd->arg = slot->valueint;
+        } else if (strcmp(name->valuestring, "refresh_users") == 0) {
+            cmd->type = PUSH_CMD_REFRESH_USERS;
+        } else if (strcmp(name->valuestring, "set_volume") == 0) {
+            cJSON *volume = cJSON_GetObjectItem(root, "volume");
+            cmd->type = PUSH_CMD_SET_VOLUME;
+            ok = cJSON_IsNumber(volume);
+            if (ok) cmd->arg = volume->valueint;
+        } else {
+            ESP_LOGW(TAG, "Unknown command: %s", name->valuestring);
+            push_channel_send_result(cmd->id, false, "\"error\":\"unknown command\"");
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+static void handle_frame(const char *data, int len) {
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) return;
+
+    cJSON *type = cJSON_GetObjectItem(root, "type");
+    push_command_t cmd;
+
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "attendance_ack") == 0) {
+        cJSON *ack = cJSON_GetObjectItem(root, "ack_seq");
+        cJSON *server_time = cJSON_GetObjectItem(root, "server_time_ms");
+        if (cJSON_IsNumber(ack) && s_ack_callback) {
+            s_ack_callback((uint32_t)ack->valuedouble,
+                           cJSON_IsNumber(server_time) ? (int64_t)server_time->valuedouble : 0,
+                           s_ack_user_data);
+        }
+    } else if (cJSON_IsString(type) && strcmp(type->valuestring, "time") == 0) {
+        cJSON *server_time = cJSON_GetObjectItem(root, "server_time_ms");
+        if (cJSON_IsNumber(server_time) && s_time_callback) {
+            s_time_callback((int64_t)server_time->valuedouble, s_time_user_data);
+        }
+    } else if (parse_command(root, &cmd) && s_callback) {
+        s_callback(&cmd, s_callback_user_data);
+    }
+
+    cJSON_Delete(root);
+}
+
+static void websocket_event_handler(void *arg, esp_event_base_t event_base,
+                                    int32_t event_id, void *event_data) {
+    esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
+
+    switch (event_id) {
+        case WEBSOCKET_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Channel connected");
+            break;
+        case WEBSOCKET_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "Channel disconnected");
+            break;
+        case WEBSOCKET_EVENT_DATA:
+            // Text frames only; commands and acks are small enough to arrive unfragmented
+            if (data->op_code != 0x01 || data->data_len <= 0) break;
+            if (data->payload_offset != 0 || data->data_len != data->payload_len) {
+                ESP_LOGW(TAG, "Ignoring fragmented frame (%d bytes)", data->payload_len);
+                break;
+            }
+            handle_frame(data->data_ptr, data->data_len);
+            break;
+        case WEBSOCKET_EVENT_ERROR:
+            ESP_LOGE(TAG, "Channel error");
+            break;
+        default:
+            break;
+    }
+}
+
+esp_err_t push_channel_init(const char *uri, const char *device_id) {
+    if (!uri || !device_id) return ESP_ERR_INVALID_ARG;
+
+    snprintf(s_uri, sizeof(s_uri), "%s?device_id=%s", uri, device_id);
+
+    esp_websocket_client_config_t config = {
+        .uri = s_uri,
+        .reconnect_timeout_ms = PUSH_RECONNECT_MS,
+        .network_timeout_ms = PUSH_SEND_TIMEOUT_MS * 5,
+        .ping_interval_sec = PUSH_PING_INTERVAL_SEC,
+    };
+
+    s_client = esp_websocket_client_init(&config);
+    if (!s_client) return ESP_ERR_NO_MEM;
+
+    esp_err_t ret = esp_websocket_register_events(s_client, WEBSOCKET_EVENT_ANY,
+                                                  websocket_event_handler, NULL);
+    if (ret != ESP_OK) {
+        // Leave nothing behind, so the caller can simply try again
+        esp_websocket_client_destroy(s_client);
+        s_client = NULL;
+    }
+    return ret;
+}
+
+esp_err_t push_channel_register_callback(push_command_callback_t callback, void *user_data) {
+    s_callback = callback;
+    s_callback_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_register_ack_callback(push_ack_callback_t callback, void *user_data) {
+    s_ack_callback = callback;
+    s_ack_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_register_time_callback(push_time_callback_t callback, void *user_data) {
+    s_time_callback = callback;
+    s_time_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_start(void) {
+    if (!s_client) return ESP_ERR_INVALID_STATE;
+    ESP_LOGI(TAG, "Connecting to %s", s_uri);
+    return esp_websocket_client_start(s_client);
+}
+
+bool push_channel_is_connected(void) {
+    return s_client && esp_websocket_client_is_connected(s_client);
+}
+
+esp_err_t push_channel_send(const char *json) {
+    if (!push_channel_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    int len = strlen(json);
+    int sent = esp_websocket_client_send_text(s_client, json, len,
+                                              pdMS_TO_TICKS(PUSH_SEND_TIMEOUT_MS));
+    return (sent == len) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t push_channel_send_result(uint32_t cmd_id, bool success, const char *detail_json) {
+    size_t size = 64 + (detail_json ? strlen(detail_json) : 0);
+    char *frame = malloc(size);
+    if (!frame) return ESP_ERR_NO_MEM;
+
+    snprintf(frame, size, "{\"type\":\"result\",\"cmd_id\":%lu,\"status\":\"%s\"%s%s}",
+             (unsigned long)cmd_id, success ? "ok" : "error",
+             detail_json ? "," : "", detail_json ? detail_json : "");
+
+    esp_err_t ret = push_channel_send(frame);
+    free(frame);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "push_channel.h"
+#include "push_channel_fake.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <sys/time.h>
+
+static const char *TAG = "PUSH_FAKE";
+
+#define PUSH_FAKE_QUEUE_LEN 16
+#define PUSH_FAKE_TASK_STACK 4096
+
+typedef enum {
+    REPLY_ACK,
+    REPLY_TIME,
+    REPLY_COMMAND
+} reply_kind_t;
+
+typedef struct {
+    reply_kind_t kind;
+    int64_t due_us;
+    uint32_t ack_seq;
+    push_command_t cmd;
+} reply_t;
+
+static push_command_callback_t s_callback = NULL;
+static void *s_callback_user_data = NULL;
+static push_ack_callback_t s_ack_callback = NULL;
+static void *s_ack_user_data = NULL;
+static push_time_callback_t s_time_callback = NULL;
+static void *s_time_user_data = NULL;
+
+static QueueHandle_t s_replies = NULL;
+static volatile bool s_connected = true;
+static volatile bool s_started = false;
+static uint32_t s_latency_ms = 40;
+static uint32_t s_next_cmd_id = 1;
+
+static int64_t server_time_ms(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// Stands in for the WebSocket client task: answers arrive in order
+static void server_task(void *arg) {
+    reply_t reply;
+    while (1) {
+        if (xQueueReceive(s_replies, &reply, portMAX_DELAY) != pdTRUE) continue;
+        int64_t wait_us = reply.due_us - esp_timer_get_time();
+        if (wait_us > 0) vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+        if (!s_connected) continue;   // Lost with the connection
+
+        switch (reply.kind) {
+            case REPLY_ACK:
+                if (s_ack_callback) s_ack_callback(reply.ack_seq, server_time_ms(), s_ack_user_data);
+                break;
+            case REPLY_TIME:
+                if (s_time_callback) s_time_callback(server_time_ms(), s_time_user_data);
+                break;
+            case REPLY_COMMAND:
+                if (s_callback) s_callback(&reply.cmd, s_callback_user_data);
+                break;
+        }
+    }
+}
+
+static esp_err_t queue_reply(reply_t *reply) {
+    if (!s_replies) return ESP_ERR_INVALID_STATE;
+    reply->due_us = esp_timer_get_time() + (int64_t)s_latency_ms * 1000;
+    return xQueueSend(s_replies, reply, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+void push_channel_fake_set_connected(bool connected) {
+    s_connected = connected;
+    ESP_LOGI(TAG, "Channel %s", connected ? "connected" : "dropped");
+}
+
+void push_channel_fake_set_latency(uint32_t latency_ms) {
+    s_latency_ms = latency_ms;
+}
+
+esp_err_t push_channel_fake_command(push_command_type_t type, int32_t arg) {
+    reply_t reply = {.kind = REPLY_COMMAND,
+                     .cmd = {.id = s_next_cmd_id++, .type = type, .arg = arg}};
+    return queue_reply(&reply);
+}
+
+esp_err_t push_channel_init(const char *uri, const char *device_id) {
+    if (!uri || !device_id) return ESP_ERR_INVALID_ARG;
+    s_replies = xQueueCreate(PUSH_FAKE_QUEUE_LEN, sizeof(reply_t));
+    if (!s_replies) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_register_callback(push_command_callback_t callback, void *user_data) {
+    s_callback = callback;
+    s_callback_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_register_ack_callback(push_ack_callback_t callback, void *user_data) {
+    s_ack_callback = callback;
+    s_ack_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_register_time_callback(push_time_callback_t callback, void *user_data) {
+    s_time_callback = callback;
+    s_time_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t push_channel_start(void) {
+    if (!s_replies) return ESP_ERR_INVALID_STATE;
+    if (xTaskCreate(server_task, "push_fake", PUSH_FAKE_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_started = true;
+    return ESP_OK;
+}
+
+bool push_channel_is_connected(void) {
+    return s_started && s_connected;
+}
+
+esp_err_t push_channel_send(const char *json) {
+    if (!push_channel_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    cJSON *root = cJSON_Parse(json);
+    if (!root) return ESP_FAIL;
+    cJSON *type = cJSON_GetObjectItem(root, "type");
+    esp_err_t ret = ESP_OK;
+
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "attendance") == 0) {
+        // Like the server: only the contiguous run from base_seq is acked
+        cJSON *base = cJSON_GetObjectItem(root, "base_seq");
+        reply_t reply = {.kind = REPLY_ACK,
+                         .ack_seq = cJSON_IsNumber(base) ? (uint32_t)base->valuedouble - 1 : 0};
+        cJSON *record = NULL;
+        cJSON_ArrayForEach(record, cJSON_GetObjectItem(root, "records")) {
+            cJSON *seq = cJSON_GetObjectItem(record, "seq");
+            if (cJSON_IsNumber(seq) && (uint32_t)seq->valuedouble == reply.ack_seq + 1) {
+                reply.ack_seq++;
+            }
+        }
+        ret = queue_reply(&reply);
+    } else if (cJSON_IsString(type) && strcmp(type->valuestring, "heartbeat") == 0 &&
+               cJSON_IsTrue(cJSON_GetObjectItem(root, "need_time"))) {
+        reply_t reply = {.kind = REPLY_TIME};
+        ret = queue_reply(&reply);
+    }
+    cJSON_Delete(root);
+    return ret;
+}
+
+esp_err_t push_channel_send_result(uint32_t cmd_id, bool success, const char *detail_json) {
+    ESP_LOGI(TAG, "Command %lu: %s%s%s", (unsigned long)cmd_id, success ? "ok" : "error",
+             detail_json ? " " : "", detail_json ? detail_json : "");
+    return push_channel_is_connected() ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
@@ -0,0 +1,82 @@
+#ifndef RETRY_SCHEDULER_H
+#define RETRY_SCHEDULER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Circuit breaker state
+typedef enum {
+    RETRY_BREAKER_CLOSED,     // Normal operation, failures back off exponentially
+    RETRY_BREAKER_OPEN,       // Too many failures, attempts refused until the probe time
+    RETRY_BREAKER_HALF_OPEN   // One probe attempt allowed, its outcome decides
+} retry_breaker_state_t;
+
+// Called from the esp_timer task when the next attempt is allowed.
+// Keep it short: post a message to the owning task's queue.
+typedef void (*retry_due_callback_t)(void *user_data);
+
+typedef struct {
+    const char *name;
+    uint32_t base_delay_ms;       // Backoff ceiling for the first retry
+    uint32_t max_delay_ms;        // Backoff ceiling cap
+    uint32_t failure_threshold;   // Consecutive failures that open the breaker (0 = never)
+    uint32_t open_duration_ms;    // Time the breaker stays open before a half-open probe
+    retry_due_callback_t on_due;
+    void *user_data;
+} retry_scheduler_config_t;
+
+// Failure / recovery metrics
+typedef struct {
+    retry_breaker_state_t state;
+    uint32_t attempts;
+    uint32_t successes;
+    uint32_t failures;
+    uint32_t consecutive_failures;
+    uint32_t breaker_opens;
+    uint32_t current_delay_ms;    // Delay chosen after the last failure
+    uint32_t last_outage_ms;      // First failure -> next success, last outage
+    uint32_t max_outage_ms;
+    uint32_t total_outage_ms;
+} retry_scheduler_stats_t;
+
+typedef struct retry_scheduler* retry_scheduler_handle_t;
+
+/**
+ * @brief Create a retry scheduler (exponential backoff, full jitter, circuit breaker)
+ * @note Not thread-safe: call attempt/record functions from a single task
+ */
+esp_err_t retry_scheduler_create(const retry_scheduler_config_t *config, retry_scheduler_handle_t *handle);
+
+/**
+ * @brief Check whether an attempt may run now
+ * Moves an open breaker to half-open once its open time has elapsed (single probe).
+ */
+bool retry_scheduler_can_attempt(retry_scheduler_handle_t handle);
+
+/**
+ * @brief Record a successful attempt (closes the breaker, resets backoff)
+ */
+void retry_scheduler_record_success(retry_scheduler_handle_t handle);
+
+/**
+ * @brief Record a failed attempt and arm the timer for the next one
+ */
+void retry_scheduler_record_failure(retry_scheduler_handle_t handle);
+
+/**
+ * @brief Snapshot of the failure / recovery metrics
+ */
+void retry_scheduler_get_stats(retry_scheduler_handle_t handle, retry_scheduler_stats_t *stats);
+
+/**
+ * @brief Human-readable breaker state
+ */
+const char *retry_breaker_state_name(retry_breaker_state_t state);
+
+/**
+ * @brief Full-jitter backoff: uniform in [0, min(max, base * 2^attempt)]
+ */
+uint32_t retry_backoff_delay_ms(uint32_t base_ms, uint32_t max_ms, uint32_t attempt);
+
+#endif // RETRY_SCHEDULER_H
\ No newline at end of file
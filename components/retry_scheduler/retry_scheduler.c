@@ -0,0 +1,152 @@
+#include "retry_scheduler.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "RETRY";
+
+#define RETRY_MIN_DELAY_MS 10
+
+struct retry_scheduler {
+    retry_scheduler_config_t config;
+    esp_timer_handle_t timer;
+    retry_scheduler_stats_t stats;
+    int64_t next_attempt_us;      // Attempts refused before this time
+    int64_t outage_start_us;      // First failure of the current outage (0 = healthy)
+    bool probe_in_flight;
+};
+
+static void retry_timer_callback(void *arg) {
+    retry_scheduler_handle_t h = (retry_scheduler_handle_t)arg;
+    if (h->config.on_due) {
+        h->config.on_due(h->config.user_data);
+    }
+}
+
+static void arm_timer(retry_scheduler_handle_t h, uint32_t delay_ms) {
+    if (delay_ms < RETRY_MIN_DELAY_MS) delay_ms = RETRY_MIN_DELAY_MS;
+    h->next_attempt_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    esp_timer_stop(h->timer);
+    esp_timer_start_once(h->timer, (uint64_t)delay_ms * 1000);
+}
+
+uint32_t retry_backoff_delay_ms(uint32_t base_ms, uint32_t max_ms, uint32_t attempt) {
+    // Cap the shift so base << attempt cannot overflow
+    uint64_t ceiling = (uint64_t)base_ms << (attempt > 20 ? 20 : attempt);
+    if (ceiling > max_ms) ceiling = max_ms;
+    return (uint32_t)(esp_random() % (ceiling + 1));
+}
+
+const char *retry_breaker_state_name(retry_breaker_state_t state) {
+    switch (state) {
+        case RETRY_BREAKER_CLOSED:    return "closed";
+        case RETRY_BREAKER_OPEN:      return "open";
+        case RETRY_BREAKER_HALF_OPEN: return "half_open";
+        default:                      return "unknown";
+    }
+}
+
+esp_err_t retry_scheduler_create(const retry_scheduler_config_t *config, retry_scheduler_handle_t *handle) {
+    if (!config || !handle || config->base_delay_ms == 0) return ESP_ERR_INVALID_ARG;
+
+    retry_scheduler_handle_t h = calloc(1, sizeof(struct retry_scheduler));
+    if (!h) return ESP_ERR_NO_MEM;
+
+    h->config = *config;
+    h->stats.state = RETRY_BREAKER_CLOSED;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_callback,
+        .arg = h,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = config->name ? config->name : "retry"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &h->timer);
+    if (ret != ESP_OK) {
+        free(h);
+        return ret;
+    }
+
+    *handle = h;
+    return ESP_OK;
+}
+
+bool retry_scheduler_can_attempt(retry_scheduler_handle_t h) {
+    int64_t now = esp_timer_get_time();
+    if (now < h->next_attempt_us) return false;
+
+    switch (h->stats.state) {
+        case RETRY_BREAKER_CLOSED:
+            return true;
+        case RETRY_BREAKER_OPEN:
+            ESP_LOGI(TAG, "%s: breaker half-open, probing", h->config.name);
+            h->stats.state = RETRY_BREAKER_HALF_OPEN;
+            h->probe_in_flight = true;
+            return true;
+        case RETRY_BREAKER_HALF_OPEN:
+            // Only the single probe may run until it reports back
+            if (h->probe_in_flight) return false;
+            h->probe_in_flight = true;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void retry_scheduler_record_success(retry_scheduler_handle_t h) {
+    h->stats.attempts++;
+    h->stats.successes++;
+
+    if (h->outage_start_us) {
+        uint32_t outage_ms = (uint32_t)((esp_timer_get_time() - h->outage_start_us) / 1000);
+        h->stats.last_outage_ms = outage_ms;
+        h->stats.total_outage_ms += outage_ms;
+        if (outage_ms > h->stats.max_outage_ms) h->stats.max_outage_ms = outage_ms;
+        h->outage_start_us = 0;
+        ESP_LOGI(TAG, "%s: recovered after %lu ms (%lu failures)", h->config.name,
+                 (unsigned long)outage_ms, (unsigned long)h->stats.consecutive_failures);
+    }
+
+    h->stats.state = RETRY_BREAKER_CLOSED;
+    h->stats.consecutive_failures = 0;
+    h->stats.current_delay_ms = 0;
+    h->probe_in_flight = false;
+    h->next_attempt_us = 0;
+    esp_timer_stop(h->timer);
+}
+
+void retry_scheduler_record_failure(retry_scheduler_handle_t h) {
+    h->stats.attempts++;
+    h->stats.failures++;
+    h->stats.consecutive_failures++;
+    h->probe_in_flight = false;
+    if (!h->outage_start_us) h->outage_start_us = esp_timer_get_time();
+
+    bool trip = h->stats.state == RETRY_BREAKER_HALF_OPEN ||
+                (h->config.failure_threshold > 0 &&
+                 h->stats.consecutive_failures >= h->config.failure_threshold);
+
+    if (trip) {
+        if (h->stats.state != RETRY_BREAKER_OPEN) h->stats.breaker_opens++;
+        h->stats.state = RETRY_BREAKER_OPEN;
+        // Jitter the probe too, so a fleet does not probe in lockstep
+        uint32_t jitter = h->config.open_duration_ms / 4;
+        h->stats.current_delay_ms = h->config.open_duration_ms - jitter +
+                                    (jitter ? esp_random() % (2 * jitter + 1) : 0);
+        ESP_LOGW(TAG, "%s: breaker open for %lu ms after %lu failures", h->config.name,
+                 (unsigned long)h->stats.current_delay_ms,
+                 (unsigned long)h->stats.consecutive_failures);
+    } else {
+        h->stats.current_delay_ms = retry_backoff_delay_ms(h->config.base_delay_ms,
+                                                           h->config.max_delay_ms,
+                                                           h->stats.consecutive_failures - 1);
+    }
+
+    arm_timer(h, h->stats.current_delay_ms);
+}
+
+void retry_scheduler_get_stats(retry_scheduler_handle_t h, retry_scheduler_stats_t *stats) {
+    *stats = h->stats;
+}
\ No newline at end of file
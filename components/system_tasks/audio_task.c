@@ -3,53 +3,248 @@
 #include "system_state.h"
 #include "app_config.h"
 #include "esp_log.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
 
 static const char *TAG = "AUDIO_TASK";
 
 extern mp3_handle_t g_mp3_handle;
 
+// The DFPlayer takes one command at a time over a 9600-baud link. Requests
+// are therefore not played as they arrive: a single pending slot holds the
+// next playlist (latest wins, higher priority first) and is started once
+// the previous command has been acknowledged. Within a playlist the next
+// track goes out when the player reports the current one finished, so the
+// task never sleeps on a guessed track length.
+typedef struct {
+    uint8_t tracks[AUDIO_PLAYLIST_MAX];
+    uint8_t count;              // 0 = none
+    uint8_t next;               // Index of the next track to send
+    bool track_done;            // Current track finished, next one due
+    audio_priority_t priority;
+} audio_playlist_t;
+
+static audio_playlist_t s_pending;
+static audio_playlist_t s_playing;  // Started, until its last track finishes
+static bool s_awaiting_ack = false;
+static TickType_t s_sent_at = 0;
+static audio_stats_t s_stats;
+
+// Driver reader task: forward to our subscription
+static void mp3_event_handler(const mp3_event_t *event, void *user_data) {
+    system_message_t msg = {.type = MSG_MP3_EVENT,
+                            .data.mp3 = {.event = (uint8_t)event->type, .param = event->param}};
+    publish_message(TOPIC_AUDIO, &msg);
+}
+
+esp_err_t audio_play_sequence(const uint8_t *tracks, size_t count, audio_priority_t priority) {
+    if (count == 0 || count > AUDIO_PLAYLIST_MAX) return ESP_ERR_INVALID_SIZE;
+    system_message_t msg = {.type = MSG_PLAY_AUDIO,
+                            .data.audio = {.count = (uint8_t)count, .priority = priority}};
+    memcpy(msg.data.audio.tracks, tracks, count);
+    return publish_message(TOPIC_AUDIO, &msg) == ESP_OK ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t audio_play(uint8_t track, audio_priority_t priority) {
+    return audio_play_sequence(&track, 1, priority);
+}
+
+static void request(const uint8_t *tracks, uint8_t count, audio_priority_t priority) {
+    // Feedback follows the UI: nothing queues up behind something more important
+    if (s_playing.count && priority < s_playing.priority) {
+        s_stats.dropped++;
+        return;
+    }
+    if (s_pending.count) {
+        if (priority < s_pending.priority) {
+            s_stats.dropped++;
+            return;
+        }
+        s_stats.coalesced++;
+    }
+    s_pending = (audio_playlist_t){.count = count, .priority = priority};
+    memcpy(s_pending.tracks, tracks, count);
+}
+
+static uint8_t current_track(void) {
+    return s_playing.next ? s_playing.tracks[s_playing.next - 1] : 0;
+}
+
+static void play_next(void) {
+    uint8_t track = s_playing.tracks[s_playing.next++];
+    TRACE_INSTANT(TRACE_AUDIO_PLAY, track);
+    mp3_play_track(g_mp3_handle, track);
+    s_playing.track_done = false;
+    s_awaiting_ack = true;
+    s_sent_at = xTaskGetTickCount();
+    s_stats.played++;
+}
+
+static void send_pending(void) {
+    if (s_awaiting_ack) return;
+
+    if (s_pending.count) {
+        // Playing a track stops the current one
+        if (s_playing.count) s_stats.preempted++;
+        s_playing = s_pending;
+        s_pending = (audio_playlist_t){0};
+        play_next();
+    } else if (s_playing.count && s_playing.track_done) {
+        if (s_playing.next < s_playing.count) {
+            play_next();
+        } else {
+            s_playing = (audio_playlist_t){0};
+        }
+    }
+}
+
+static void handle_mp3_event(mp3_event_type_t event, uint16_t param) {
+    switch (event) {
+        case MP3_EVENT_ACK:
+            s_awaiting_ack = false;
+            break;
+        case MP3_EVENT_ERROR:
+            // Busy, missing file, ...: give up on the rest of the playlist
+            ESP_LOGW(TAG, "Player error 0x%02x on track %d", param, current_track());
+            s_stats.errors++;
+            s_awaiting_ack = false;
+            s_playing = (audio_playlist_t){0};
+            break;
+        case MP3_EVENT_TRACK_FINISHED:
+            if (s_playing.count && param == current_track()) s_playing.track_done = true;
+            break;
+    }
+}
+
+// Ack and playback deadlines; returns how long the queue wait may block
+static TickType_t check_timeouts(void) {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = portMAX_DELAY;
+
+    if (s_awaiting_ack) {
+        TickType_t deadline = s_sent_at + pdMS_TO_TICKS(AUDIO_ACK_TIMEOUT_MS);
+        if ((int32_t)(deadline - now) <= 0) {
+            // Module without feedback or a lost frame: do not stall
+            s_stats.ack_timeouts++;
+            s_awaiting_ack = false;
+        } else {
+            wait = deadline - now;
+        }
+    }
+    if (s_playing.count && !s_playing.track_done) {
+        TickType_t deadline = s_sent_at + pdMS_TO_TICKS(AUDIO_MAX_TRACK_MS);
+        if ((int32_t)(deadline - now) <= 0) {
+            // Finished frame lost: move on rather than stop the playlist
+            s_playing.track_done = true;
+        } else if (deadline - now < wait) {
+            wait = deadline - now;
+        }
+    }
+    return wait;
+}
+
+// Success prompt, then the ID digit by digit
+static uint8_t build_success_playlist(uint16_t id, uint8_t *tracks) {
+    uint8_t count = 0;
+    tracks[count++] = AUDIO_SUCCESS;
+#if AUDIO_SPEAK_ID
+    char digits[6];
+    int len = snprintf(digits, sizeof(digits), "%u", id);
+    for (int i = 0; i < len && count < AUDIO_PLAYLIST_MAX; i++) {
+        tracks[count++] = AUDIO_DIGIT_BASE + (digits[i] - '0');
+    }
+#endif
+    return count;
+}
+
+void audio_get_stats(audio_stats_t *stats) {
+    *stats = s_stats;
+}
+
+// Scrape-time snapshot; plain reads of counters only this task writes
+static void write_audio_metrics(metrics_writer_t *w, void *user_data) {
+    audio_stats_t stats;
+    audio_get_stats(&stats);
+    const struct {
+        const char *outcome;
+        uint32_t value;
+    } rows[] = {
+        {"played", stats.played},       {"coalesced", stats.coalesced},
+        {"dropped", stats.dropped},     {"preempted", stats.preempted},
+        {"error", stats.errors},        {"ack_timeout", stats.ack_timeouts},
+    };
+
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "audio_requests_total counter\n");
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+        metrics_printf(w, METRICS_PREFIX "audio_requests_total{outcome=\"%s\"} %lu\n",
+                       rows[i].outcome, (unsigned long)rows[i].value);
+    }
+}
+
 void audio_task(void *pvParameters) {
     ESP_LOGI(TAG, "Audio task started");
-    
-    system_message_t msg;
-    
+    mp3_register_callback(g_mp3_handle, mp3_event_handler, NULL);
+    metrics_register_collector(write_audio_metrics, NULL);
+
+    TickType_t wait = portMAX_DELAY;
+
     while (1) {
-        if (xQueueReceive(g_audio_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            uint8_t track = 0;
-            
-            switch (msg.type) {
+        const event_t *event = event_bus_receive(g_audio_events, wait);
+        if (event) {
+            const system_message_t *msg = event_message(event);
+            uint8_t tracks[AUDIO_PLAYLIST_MAX];
+            uint8_t count = 0;
+            audio_priority_t priority = AUDIO_PRIO_RESULT;
+
+            switch (msg->type) {
                 case MSG_FINGERPRINT_MATCHED:
-                    track = AUDIO_SUCCESS;
-                    ESP_LOGI(TAG, "Playing success audio");
+                    count = build_success_playlist(msg->data.fingerprint.fingerprint_id, tracks);
                     break;
-                    
+
                 case MSG_FINGERPRINT_NOT_MATCHED:
                 case MSG_FINGERPRINT_TIMEOUT:
                 case MSG_FINGERPRINT_ERROR:
-                    track = AUDIO_FAILURE;
-                    ESP_LOGI(TAG, "Playing failure audio");
+                    tracks[count++] = AUDIO_FAILURE;
                     break;
-                    
+
                 case MSG_PLAY_AUDIO:
-                    track = msg.data.audio.track_number;
-                    ESP_LOGI(TAG, "Playing audio track %d", track);
+                    count = msg->data.audio.count;
+                    memcpy(tracks, msg->data.audio.tracks, count);
+                    priority = msg->data.audio.priority;
+                    break;
+
+                case MSG_MP3_EVENT:
+                    handle_mp3_event((mp3_event_type_t)msg->data.mp3.event, msg->data.mp3.param);
+                    break;
+
+                case MSG_SET_VOLUME:
+                    ESP_LOGI(TAG, "Setting volume to %ld", (long)msg->data.command.arg);
+                    mp3_set_volume(g_mp3_handle, (uint8_t)msg->data.command.arg);
                     break;
-                    
+
                 default:
-                    continue;
-            }
-            
-            // Check if out of service
-            EventBits_t bits = xEventGroupGetBits(g_system_events);
-            if (bits & EVENT_OUT_OF_SERVICE) {
-                // Only play out-of-service audio
-                track = AUDIO_OUT_OF_SERVICE;
-                ESP_LOGI(TAG, "System out of service, playing track 4");
+                    break;
             }
-            
-            if (track > 0) {
-                mp3_play_track(g_mp3_handle, track);
+
+            if (count > 0) {
+                // Check if out of service
+                EventBits_t bits = xEventGroupGetBits(g_system_events);
+                if (bits & EVENT_OUT_OF_SERVICE) {
+                    // Only play out-of-service audio
+                    tracks[0] = AUDIO_OUT_OF_SERVICE;
+                    count = 1;
+                    priority = AUDIO_PRIO_ALERT;
+                }
+                request(tracks, count, priority);
             }
+            event_bus_release(event);
         }
+
+        wait = check_timeouts();
+        send_pending();
+        // A command just went out: wake up for its ack deadline at the latest
+        if (s_awaiting_ack) wait = check_timeouts();
     }
-}
\ No newline at end of file
+}
@@ -1,111 +1,478 @@
 #include "fingerprint_task.h"
+#include "anti_passback.h"
+#include "audio_task.h"
+#include "display_driver.h"
 #include "fingerprint_driver.h"
+#include "fp_image.h"
+#include "push_channel.h"
+#include "time_manager.h"
 #include "system_state.h"
+#include "metrics.h"
+#include "trace.h"
 #include "app_config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdio.h>
 
 static const char *TAG = "FP_TASK";
 extern fingerprint_handle_t g_fingerprint_handle;
+extern display_handle_t g_display_handle;
 
+// Capture failures by cause, for /metrics
+static uint32_t s_capture_replaced;     // Badly placed finger, re-prompted
+static uint32_t s_capture_comm_errors;  // No valid answer from the sensor
+static uint32_t s_quality_rejects[FP_QUALITY_ISSUE_COUNT];  // Refused before conversion
+static fp_quality_t s_last_quality;     // Of the last checked capture
+
+static bool is_bad_placement(uint8_t code) {
+    return code == FP_IMAGEMESS || code == FP_FEATUREFAIL || code == FP_INVALIDIMAGE;
+}
+
+static void prompt_replace(fp_quality_issue_t issue) {
+    system_message_t hint = {.type = MSG_FINGERPRINT_REPLACE, .data.replace.issue = issue};
+    publish_message(TOPIC_DISPLAY, &hint);
+}
+
+// Shows the user how the finger lay on the sensor
+static void show_preview(void) {
+    fp_image_preview(g_fingerprint_handle, g_display_handle, FINGERPRINT_PREVIEW_X,
+                     FINGERPRINT_PREVIEW_Y);
+}
+
+// Uploads the capture and judges it; an upload that fails lets the
+// capture through to the sensor's own checks
+static fp_quality_issue_t check_quality(bool draw) {
+    static const fp_quality_limits_t limits = {
+        .min_coverage_pct = FP_QUALITY_MIN_COVERAGE_PCT, .min_contrast_pct = FP_QUALITY_MIN_CONTRAST_PCT,
+        .min_period_10 = FP_QUALITY_MIN_PERIOD_10, .max_period_10 = FP_QUALITY_MAX_PERIOD_10,
+    };
+    fp_quality_t quality;
+    TRACE_BEGIN(TRACE_FP_QUALITY, 0);
+    esp_err_t ret = fp_image_inspect(g_fingerprint_handle, draw ? g_display_handle : NULL,
+                                     FINGERPRINT_PREVIEW_X, FINGERPRINT_PREVIEW_Y, &quality);
+    TRACE_END(TRACE_FP_QUALITY);
+    if (ret != ESP_OK) return FP_QUALITY_OK;
+
+    s_last_quality = quality;
+    fp_quality_issue_t issue = fp_quality_check(&quality, &limits);
+    if (issue != FP_QUALITY_OK) {
+        s_quality_rejects[issue]++;
+        ESP_LOGI(TAG, "Capture refused (%s): coverage %u%%, contrast %u%%, ridge period %u.%u px",
+                 fp_quality_issue_name(issue), quality.coverage_pct, quality.contrast_pct,
+                 quality.period_10 / 10, quality.period_10 % 10);
+    }
+    return issue;
+}
+
+// Waits for a finger and converts its image. The sensor's answer decides
+// the next step: poll tightly while there is no finger, re-prompt at once
+// on a bad placement, give up after repeated link errors.
+// Returns ESP_OK, ESP_ERR_TIMEOUT (no usable image in time) or ESP_FAIL
+// (sensor not answering).
 static esp_err_t get_image_and_convert(uint8_t buffer_id, int timeout_sec) {
-    TickType_t start = xTaskGetTickCount();
-    TickType_t end = start + pdMS_TO_TICKS(timeout_sec * 1000);
-    while (xTaskGetTickCount() < end) {
-        if (fingerprint_get_image(g_fingerprint_handle) == ESP_OK) {
-            if (fingerprint_image_to_tz(g_fingerprint_handle, buffer_id) == ESP_OK) return ESP_OK;
+    int64_t end_us = esp_timer_get_time() + timeout_sec * 1000000LL;
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    int comm_errors = 0;
+    bool prompted = false;
+    TRACE_BEGIN(TRACE_FP_CAPTURE, buffer_id);
+    while (esp_timer_get_time() < end_us) {
+        fp_result_t r = fingerprint_get_image_ex(g_fingerprint_handle);
+        // With the check on, one upload serves it and the preview
+        bool previewed = r.err == ESP_OK && FINGERPRINT_PREVIEW &&
+                         (FINGERPRINT_PREVIEW >= 2 || FINGERPRINT_QUALITY_CHECK);
+        if (r.err == ESP_OK && FINGERPRINT_QUALITY_CHECK) {
+            fp_quality_issue_t issue = check_quality(previewed);
+            if (issue != FP_QUALITY_OK) {
+                // Refused before conversion and search: retried at once
+                if (!prompted) prompt_replace(issue);
+                prompted = true;
+                continue;
+            }
+        } else if (previewed) {
+            show_preview();
+        }
+        if (r.err == ESP_OK) r = fingerprint_image_to_tz_ex(g_fingerprint_handle, buffer_id);
+        if (r.err == ESP_OK) {
+            ret = ESP_OK;
+            break;
+        }
+
+        if (r.code == FP_ERROR_RECV) {
+            s_capture_comm_errors++;
+            if (++comm_errors >= FP_CAPTURE_MAX_COMM_ERRORS) {
+                ESP_LOGE(TAG, "Sensor not answering (%s)", esp_err_to_name(r.err));
+                ret = ESP_FAIL;
+                break;
+            }
+            continue;
         }
-        vTaskDelay(pdMS_TO_TICKS(50));
+        comm_errors = 0;
+
+        if (r.code == FP_NO_FINGER) {
+            prompted = false;
+            vTaskDelay(pdMS_TO_TICKS(FP_CAPTURE_POLL_MS));
+        } else if (is_bad_placement(r.code)) {
+            // Retried straight away: the finger is usually moved by then
+            s_capture_replaced++;
+            if (!prompted) {
+                ESP_LOGI(TAG, "Capture refused by the sensor (%s)", fingerprint_code_name(r.code));
+                prompt_replace(FP_QUALITY_OK);
+                if (FINGERPRINT_PREVIEW == 1 && !previewed) show_preview();
+            }
+            prompted = true;
+        }
+        // FP_IMAGEFAIL and the rest: retry at once
     }
-    return ESP_ERR_TIMEOUT;
+    TRACE_END(TRACE_FP_CAPTURE);
+    return ret;
+}
+
+static void report_enrolled_slots(uint32_t cmd_id) {
+    uint8_t index[32];
+    if (fingerprint_read_index(g_fingerprint_handle, 0, index) != ESP_OK) {
+        push_channel_send_result(cmd_id, false, "\"error\":\"sensor\"");
+        return;
+    }
+
+    // "slots":[1,2,...] for up to 256 slots of 3 digits each
+    char detail[1100];
+    int len = snprintf(detail, sizeof(detail), "\"slots\":[");
+    bool first = true;
+    for (int slot = 0; slot < 256; slot++) {
+        if (index[slot / 8] & (1 << (slot % 8))) {
+            len += snprintf(detail + len, sizeof(detail) - len, first ? "%d" : ",%d", slot);
+            first = false;
+        }
+    }
+    snprintf(detail + len, sizeof(detail) - len, "]");
+    push_channel_send_result(cmd_id, true, detail);
+}
+
+// The same person again inside the window: recorded already, so nothing
+// goes to the network task
+static bool is_repeat(uint16_t fingerprint_id) {
+    uint32_t age_ms;
+    if (!anti_passback_is_repeat(fingerprint_id, esp_timer_get_time(),
+                                 ANTI_PASSBACK_WINDOW_SEC * 1000, &age_ms)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "ID %u already recorded %lu s ago, not sent", fingerprint_id,
+             (unsigned long)(age_ms / 1000));
+    return true;
+}
+
+static void report_repeat(uint16_t fingerprint_id) {
+    system_message_t msg = {.type = MSG_FINGERPRINT_DUPLICATE,
+                            .data.fingerprint.fingerprint_id = fingerprint_id};
+    publish_message(TOPIC_DISPLAY, &msg);
+    audio_play(AUDIO_BEEP, AUDIO_PRIO_RESULT);
 }
 
 static void wait_finger_remove() {
     while (fingerprint_get_image(g_fingerprint_handle) == ESP_OK) vTaskDelay(pdMS_TO_TICKS(100));
 }
 
+// --- Throughput mode: the sensor stays armed, feedback is left to the
+// subscribers of the result so the next capture is not held up ---
+
+static bool s_throughput = false;
+static bool s_finger_down = false;      // Last capture's finger not lifted yet
+static int64_t s_session_start_us;
+static uint32_t s_session_matches;
+static int64_t s_match_us[THROUGHPUT_RATE_WINDOW];  // Latest matches, circular
+static uint32_t s_match_count;
+static uint32_t s_scans_total;
+static portMUX_TYPE s_rate_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void record_match(int64_t now_us) {
+    portENTER_CRITICAL(&s_rate_lock);
+    s_match_us[s_match_count % THROUGHPUT_RATE_WINDOW] = now_us;
+    s_match_count++;
+    portEXIT_CRITICAL(&s_rate_lock);
+    s_session_matches++;
+}
+
+float fingerprint_throughput_per_minute(void) {
+    portENTER_CRITICAL(&s_rate_lock);
+    uint32_t n = s_match_count < THROUGHPUT_RATE_WINDOW ? s_match_count : THROUGHPUT_RATE_WINDOW;
+    int64_t last = s_match_count ? s_match_us[(s_match_count - 1) % THROUGHPUT_RATE_WINDOW] : 0;
+    int64_t first = s_match_count ? s_match_us[(s_match_count - n) % THROUGHPUT_RATE_WINDOW] : 0;
+    portEXIT_CRITICAL(&s_rate_lock);
+    // Intervals between people, so the first match of a queue counts once
+    if (n < 2 || last <= first) return 0.0f;
+    return (n - 1) * 60e6f / (float)(last - first);
+}
+
+static void set_throughput(bool enabled) {
+    if (enabled == s_throughput) return;
+    s_throughput = enabled;
+    int64_t now = esp_timer_get_time();
+    if (enabled) {
+        s_finger_down = false;
+        s_session_start_us = now;
+        s_session_matches = 0;
+        portENTER_CRITICAL(&s_rate_lock);
+        s_match_count = 0;
+        portEXIT_CRITICAL(&s_rate_lock);
+        ESP_LOGI(TAG, "Throughput mode on");
+    } else {
+        float minutes = (now - s_session_start_us) / 60e6f;
+        ESP_LOGI(TAG, "Throughput mode off: %lu match(es) in %.1f min, %.1f/min",
+                 (unsigned long)s_session_matches, minutes,
+                 minutes > 0 ? s_session_matches / minutes : 0.0f);
+    }
+}
+
+// One poll of the armed sensor; returns quickly so the bus is serviced
+// between captures
+static void throughput_step(void) {
+    if (xEventGroupGetBits(g_system_events) & EVENT_OUT_OF_SERVICE) {
+        vTaskDelay(pdMS_TO_TICKS(THROUGHPUT_POLL_MS));
+        return;
+    }
+
+    fp_result_t r = fingerprint_get_image_ex(g_fingerprint_handle);
+    if (r.code == FP_ERROR_RECV) s_capture_comm_errors++;
+    bool finger = r.err == ESP_OK;
+    if (s_finger_down || !finger) {
+        // A failed read says nothing about the finger: keep waiting for it
+        if (r.code != FP_ERROR_RECV) s_finger_down = finger;
+        vTaskDelay(pdMS_TO_TICKS(THROUGHPUT_POLL_MS));
+        return;
+    }
+
+    s_finger_down = true;
+    int64_t scan_start_us = esp_timer_get_time();
+    event_time_t captured;
+    time_capture(&captured);
+
+    TRACE_BEGIN(TRACE_FP_SCAN, 1);
+    r = fingerprint_image_to_tz_ex(g_fingerprint_handle, 1);
+    if (r.code == FP_ERROR_RECV) {
+        TRACE_END(TRACE_FP_SCAN);
+        s_capture_comm_errors++;
+        s_finger_down = false;
+        return;
+    }
+    if (is_bad_placement(r.code)) {
+        // Not a result: ask again and take the next image of the same finger
+        TRACE_END(TRACE_FP_SCAN);
+        s_capture_replaced++;
+        s_finger_down = false;
+        ESP_LOGI(TAG, "Capture refused by the sensor (%s)", fingerprint_code_name(r.code));
+        prompt_replace(FP_QUALITY_OK);
+        return;
+    }
+    uint16_t fingerprint_id = 0;
+    uint16_t score = 0;
+    esp_err_t ret = r.err;
+    if (ret == ESP_OK) {
+        TRACE_BEGIN(TRACE_FP_SEARCH, 0);
+        ret = fingerprint_search(g_fingerprint_handle, &fingerprint_id, &score);
+        TRACE_END(TRACE_FP_SEARCH);
+    }
+    TRACE_END(TRACE_FP_SCAN);
+    int64_t now = esp_timer_get_time();
+    metrics_observe_us(METRIC_SCAN_LATENCY, now - scan_start_us);
+    s_scans_total++;
+    if (ret == ESP_OK && is_repeat(fingerprint_id)) {
+        report_repeat(fingerprint_id);      // Not counted in the people per minute
+        return;
+    }
+
+    system_message_t result = {.type = MSG_FINGERPRINT_NOT_MATCHED, .captured = captured};
+    if (ret == ESP_OK) {
+        record_match(now);
+        result.type = MSG_FINGERPRINT_MATCHED;
+        result.data.fingerprint.fingerprint_id = fingerprint_id;
+        result.data.fingerprint.score = score;
+    }
+    publish_message(TOPIC_SCAN_RESULT, &result);
+}
+
+static void write_fingerprint_metrics(metrics_writer_t *w, void *user_data) {
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "capture_replaced_total counter\n");
+    metrics_printf(w, METRICS_PREFIX "capture_replaced_total %lu\n", (unsigned long)s_capture_replaced);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "capture_comm_errors_total counter\n");
+    metrics_printf(w, METRICS_PREFIX "capture_comm_errors_total %lu\n",
+                   (unsigned long)s_capture_comm_errors);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "quality_rejects_total counter\n");
+    for (int issue = FP_QUALITY_OK + 1; issue < FP_QUALITY_ISSUE_COUNT; issue++) {
+        metrics_printf(w, METRICS_PREFIX "quality_rejects_total{issue=\"%s\"} %lu\n",
+                       fp_quality_issue_name(issue), (unsigned long)s_quality_rejects[issue]);
+    }
+    if (FINGERPRINT_QUALITY_CHECK) {
+        metrics_printf(w, "# TYPE " METRICS_PREFIX "quality_coverage_percent gauge\n");
+        metrics_printf(w, METRICS_PREFIX "quality_coverage_percent %u\n", s_last_quality.coverage_pct);
+        metrics_printf(w, "# TYPE " METRICS_PREFIX "quality_contrast_percent gauge\n");
+        metrics_printf(w, METRICS_PREFIX "quality_contrast_percent %u\n", s_last_quality.contrast_pct);
+        metrics_printf(w, "# TYPE " METRICS_PREFIX "quality_ridge_period_pixels gauge\n");
+        metrics_printf(w, METRICS_PREFIX "quality_ridge_period_pixels %.1f\n",
+                       s_last_quality.period_10 / 10.0);
+    }
+    anti_passback_stats_t passback;
+    anti_passback_get_stats(&passback);
+    metrics_printf(w, "# HELP " METRICS_PREFIX "repeat_scans_suppressed_total Matches inside the "
+                   "%d s anti-passback window, not uploaded\n", ANTI_PASSBACK_WINDOW_SEC);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "repeat_scans_suppressed_total counter\n");
+    metrics_printf(w, METRICS_PREFIX "repeat_scans_suppressed_total %lu\n",
+                   (unsigned long)passback.suppressed);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "anti_passback_evicted_total counter\n");
+    metrics_printf(w, METRICS_PREFIX "anti_passback_evicted_total %lu\n",
+                   (unsigned long)passback.evicted);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "throughput_scans_total counter\n");
+    metrics_printf(w, METRICS_PREFIX "throughput_scans_total %lu\n", (unsigned long)s_scans_total);
+    metrics_printf(w, "# HELP " METRICS_PREFIX "throughput_people_per_minute Matches per minute "
+                   "over the last %d in throughput mode\n", THROUGHPUT_RATE_WINDOW);
+    metrics_printf(w, "# TYPE " METRICS_PREFIX "throughput_people_per_minute gauge\n");
+    metrics_printf(w, METRICS_PREFIX "throughput_people_per_minute %.2f\n",
+                   fingerprint_throughput_per_minute());
+}
+
+// Identify (1:N search), or verify a claimed ID (1:1 against that slot's
+// template, which takes the same time whatever the size of the library)
+static void scan(const uint16_t *claimed_id) {
+    TRACE_BEGIN(TRACE_FP_SCAN, claimed_id ? *claimed_id : 0);
+    int64_t scan_start_us = esp_timer_get_time();
+    g_current_state = STATE_FINGERPRINT_SCAN;
+    system_message_t ui_msg = {.type = MSG_DISPLAY_UPDATE};
+    publish_message(TOPIC_DISPLAY, &ui_msg);
+
+    // The claimed template goes to CharBuffer2 first: an empty slot fails
+    // without waiting for a finger, and the capture only uses CharBuffer1
+    esp_err_t ret = claimed_id ? fingerprint_load_model(g_fingerprint_handle, 2, *claimed_id) : ESP_OK;
+    esp_err_t capture_ret = ESP_OK;
+    if (ret == ESP_OK) capture_ret = get_image_and_convert(1, FINGERPRINT_TIMEOUT_SEC);
+    event_time_t captured;
+    time_capture(&captured);
+
+    if (capture_ret != ESP_OK) {
+        TRACE_END(TRACE_FP_SCAN);
+        g_current_state = STATE_FAILURE;
+        system_message_t fail_msg = {.type = capture_ret == ESP_ERR_TIMEOUT ? MSG_FINGERPRINT_TIMEOUT
+                                                                           : MSG_FINGERPRINT_ERROR};
+        publish_message(TOPIC_SCAN_RESULT, &fail_msg);
+        vTaskDelay(pdMS_TO_TICKS(FINGERPRINT_FAIL_HOLD_MS));
+        g_current_state = STATE_IDLE;
+        publish_message(TOPIC_DISPLAY, &ui_msg);
+        return;
+    }
+
+    uint16_t fingerprint_id = claimed_id ? *claimed_id : 0;
+    uint16_t score = 0;
+    if (ret == ESP_OK && claimed_id) {
+        TRACE_BEGIN(TRACE_FP_MATCH, fingerprint_id);
+        ret = fingerprint_match(g_fingerprint_handle, &score);
+        TRACE_END(TRACE_FP_MATCH);
+    } else if (ret == ESP_OK) {
+        TRACE_BEGIN(TRACE_FP_SEARCH, 0);
+        ret = fingerprint_search(g_fingerprint_handle, &fingerprint_id, &score);
+        TRACE_END(TRACE_FP_SEARCH);
+    }
+    TRACE_END(TRACE_FP_SCAN);
+    metrics_observe_us(METRIC_SCAN_LATENCY, esp_timer_get_time() - scan_start_us);
+    if (ret == ESP_OK && is_repeat(fingerprint_id)) {
+        g_current_state = STATE_SUCCESS;
+        report_repeat(fingerprint_id);
+        vTaskDelay(pdMS_TO_TICKS(FINGERPRINT_FAIL_HOLD_MS));
+        g_current_state = STATE_IDLE;
+        publish_message(TOPIC_DISPLAY, &ui_msg);
+        return;
+    }
+    if (ret == ESP_OK) {
+        g_current_state = STATE_SUCCESS;
+        system_message_t success_msg = { .type = MSG_FINGERPRINT_MATCHED, .captured = captured,
+                                        .data.fingerprint.fingerprint_id = fingerprint_id,
+                                        .data.fingerprint.score = score };
+        publish_message(TOPIC_SCAN_RESULT, &success_msg);
+    } else {
+        g_current_state = STATE_FAILURE;
+        system_message_t fail_msg = {.type = MSG_FINGERPRINT_NOT_MATCHED};
+        publish_message(TOPIC_SCAN_RESULT, &fail_msg);
+    }
+    vTaskDelay(pdMS_TO_TICKS(ret == ESP_OK ? 2000 : FINGERPRINT_FAIL_HOLD_MS));
+    g_current_state = STATE_IDLE;
+    publish_message(TOPIC_DISPLAY, &ui_msg);
+}
+
+// Runs with the event still held, so nothing here is copied out of the bus
+static void handle_message(const system_message_t *msg) {
+    EventBits_t bits = xEventGroupGetBits(g_system_events);
+
+    if (msg->type == MSG_BUTTON_PRESSED || msg->type == MSG_START_VERIFY) {
+        // Wall time is not needed to scan: events carry a capture stamp
+        // and are resolved once the clock is synced
+        if (bits & EVENT_OUT_OF_SERVICE) return;
+        if (s_throughput) return;       // Already armed
+        scan(msg->type == MSG_START_VERIFY ? &msg->data.fingerprint.fingerprint_id : NULL);
+    }
+    else if (msg->type == MSG_THROUGHPUT_MODE) {
+        set_throughput(msg->data.throughput.enabled);
+    }
+    else if (msg->type == MSG_START_ENROLL) {
+        uint16_t new_id = msg->data.enroll.enroll_id;
+        system_message_t step1 = {.type = MSG_ENROLL_STEP_1};
+        publish_message(TOPIC_DISPLAY, &step1);
+
+        if (get_image_and_convert(1, 10) != ESP_OK) {
+            system_message_t fail = {.type = MSG_ENROLL_FAIL};
+            publish_message(TOPIC_DISPLAY, &fail); return;
+        }
+        wait_finger_remove();
+        vTaskDelay(pdMS_TO_TICKS(500));
+
+        system_message_t step2 = {.type = MSG_ENROLL_STEP_2};
+        publish_message(TOPIC_DISPLAY, &step2);
+
+        if (get_image_and_convert(2, 10) != ESP_OK) {
+            system_message_t fail = {.type = MSG_ENROLL_FAIL};
+            publish_message(TOPIC_DISPLAY, &fail); return;
+        }
+
+        TRACE_BEGIN(TRACE_FP_STORE, new_id);
+        esp_err_t store_ret = fingerprint_create_model(g_fingerprint_handle);
+        if (store_ret == ESP_OK) store_ret = fingerprint_store_model(g_fingerprint_handle, new_id);
+        TRACE_END(TRACE_FP_STORE);
+        if (store_ret != ESP_OK) {
+            system_message_t fail = {.type = MSG_ENROLL_FAIL};
+            publish_message(TOPIC_DISPLAY, &fail); return;
+        }
+
+        system_message_t success = { .type = MSG_ENROLL_SUCCESS, .data.enroll.enroll_id = new_id };
+        publish_message(TOPIC_DISPLAY, &success);
+    }
+    else if (msg->type == MSG_REQ_DELETE_USER) {
+        uint16_t id = msg->data.fingerprint.fingerprint_id;
+        esp_err_t ret = fingerprint_delete_model(g_fingerprint_handle, id);
+        system_message_t res = { .type = MSG_DELETE_RESULT, .data.fingerprint.success = (ret == ESP_OK) };
+        publish_message(TOPIC_DISPLAY, &res);
+    }
+    else if (msg->type == MSG_REMOTE_DELETE_SLOT) {
+        // Server-initiated: answer over the push channel, leave the UI alone
+        esp_err_t ret = fingerprint_delete_model(g_fingerprint_handle, (uint16_t)msg->data.command.arg);
+        ESP_LOGI(TAG, "Remote delete of slot %ld: %s", (long)msg->data.command.arg,
+                 ret == ESP_OK ? "ok" : "failed");
+        push_channel_send_result(msg->data.command.cmd_id, ret == ESP_OK, NULL);
+    }
+    else if (msg->type == MSG_REMOTE_LIST_USERS) {
+        report_enrolled_slots(msg->data.command.cmd_id);
+    }
+}
+
 void fingerprint_task(void *pvParameters) {
     ESP_LOGI(TAG, "Fingerprint task started");
-    system_message_t msg;
+    metrics_register_collector(write_fingerprint_metrics, NULL);
     
     while (1) {
-        if (xQueueReceive(g_fingerprint_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            EventBits_t bits = xEventGroupGetBits(g_system_events);
-
-            if (msg.type == MSG_BUTTON_PRESSED) {
-                if (bits & EVENT_OUT_OF_SERVICE) continue;
-                if (!(bits & EVENT_NTP_SYNCED)) continue;
-                
-                g_current_state = STATE_FINGERPRINT_SCAN;
-                system_message_t ui_msg = {.type = MSG_DISPLAY_UPDATE};
-                xQueueSend(g_ui_queue, &ui_msg, 0);
-                
-                if (get_image_and_convert(1, FINGERPRINT_TIMEOUT_SEC) != ESP_OK) {
-                    g_current_state = STATE_FAILURE;
-                    system_message_t timeout_msg = {.type = MSG_FINGERPRINT_TIMEOUT};
-                    xQueueSend(g_ui_queue, &timeout_msg, 0);
-                    xQueueSend(g_audio_queue, &timeout_msg, 0);
-                    vTaskDelay(pdMS_TO_TICKS(2000));
-                    g_current_state = STATE_IDLE;
-                    xQueueSend(g_ui_queue, &ui_msg, 0);
-                    continue;
-                }
-                
-                uint16_t fingerprint_id;
-                uint16_t score;
-                if (fingerprint_search(g_fingerprint_handle, &fingerprint_id, &score) == ESP_OK) {
-                    g_current_state = STATE_SUCCESS;
-                    system_message_t success_msg = { .type = MSG_FINGERPRINT_MATCHED, .data.fingerprint.fingerprint_id = fingerprint_id };
-                    xQueueSend(g_ui_queue, &success_msg, 0);
-                    xQueueSend(g_audio_queue, &success_msg, 0);
-                    xQueueSend(g_network_queue, &success_msg, 0);
-                } else {
-                    g_current_state = STATE_FAILURE;
-                    system_message_t fail_msg = {.type = MSG_FINGERPRINT_NOT_MATCHED};
-                    xQueueSend(g_ui_queue, &fail_msg, 0);
-                    xQueueSend(g_audio_queue, &fail_msg, 0);
-                }
-                vTaskDelay(pdMS_TO_TICKS(2000));
-                g_current_state = STATE_IDLE;
-                xQueueSend(g_ui_queue, &ui_msg, 0);
-            }
-            else if (msg.type == MSG_START_ENROLL) {
-                uint16_t new_id = msg.data.enroll.enroll_id;
-                system_message_t step1 = {.type = MSG_ENROLL_STEP_1};
-                xQueueSend(g_ui_queue, &step1, 0);
-
-                if (get_image_and_convert(1, 10) != ESP_OK) {
-                    system_message_t fail = {.type = MSG_ENROLL_FAIL};
-                    xQueueSend(g_ui_queue, &fail, 0); continue;
-                }
-                wait_finger_remove();
-                vTaskDelay(pdMS_TO_TICKS(500));
-
-                system_message_t step2 = {.type = MSG_ENROLL_STEP_2};
-                xQueueSend(g_ui_queue, &step2, 0);
-
-                if (get_image_and_convert(2, 10) != ESP_OK) {
-                    system_message_t fail = {.type = MSG_ENROLL_FAIL};
-                    xQueueSend(g_ui_queue, &fail, 0); continue;
-                }
-
-                if (fingerprint_create_model(g_fingerprint_handle) != ESP_OK || 
-                    fingerprint_store_model(g_fingerprint_handle, new_id) != ESP_OK) {
-                    system_message_t fail = {.type = MSG_ENROLL_FAIL};
-                    xQueueSend(g_ui_queue, &fail, 0); continue;
-                }
-
-                system_message_t success = { .type = MSG_ENROLL_SUCCESS, .data.enroll.enroll_id = new_id };
-                xQueueSend(g_ui_queue, &success, 0);
-                xQueueSend(g_audio_queue, &success, 0);
-            }
-            else if (msg.type == MSG_REQ_DELETE_USER) {
-                uint16_t id = msg.data.fingerprint.fingerprint_id;
-                esp_err_t ret = fingerprint_delete_model(g_fingerprint_handle, id);
-                system_message_t res = { .type = MSG_DELETE_RESULT, .data.fingerprint.success = (ret == ESP_OK) };
-                xQueueSend(g_ui_queue, &res, 0);
-            }
+        const event_t *event = event_bus_receive(g_fingerprint_events,
+                                                 s_throughput ? 0 : portMAX_DELAY);
+        if (event) {
+            handle_message(event_message(event));
+            event_bus_release(event);
+        } else if (s_throughput) {
+            throughput_step();
         }
     }
 }
\ No newline at end of file
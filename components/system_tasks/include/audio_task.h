@@ -3,10 +3,40 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "system_state.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t played;          // Play commands sent
+    uint32_t coalesced;       // Pending request replaced by a newer one
+    uint32_t dropped;         // Request below what was playing or pending
+    uint32_t preempted;       // Track cut short by a new one
+    uint32_t errors;          // Error frames from the player
+    uint32_t ack_timeouts;
+} audio_stats_t;
 
 /**
- * @brief Audio task - handles MP3 playback
+ * @brief Audio task - schedules MP3 playback (priorities, coalescing, ack pacing)
  */
 void audio_task(void *pvParameters);
 
-#endif // AUDIO_TASK_H
\ No newline at end of file
+/**
+ * @brief Queue a sequence of tracks (e.g. prompt + spoken digits), non-blocking
+ * Tracks are played back to back, each started when the player reports the
+ * previous one finished.
+ * @return ESP_ERR_INVALID_SIZE above AUDIO_PLAYLIST_MAX, ESP_ERR_TIMEOUT if it could not be queued
+ */
+esp_err_t audio_play_sequence(const uint8_t *tracks, size_t count, audio_priority_t priority);
+
+/**
+ * @brief Queue a single track, non-blocking
+ */
+esp_err_t audio_play(uint8_t track, audio_priority_t priority);
+
+/**
+ * @brief Scheduler counters
+ */
+void audio_get_stats(audio_stats_t *stats);
+
+#endif // AUDIO_TASK_H
@@ -9,4 +9,10 @@
  */
 void fingerprint_task(void *pvParameters);
 
+/**
+ * @brief People per minute in throughput mode, over the last
+ *        THROUGHPUT_RATE_WINDOW matches (0 until there are two)
+ */
+float fingerprint_throughput_per_minute(void);
+
 #endif // FINGERPRINT_TASK_H
\ No newline at end of file
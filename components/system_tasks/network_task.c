@@ -1,113 +1,456 @@
 #include "network_task.h"
 #include "app_config.h"
+#include "attendance_journal.h"
+#include "audio_task.h"
+#include "cJSON.h"
+#include "diag_server.h"
+#include "dlog.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "metrics.h"
 #include "network_manager.h"
+#include "push_channel.h"
+#include "retry_scheduler.h"
 #include "system_state.h"
 #include "time_manager.h"
+#include "trace.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "NETWORK_TASK";
 
-static TickType_t last_server_check = 0;
+static TickType_t last_heartbeat = 0;
+static int64_t last_heartbeat_mono_us = 0;
+static TickType_t unreachable_since = 0;
 static bool server_reachable = true;
 
+// Records live in the attendance journal (NVS) until the server
+// acknowledges their sequence numbers, so resends after a crash or a
+// lost ack are deduplicated server-side by (device, stream, seq).
+#define UPLOAD_PAYLOAD_SIZE 1280
+#define UPLOAD_RESPONSE_SIZE 256
+
+static char s_device_id[16];
+static uint32_t s_sent_seq = 0;        // Last seq of a streamed batch awaiting its ack
+static TickType_t s_sent_at = 0;
+static int64_t s_sent_mono_us = 0;     // Same moment, for round-trip timing
+static bool s_waiting_for_time = false;
+static retry_scheduler_handle_t s_upload_retry = NULL;
+
+static bool s_channel_started = false;
+static TickType_t s_channel_retry_at = 0;
+static uint32_t s_channel_retry_ms = PUSH_INIT_RETRY_BASE_MS;
+static bool s_http_ok = false;         // Result of the last HTTP round trip
+
+// Runs in the push channel's task: translate into bus messages only
+static void handle_push_command(const push_command_t *cmd, void *user_data) {
+  system_message_t msg = {.data.command = {.cmd_id = cmd->id, .arg = cmd->arg}};
+  event_topic_t target;
+
+  switch (cmd->type) {
+  case PUSH_CMD_DELETE_SLOT:
+    msg.type = MSG_REMOTE_DELETE_SLOT;
+    target = TOPIC_FINGERPRINT;
+    break;
+  case PUSH_CMD_REFRESH_USERS:
+    msg.type = MSG_REMOTE_LIST_USERS;
+    target = TOPIC_FINGERPRINT;
+    break;
+  case PUSH_CMD_SET_VOLUME:
+    if (msg.data.command.arg < 0) msg.data.command.arg = 0;
+    if (msg.data.command.arg > 30) msg.data.command.arg = 30;
+    msg.type = MSG_SET_VOLUME;
+    target = TOPIC_AUDIO;
+    break;
+  default:
+    return;
+  }
+
+  ESP_LOGI(TAG, "Server command %lu (type %d)", (unsigned long)cmd->id, cmd->type);
+  if (publish_message(target, &msg) != ESP_OK) {
+    push_channel_send_result(cmd->id, false, "\"error\":\"busy\"");
+  } else if (cmd->type == PUSH_CMD_SET_VOLUME) {
+    push_channel_send_result(cmd->id, true, NULL);
+  }
+}
+
+// esp_timer context: just wake the task. The timer is one-shot, so a lost
+// message would end the retries; the task loop also polls the fallback bit.
+static void upload_retry_due(void *user_data) {
+  system_message_t msg = {.type = MSG_UPLOAD_RETRY};
+  if (publish_message(TOPIC_NETWORK, &msg) != ESP_OK) {
+    xEventGroupSetBits(g_system_events, EVENT_UPLOAD_RETRY_DUE);
+  }
+}
+
+// WebSocket client task: hand the watermark to the network task
+static void handle_push_ack(uint32_t ack_seq, int64_t server_time_ms, void *user_data) {
+  system_message_t msg = {.type = MSG_UPLOAD_ACK,
+                          .data.upload = {.ack_seq = ack_seq, .server_time_ms = server_time_ms}};
+  time_capture(&msg.captured);
+  publish_message(TOPIC_NETWORK, &msg);
+}
+
+static void handle_push_time(int64_t server_time_ms, void *user_data) {
+  system_message_t msg = {.type = MSG_SERVER_TIME,
+                          .data.upload.server_time_ms = server_time_ms};
+  time_capture(&msg.captured);
+  publish_message(TOPIC_NETWORK, &msg);
+}
+
+// Appends one record; returns false if the buffer is full
+static bool format_record(journal_record_t *record, char *buffer, size_t size,
+                          size_t *len) {
+  const char *sep = (buffer[*len - 1] == '[') ? "" : ",";
+  int n;
+
+  if (record->flags & JOURNAL_FLAG_LOST) {
+    // Nothing left but the number; the server acks past it
+    n = snprintf(buffer + *len, size - *len, "%s{\"seq\":%lu,\"lost\":true}", sep,
+                 (unsigned long)record->seq);
+    if (n < 0 || (size_t)n >= size - *len) return false;
+    *len += n;
+    return true;
+  }
+
+  if (!(record->flags & JOURNAL_FLAG_WALL_VALID)) {
+    struct timeval wall;
+    if (time_event_to_wall(&record->captured, &wall) == ESP_OK) {
+      // Persist it: a resend after reboot must carry the same timestamp
+      record->wall_us = (int64_t)wall.tv_sec * 1000000 + wall.tv_usec;
+      record->flags |= JOURNAL_FLAG_WALL_VALID;
+      journal_set_wall_time(record->seq, record->wall_us);
+    }
+  }
+
+  char timestamp[40] = "null";
+  if (record->flags & JOURNAL_FLAG_WALL_VALID) {
+    struct timeval wall = {.tv_sec = (time_t)(record->wall_us / 1000000),
+                           .tv_usec = (suseconds_t)(record->wall_us % 1000000)};
+    char iso[36];
+    time_format_wall_iso8601(&wall, iso, sizeof(iso));
+    snprintf(timestamp, sizeof(timestamp), "\"%s\"", iso);
+  }
+
+  // Determine login method string
+  const char *method_str =
+      (record->method == LOGIN_METHOD_KEYPAD) ? "keypad" : "fingerprint";
+
+  n = snprintf(buffer + *len, size - *len,
+               "%s{\"seq\":%lu,\"fingerprint_id\":%d,\"timestamp\":%s,"
+               "\"login_method\":\"%s\"}",
+               sep, (unsigned long)record->seq, record->fingerprint_id, timestamp,
+               method_str);
+  if (n < 0 || (size_t)n >= size - *len) return false;
+  *len += n;
+  return true;
+}
+
+// Builds {"device_id",...,"records":[...]} from the oldest pending records.
+// Returns the number of records included (0 = nothing sendable yet).
+static size_t format_batch(char *payload, size_t size, uint32_t *last_seq) {
+  journal_stats_t stats;
+  journal_get_stats(&stats);
+
+  journal_record_t batch[UPLOAD_BATCH_SIZE];
+  size_t count = journal_peek(stats.acked_seq, batch, UPLOAD_BATCH_SIZE);
+
+  // base_seq tells the server that anything older is gone for good
+  size_t len = snprintf(payload, size,
+                        "{\"device_id\":\"%s\",\"stream_id\":%lu,\"base_seq\":%lu,"
+                        "\"records\":[",
+                        s_device_id, (unsigned long)stats.stream_id,
+                        (unsigned long)journal_first_seq());
+
+  size_t included = 0;
+  for (size_t i = 0; i < count; i++) {
+    journal_record_t *record = &batch[i];
+    if (!(record->flags & (JOURNAL_FLAG_WALL_VALID | JOURNAL_FLAG_LOST)) &&
+        !time_is_synced() && record->captured.boot_id == time_get_boot_id()) {
+      // Clock not synced yet: hold until it is (checked in the task loop)
+      s_waiting_for_time = true;
+      break;
+    }
+    if (!format_record(record, payload, size - 2, &len)) break;
+    *last_seq = record->seq;
+    included++;
+  }
+
+  payload[len++] = ']';
+  payload[len++] = '}';
+  payload[len] = '\0';
+  return included;
+}
+
+static bool parse_ack(const char *response, uint32_t *ack_seq, int64_t *server_time_ms) {
+  cJSON *root = cJSON_Parse(response);
+  if (!root) return false;
+  cJSON *ack = cJSON_GetObjectItem(root, "ack_seq");
+  cJSON *server_time = cJSON_GetObjectItem(root, "server_time_ms");
+  bool ok = cJSON_IsNumber(ack);
+  if (ok) *ack_seq = (uint32_t)ack->valuedouble;
+  *server_time_ms = cJSON_IsNumber(server_time) ? (int64_t)server_time->valuedouble : 0;
+  cJSON_Delete(root);
+  return ok;
+}
+
+static void drain_outbox(void);
+
+static void handle_ack(const system_message_t *msg) {
+  uint32_t ack_seq = msg->data.upload.ack_seq;
+  TRACE_INSTANT(TRACE_NET_ACK, ack_seq);
+  journal_ack(ack_seq);
+  if (s_sent_seq && ack_seq >= s_sent_seq) {
+    // The ack answers our batch, so its server time comes with a known round-trip
+    if (msg->data.upload.server_time_ms) {
+      time_feed_server_time(msg->data.upload.server_time_ms * 1000, s_sent_mono_us,
+                            msg->captured.mono_us, 1000);
+    }
+    s_sent_seq = 0;
+    retry_scheduler_record_success(s_upload_retry);
+    drain_outbox();
+  }
+}
+
+static void drain_outbox(void) {
+  journal_stats_t stats;
+  journal_get_stats(&stats);
+
+  // One batch in flight at a time; a missing ack is handled in the task loop
+  while (stats.pending > 0 && !s_sent_seq) {
+    char *payload = malloc(UPLOAD_PAYLOAD_SIZE + 32);
+    if (!payload) return;
+
+    uint32_t last_seq = 0;
+    s_waiting_for_time = false;
+    // Leave room in front for the channel's "type" member
+    char *body = payload + 32;
+    size_t count = format_batch(body, UPLOAD_PAYLOAD_SIZE, &last_seq);
+    if (count == 0 || !retry_scheduler_can_attempt(s_upload_retry)) {
+      free(payload);
+      return;
+    }
+
+    // Prefer the open channel: no connection setup, ack arrives as a frame
+    if (push_channel_is_connected()) {
+      static const char prefix[] = "{\"type\":\"attendance\",";
+      char *frame = body + 1 - (sizeof(prefix) - 1);
+      memcpy(frame, prefix, sizeof(prefix) - 1);
+      if (push_channel_send(frame) == ESP_OK) {
+        TRACE_INSTANT(TRACE_NET_STREAM, count);
+        DLOGI(TAG, "Streamed %u record(s) up to seq %lu", (unsigned)count,
+              (unsigned long)last_seq);
+        s_sent_seq = last_seq;
+        s_sent_at = xTaskGetTickCount();
+        s_sent_mono_us = esp_timer_get_time();
+        free(payload);
+        return;
+      }
+      ESP_LOGW(TAG, "Channel send failed, falling back to HTTP POST");
+      body[0] = '{';
+    }
+
+    char response[UPLOAD_RESPONSE_SIZE];
+    uint32_t ack_seq = 0;
+    int64_t server_time_ms = 0;
+    DLOGI(TAG, "Sending HTTP POST: %u record(s) up to seq %lu", (unsigned)count,
+          (unsigned long)last_seq);
+    // Round-trip includes connection setup: a pessimistic but safe bound
+    int64_t request_us = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_NET_POST, count);
+    esp_err_t ret = network_http_post_read(HTTP_SERVER_URL, body, response,
+                                           sizeof(response));
+    TRACE_END(TRACE_NET_POST);
+    int64_t response_us = esp_timer_get_time();
+    metrics_observe_us(METRIC_UPLOAD_LATENCY, response_us - request_us);
+    free(payload);
+
+    s_http_ok = (ret == ESP_OK);
+    if (ret == ESP_OK && parse_ack(response, &ack_seq, &server_time_ms)) {
+      journal_ack(ack_seq);
+      if (server_time_ms) {
+        time_feed_server_time(server_time_ms * 1000, request_us, response_us, 1000);
+      }
+    }
+    if (ret != ESP_OK || ack_seq < last_seq) {
+      retry_scheduler_record_failure(s_upload_retry);
+      journal_get_stats(&stats);
+      ESP_LOGE(TAG, "Upload failed, %lu record(s) pending", (unsigned long)stats.pending);
+      return;
+    }
+    retry_scheduler_record_success(s_upload_retry);
+    journal_get_stats(&stats);
+  }
+}
+
+// Reachability follows the push channel and, while it is down, the last
+// HTTP upload; no HEAD polling
+static void update_server_state(void) {
+  TickType_t now = xTaskGetTickCount();
+  EventBits_t bits = xEventGroupGetBits(g_system_events);
+
+  if (push_channel_is_connected() || s_http_ok) {
+    if (!server_reachable) {
+      ESP_LOGI(TAG, "Server is now reachable");
+      server_reachable = true;
+      drain_outbox();
+    }
+    if (!(bits & EVENT_HTTP_AVAILABLE) || (bits & EVENT_OUT_OF_SERVICE)) {
+      xEventGroupSetBits(g_system_events, EVENT_HTTP_AVAILABLE);
+      xEventGroupClearBits(g_system_events, EVENT_OUT_OF_SERVICE);
+    }
+    return;
+  }
+
+  if (server_reachable) {
+    ESP_LOGW(TAG, "Server unreachable");
+    server_reachable = false;
+    unreachable_since = now;
+    xEventGroupClearBits(g_system_events, EVENT_HTTP_AVAILABLE);
+  } else if (!(bits & EVENT_OUT_OF_SERVICE) &&
+             (now - unreachable_since) > pdMS_TO_TICKS(OUT_OF_SERVICE_TIMEOUT_SEC * 1000)) {
+    ESP_LOGE(TAG, "Entering out-of-service mode");
+    xEventGroupSetBits(g_system_events, EVENT_OUT_OF_SERVICE);
+
+    // Play out-of-service audio
+    audio_play(AUDIO_OUT_OF_SERVICE, AUDIO_PRIO_ALERT);
+  }
+}
+
+// Set up the push channel; a failure is retried from the task loop with backoff
+static void start_push_channel(void) {
+  TickType_t now = xTaskGetTickCount();
+  if (s_channel_started || (int32_t)(now - s_channel_retry_at) < 0) return;
+
+  if (network_get_device_id(s_device_id, sizeof(s_device_id)) == ESP_OK &&
+      push_channel_init(PUSH_CHANNEL_URL, s_device_id) == ESP_OK) {
+    push_channel_register_callback(handle_push_command, NULL);
+    push_channel_register_ack_callback(handle_push_ack, NULL);
+    push_channel_register_time_callback(handle_push_time, NULL);
+    push_channel_start();
+    s_channel_started = true;
+    return;
+  }
+
+  ESP_LOGE(TAG, "Push channel unavailable, retrying in %lu ms",
+           (unsigned long)s_channel_retry_ms);
+  s_channel_retry_at = now + pdMS_TO_TICKS(s_channel_retry_ms);
+  s_channel_retry_ms = s_channel_retry_ms * 2 < PUSH_INIT_RETRY_MAX_MS
+                           ? s_channel_retry_ms * 2
+                           : PUSH_INIT_RETRY_MAX_MS;
+}
+
+static void send_heartbeat(void) {
+  retry_scheduler_stats_t stats;
+  journal_stats_t journal;
+  retry_scheduler_get_stats(s_upload_retry, &stats);
+  journal_get_stats(&journal);
+
+  char frame[448];
+  snprintf(frame, sizeof(frame),
+           "{\"type\":\"heartbeat\",\"need_time\":%s,\"uptime_s\":%lu,\"free_heap\":%lu,"
+           "\"state\":%d,\"upload\":{\"pending\":%lu,\"overwritten\":%lu,"
+           "\"next_seq\":%lu,\"acked_seq\":%lu,"
+           "\"breaker\":\"%s\",\"attempts\":%lu,\"failures\":%lu,"
+           "\"consecutive_failures\":%lu,\"breaker_opens\":%lu,"
+           "\"last_outage_ms\":%lu,\"max_outage_ms\":%lu,\"total_outage_ms\":%lu}}",
+           // Without NTP, the reply's server time is our clock source
+           time_get_source() == TIME_SOURCE_NTP ? "false" : "true",
+           (unsigned long)(pdTICKS_TO_MS(xTaskGetTickCount()) / 1000),
+           (unsigned long)esp_get_free_heap_size(), (int)g_current_state,
+           (unsigned long)journal.pending, (unsigned long)journal.overwritten,
+           (unsigned long)journal.next_seq, (unsigned long)journal.acked_seq,
+           retry_breaker_state_name(stats.state), (unsigned long)stats.attempts,
+           (unsigned long)stats.failures, (unsigned long)stats.consecutive_failures,
+           (unsigned long)stats.breaker_opens, (unsigned long)stats.last_outage_ms,
+           (unsigned long)stats.max_outage_ms, (unsigned long)stats.total_outage_ms);
+  last_heartbeat_mono_us = esp_timer_get_time();
+  push_channel_send(frame);
+}
+
 void network_task(void *pvParameters) {
   ESP_LOGI(TAG, "Network task started");
 
-  system_message_t msg;
+  if (journal_init() != ESP_OK) {
+    ESP_LOGE(TAG, "Attendance journal unavailable, records will be lost");
+  }
+
+  // Trace download etc.; binds to any address, so Wi-Fi may come up later
+  if (diag_server_start(DIAG_HTTP_PORT) != ESP_OK) {
+    ESP_LOGW(TAG, "Diagnostics server unavailable");
+  }
+
+  retry_scheduler_config_t retry_config = {
+      .name = "upload",
+      .base_delay_ms = UPLOAD_RETRY_BASE_MS,
+      .max_delay_ms = UPLOAD_RETRY_MAX_MS,
+      .failure_threshold = UPLOAD_BREAKER_THRESHOLD,
+      .open_duration_ms = UPLOAD_BREAKER_OPEN_MS,
+      .on_due = upload_retry_due,
+  };
+  ESP_ERROR_CHECK(retry_scheduler_create(&retry_config, &s_upload_retry));
 
   while (1) {
-    // Check server reachability periodically
-    TickType_t now = xTaskGetTickCount();
-    if ((now - last_server_check) > pdMS_TO_TICKS(10000)) { // Every 10 seconds
-      last_server_check = now;
-
-      EventBits_t bits = xEventGroupGetBits(g_system_events);
-      if (bits & EVENT_WIFI_CONNECTED) {
-        bool reachable = network_is_server_reachable(HTTP_SERVER_URL);
-
-        if (reachable && !server_reachable) {
-          ESP_LOGI(TAG, "Server is now reachable");
-          server_reachable = true;
-          xEventGroupSetBits(g_system_events, EVENT_HTTP_AVAILABLE);
-          xEventGroupClearBits(g_system_events, EVENT_OUT_OF_SERVICE);
-        } else if (!reachable && server_reachable) {
-          ESP_LOGW(TAG, "Server unreachable");
-          server_reachable = false;
-          xEventGroupClearBits(g_system_events, EVENT_HTTP_AVAILABLE);
-
-          // Start out-of-service timer
-          vTaskDelay(pdMS_TO_TICKS(OUT_OF_SERVICE_TIMEOUT_SEC * 1000));
-
-          // Check again
-          if (!network_is_server_reachable(HTTP_SERVER_URL)) {
-            ESP_LOGE(TAG, "Entering out-of-service mode");
-            xEventGroupSetBits(g_system_events, EVENT_OUT_OF_SERVICE);
-
-            // Play out-of-service audio
-            system_message_t audio_msg = {.type = MSG_PLAY_AUDIO,
-                                          .data.audio.track_number =
-                                              AUDIO_OUT_OF_SERVICE};
-            xQueueSend(g_audio_queue, &audio_msg, 0);
-          }
-        }
-      }
+    start_push_channel();
+    update_server_state();
+
+    if (xEventGroupClearBits(g_system_events, EVENT_UPLOAD_RETRY_DUE) &
+        EVENT_UPLOAD_RETRY_DUE) {
+      drain_outbox();
     }
 
-    // Wait for HTTP POST request
-    if (xQueueReceive(g_network_queue, &msg, pdMS_TO_TICKS(100)) == pdTRUE) {
-      if (msg.type == MSG_FINGERPRINT_MATCHED) {
-        ESP_LOGI(TAG, "Received fingerprint match, preparing HTTP POST");
-
-        // Get current timestamp
-        char timestamp[64];
-        esp_err_t ret = time_get_iso8601(timestamp, sizeof(timestamp));
-        if (ret != ESP_OK) {
-          ESP_LOGE(TAG, "Failed to get timestamp");
-          continue;
-        }
+    if (s_waiting_for_time && time_is_synced()) {
+      ESP_LOGI(TAG, "Clock synced, uploading held records");
+      drain_outbox();
+    }
 
-        // Determine login method string
-        const char *method_str =
-            (msg.data.fingerprint.method == LOGIN_METHOD_KEYPAD)
-                ? "keypad"
-                : "fingerprint";
-
-        // Build JSON payload
-        char json_payload[256];
-        snprintf(json_payload, sizeof(json_payload),
-                 "{\"fingerprint_id\":%d,\"timestamp\":\"%s\",\"login_method\":"
-                 "\"%s\"}",
-                 msg.data.fingerprint.fingerprint_id, timestamp, method_str);
-
-        ESP_LOGI(TAG, "Sending HTTP POST: %s", json_payload);
-
-        // Send HTTP POST with retries
-        int retry = 0;
-        bool success = false;
-
-        while (retry < HTTP_RETRY_COUNT && !success) {
-          ret = network_http_post(HTTP_SERVER_URL, json_payload);
-
-          if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "HTTP POST successful");
-            success = true;
-
-            // Can notify other tasks if needed
-          } else {
-            ESP_LOGE(TAG, "HTTP POST failed, retry %d/%d", retry + 1,
-                     HTTP_RETRY_COUNT);
-            retry++;
-            vTaskDelay(pdMS_TO_TICKS(1000));
-          }
-        }
+    TickType_t now = xTaskGetTickCount();
+    if (s_sent_seq && (now - s_sent_at) > pdMS_TO_TICKS(UPLOAD_ACK_TIMEOUT_MS)) {
+      // Resend from the watermark; the server drops what it already has
+      ESP_LOGW(TAG, "No ack for seq %lu, resending", (unsigned long)s_sent_seq);
+      s_sent_seq = 0;
+      retry_scheduler_record_failure(s_upload_retry);
+    }
+
+    // Until the clock is valid, heartbeats double as time requests
+    uint32_t heartbeat_sec = time_is_synced() ? PUSH_HEARTBEAT_INTERVAL_SEC
+                                              : PUSH_TIME_PROBE_INTERVAL_SEC;
+    if (server_reachable &&
+        (now - last_heartbeat) > pdMS_TO_TICKS(heartbeat_sec * 1000)) {
+      last_heartbeat = now;
+      send_heartbeat();
+    }
 
-        if (!success) {
-          ESP_LOGE(TAG, "HTTP POST failed after all retries");
-          // Can cache for later retry if needed
+    // Wait for attendance records, acks and retry timer wake-ups
+    const event_t *event = event_bus_receive(g_network_events, pdMS_TO_TICKS(100));
+    if (event) {
+      const system_message_t *msg = event_message(event);
+      if (msg->type == MSG_FINGERPRINT_MATCHED) {
+        journal_record_t record = {
+            .fingerprint_id = msg->data.fingerprint.fingerprint_id,
+            .method = (uint8_t)msg->data.fingerprint.method,
+            .captured = msg->captured,
+        };
+        TRACE_BEGIN(TRACE_NET_JOURNAL, record.fingerprint_id);
+        esp_err_t ret = journal_append(&record);
+        TRACE_END(TRACE_NET_JOURNAL);
+        if (ret == ESP_OK) {
+          DLOGI(TAG, "Attendance record journaled as seq %lu", (unsigned long)record.seq);
+        } else {
+          ESP_LOGE(TAG, "Failed to journal attendance record");
         }
+        drain_outbox();
+      } else if (msg->type == MSG_UPLOAD_ACK) {
+        handle_ack(msg);
+      } else if (msg->type == MSG_SERVER_TIME) {
+        time_feed_server_time(msg->data.upload.server_time_ms * 1000, last_heartbeat_mono_us,
+                              msg->captured.mono_us, 1000);
+      } else if (msg->type == MSG_UPLOAD_RETRY) {
+        drain_outbox();
       }
+      event_bus_release(event);
     }
   }
 }
\ No newline at end of file
@@ -6,40 +6,34 @@
 
 static const char *TAG = "TIME_SYNC_TASK";
 
+static const char *source_name(time_source_t source) {
+    switch (source) {
+        case TIME_SOURCE_RESTORED: return "RTC restore";
+        case TIME_SOURCE_NTP:      return "NTP";
+        default:                   return "none";
+    }
+}
+
 void time_sync_task(void *pvParameters) {
     ESP_LOGI(TAG, "Time sync task started");
     
-    // Wait for initial time sync (handled by time_manager_init)
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    
-    // Check initial sync status
-    if (time_is_synced()) {
-        ESP_LOGI(TAG, "Initial time sync successful");
-        xEventGroupSetBits(g_system_events, EVENT_NTP_SYNCED);
-    } else {
-        ESP_LOGE(TAG, "Initial time sync failed");
-        xEventGroupClearBits(g_system_events, EVENT_NTP_SYNCED);
-    }
+    // SNTP polls by itself every NTP_SYNC_INTERVAL_SEC and slews the clock,
+    // so this task only publishes the state. Once valid, the clock never
+    // goes invalid again: no scan-refusal window around periodic syncs.
+    time_source_t last_source = TIME_SOURCE_NONE;
     
     while (1) {
-        // Periodic re-sync
-        vTaskDelay(pdMS_TO_TICKS(NTP_SYNC_INTERVAL_SEC * 1000));
-        
-        ESP_LOGI(TAG, "Performing periodic NTP sync");
+        time_source_t source = time_get_source();
+        if (source != last_source) {
+            ESP_LOGI(TAG, "Time source: %s (drift %ld ppb)", source_name(source),
+                     (long)time_get_drift_ppb());
+            last_source = source;
+        }
         
-        EventBits_t bits = xEventGroupGetBits(g_system_events);
-        if (bits & EVENT_WIFI_CONNECTED) {
-            esp_err_t ret = time_force_sync();
-            
-            if (ret == ESP_OK) {
-                ESP_LOGI(TAG, "Periodic time sync successful");
-                xEventGroupSetBits(g_system_events, EVENT_NTP_SYNCED);
-            } else {
-                ESP_LOGE(TAG, "Periodic time sync failed");
-                xEventGroupClearBits(g_system_events, EVENT_NTP_SYNCED);
-            }
-        } else {
-            ESP_LOGW(TAG, "Wi-Fi not connected, skipping time sync");
+        if (time_is_synced()) {
+            xEventGroupSetBits(g_system_events, EVENT_NTP_SYNCED);
         }
+        
+        vTaskDelay(pdMS_TO_TICKS(1000));
     }
-}
\ No newline at end of file
+}
@@ -1,8 +1,16 @@
 #include "ui_task.h"
+#include "anti_passback.h"
 #include "app_config.h"
+#include "audio_task.h"
 #include "display_driver.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "fingerprint_task.h"
+#include "fp_quality.h"
+#include "keypad_driver.h"
+#include "metrics.h"
 #include "system_state.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,14 +18,14 @@
 static const char *TAG = "UI_TASK";
 
 extern display_handle_t g_display_handle;
-extern QueueHandle_t g_network_queue;
-extern QueueHandle_t g_audio_queue;
+extern keypad_handle_t g_keypad_handle;
 
 volatile system_state_t g_current_state = STATE_IDLE;
 
 // --- Screen Drawing Functions ---
 
 static void draw_idle_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLACK);
   display_draw_text_large(display, 40, 20, "ATTENDANCE", COLOR_WHITE,
                           COLOR_BLACK);
@@ -26,32 +34,103 @@ static void draw_idle_screen(display_handle_t display) {
                     COLOR_BLACK);
   display_draw_text(display, 10, 110, "D:Remove #:Admin", COLOR_CYAN,
                     COLOR_BLACK);
+  display_draw_text(display, 10, 140, "C:ID+Finger  Hold A:Queue", COLOR_CYAN,
+                    COLOR_BLACK);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_scanning_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLACK);
   display_draw_text_large(display, 20, 50, "PLACE FINGER", COLOR_YELLOW,
                           COLOR_BLACK);
   display_draw_text(display, 60, 100, "Scanning...", COLOR_WHITE, COLOR_BLACK);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_success_screen(display_handle_t display, uint16_t fp_id) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_GREEN);
   display_draw_text_large(display, 50, 40, "SUCCESS!", COLOR_WHITE,
                           COLOR_GREEN);
   char id_str[32];
   snprintf(id_str, sizeof(id_str), "ID: %d", fp_id);
   display_draw_text_large(display, 80, 90, id_str, COLOR_WHITE, COLOR_GREEN);
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+// Same ID again inside the anti-passback window: nothing new is recorded
+static void draw_already_recorded_screen(display_handle_t display,
+                                         uint16_t fp_id) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
+  display_clear(display, COLOR_ORANGE);
+  display_draw_text_large(display, 50, 30, "ALREADY", COLOR_WHITE,
+                          COLOR_ORANGE);
+  display_draw_text_large(display, 40, 60, "RECORDED", COLOR_WHITE,
+                          COLOR_ORANGE);
+  char id_str[32];
+  snprintf(id_str, sizeof(id_str), "ID: %d", fp_id);
+  display_draw_text(display, 80, 110, id_str, COLOR_WHITE, COLOR_ORANGE);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_failure_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_RED);
   display_draw_text_large(display, 60, 50, "FAILED", COLOR_WHITE, COLOR_RED);
   display_draw_text(display, 40, 100, "Try again", COLOR_WHITE, COLOR_RED);
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+// What to change, by what was wrong with the image
+static const char *replace_hint(uint8_t issue, bool narrow) {
+  switch (issue) {
+  case FP_QUALITY_PARTIAL:
+    return "Center it";
+  case FP_QUALITY_FAINT:
+    return "Press more";
+  case FP_QUALITY_SMUDGED:
+    return "Wipe dry";
+  default:
+    return narrow ? "Press flat" : "Press flat, centered";
+  }
+}
+
+// The fingerprint task may already be drawing its preview on the right:
+// with the preview on, only the left side is cleared
+static void draw_replace_finger_screen(display_handle_t display,
+                                       uint8_t issue) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
+  if (FINGERPRINT_PREVIEW) {
+    display_fill_rect(display, 0, 0, FINGERPRINT_PREVIEW_X, LCD_V_RES,
+                      COLOR_BLACK);
+    display_draw_text_large(display, 10, 40, "ADJUST", COLOR_YELLOW,
+                            COLOR_BLACK);
+    display_draw_text_large(display, 10, 70, "FINGER", COLOR_YELLOW,
+                            COLOR_BLACK);
+    display_draw_text(display, 10, 120, replace_hint(issue, true),
+                      COLOR_WHITE, COLOR_BLACK);
+  } else {
+    display_clear(display, COLOR_BLACK);
+    display_draw_text_large(display, 10, 50, "ADJUST FINGER", COLOR_YELLOW,
+                            COLOR_BLACK);
+    display_draw_text(display, 30, 100, replace_hint(issue, false),
+                      COLOR_WHITE, COLOR_BLACK);
+  }
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+static void draw_sensor_error_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
+  display_clear(display, COLOR_RED);
+  display_draw_text_large(display, 60, 50, "FAILED", COLOR_WHITE, COLOR_RED);
+  display_draw_text(display, 40, 100, "Sensor error", COLOR_WHITE, COLOR_RED);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_admin_pin_screen(display_handle_t display,
                                   const char *pin_buffer) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLUE);
   display_draw_text_large(display, 30, 30, "ADMIN MODE", COLOR_WHITE,
                           COLOR_BLUE);
@@ -66,10 +145,12 @@ static void draw_admin_pin_screen(display_handle_t display,
 
   display_draw_text_large(display, 80, 110, display_pin, COLOR_YELLOW,
                           COLOR_BLUE);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_register_screen(display_handle_t display,
                                  const char *id_buffer) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLUE);
   display_draw_text_large(display, 10, 30, "NEW USER", COLOR_WHITE, COLOR_BLUE);
   display_draw_text(display, 20, 70, "Enter ID (1-200):", COLOR_WHITE,
@@ -78,10 +159,12 @@ static void draw_register_screen(display_handle_t display,
                           COLOR_BLUE);
   display_draw_text(display, 40, 140, "Press '#' to Save", COLOR_WHITE,
                     COLOR_BLUE);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_remove_user_screen(display_handle_t display,
                                     const char *id_buffer) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_RED);
   display_draw_text_large(display, 10, 30, "DELETE USER", COLOR_WHITE,
                           COLOR_RED);
@@ -91,10 +174,12 @@ static void draw_remove_user_screen(display_handle_t display,
                           COLOR_RED);
   display_draw_text(display, 40, 140, "#=Delete  *=Exit", COLOR_WHITE,
                     COLOR_RED);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_manual_attendance_screen(display_handle_t display,
                                           const char *id_buffer) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLUE);
   display_draw_text_large(display, 10, 30, "MANUAL ENTRY", COLOR_WHITE,
                           COLOR_BLUE);
@@ -106,47 +191,174 @@ static void draw_manual_attendance_screen(display_handle_t display,
     display_draw_text(display, 100, 110, "_", COLOR_GRAY, COLOR_BLUE);
   }
   display_draw_text(display, 40, 140, "#=Log  *=Exit", COLOR_WHITE, COLOR_BLUE);
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+static void draw_verify_id_screen(display_handle_t display,
+                                 const char *id_buffer) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
+  display_clear(display, COLOR_BLUE);
+  display_draw_text_large(display, 10, 30, "VERIFY", COLOR_WHITE, COLOR_BLUE);
+  display_draw_text(display, 20, 70, "Enter User ID:", COLOR_WHITE, COLOR_BLUE);
+  if (strlen(id_buffer) > 0) {
+    display_draw_text_large(display, 100, 110, id_buffer, COLOR_YELLOW,
+                            COLOR_BLUE);
+  } else {
+    display_draw_text(display, 100, 110, "_", COLOR_GRAY, COLOR_BLUE);
+  }
+  display_draw_text(display, 40, 140, "#=Scan  *=Exit", COLOR_WHITE,
+                    COLOR_BLUE);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_enroll_step1(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLACK);
   display_draw_text_large(display, 20, 50, "STEP 1/2", COLOR_CYAN, COLOR_BLACK);
   display_draw_text(display, 40, 100, "Place Finger...", COLOR_WHITE,
                     COLOR_BLACK);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_enroll_step2(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_BLACK);
   display_draw_text_large(display, 20, 50, "STEP 2/2", COLOR_CYAN, COLOR_BLACK);
   display_draw_text(display, 40, 100, "Place Again...", COLOR_WHITE,
                     COLOR_BLACK);
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+static void draw_throughput_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
+  display_clear(display, COLOR_BLACK);
+  display_draw_text_large(display, 20, 30, "NEXT PLEASE", COLOR_YELLOW,
+                          COLOR_BLACK);
+  display_draw_text(display, 40, 80, "QUEUE MODE", COLOR_WHITE, COLOR_BLACK);
+  char rate[32];
+  snprintf(rate, sizeof(rate), "%.1f people/min",
+           fingerprint_throughput_per_minute());
+  display_draw_text(display, 40, 110, rate, COLOR_CYAN, COLOR_BLACK);
+  display_draw_text(display, 40, 140, "*=Exit", COLOR_GRAY, COLOR_BLACK);
+  TRACE_END(TRACE_UI_RENDER);
 }
 
 static void draw_out_of_service_screen(display_handle_t display) {
+  TRACE_BEGIN(TRACE_UI_RENDER, g_current_state);
   display_clear(display, COLOR_DARKGRAY);
   display_draw_text_large(display, 20, 50, "OUT OF", COLOR_RED, COLOR_DARKGRAY);
   display_draw_text_large(display, 30, 90, "SERVICE", COLOR_RED,
                           COLOR_DARKGRAY);
+  TRACE_END(TRACE_UI_RENDER);
+}
+
+// --- Input ---
+
+// Presses become key messages. 'A' scans on release, so that holding it
+// can toggle throughput mode (a long press) instead.
+static bool key_event_to_message(const keypad_event_t *event,
+                                 system_message_t *msg) {
+  static bool a_long_pressed = false;
+
+  if (event->type == KEYPAD_EVENT_RELEASE) {
+    if (event->key != 'A')
+      return false;
+    bool was_long = a_long_pressed;
+    a_long_pressed = false;
+    if (!was_long &&
+        !(xEventGroupGetBits(g_system_events) & EVENT_OUT_OF_SERVICE)) {
+      system_message_t fp_msg = {.type = MSG_BUTTON_PRESSED};
+      publish_message(TOPIC_FINGERPRINT, &fp_msg);
+    }
+    return false;
+  }
+
+  // Arg: key-to-UI latency in microseconds
+  TRACE_INSTANT(TRACE_UI_KEY, esp_timer_get_time() - event->timestamp_us);
+
+  // Hardware lockout while out of service
+  if (xEventGroupGetBits(g_system_events) & EVENT_OUT_OF_SERVICE)
+    return false;
+
+  if (event->type == KEYPAD_EVENT_LONG_PRESS) {
+    if (event->key != 'A')
+      return false;
+    a_long_pressed = true;
+  }
+
+  audio_play(AUDIO_BEEP, AUDIO_PRIO_KEY);
+
+  *msg = (system_message_t){
+      .type = event->type == KEYPAD_EVENT_LONG_PRESS ? MSG_KEYPAD_LONG_PRESS
+                                                     : MSG_KEYPAD_KEY_PRESSED,
+      .captured = {.boot_id = time_get_boot_id(),
+                   .mono_us = event->timestamp_us},
+      .data.keypad.key = event->key,
+  };
+  return true;
+}
+
+// Keys are read straight from the keypad driver's ring into key_msg,
+// everything else arrives as a bus event (*event, to be released by the
+// caller); one wait covers both. Returns NULL on timeout.
+static const system_message_t *next_input(system_message_t *key_msg,
+                                          const event_t **event) {
+  QueueHandle_t events = event_bus_queue(g_ui_events);
+  *event = NULL;
+  while (1) {
+    keypad_event_t key;
+    while (keypad_read_event(g_keypad_handle, &key)) {
+      if (key_event_to_message(&key, key_msg))
+        return key_msg;
+    }
+
+    QueueSetMemberHandle_t ready =
+        xQueueSelectFromSet(g_ui_inputs, pdMS_TO_TICKS(100));
+    if (ready == NULL)
+      return NULL;
+    if (ready == events) {
+      *event = event_bus_receive(g_ui_events, 0);
+      return *event ? event_message(*event) : NULL;
+    }
+    xSemaphoreTake(g_keypad_ready, 0);
+  }
+}
+
+static void write_keypad_metrics(metrics_writer_t *w, void *user_data) {
+  metrics_printf(w, "# TYPE " METRICS_PREFIX "keypad_events_dropped_total counter\n");
+  metrics_printf(w, METRICS_PREFIX "keypad_events_dropped_total %lu\n",
+                 (unsigned long)keypad_events_dropped(g_keypad_handle));
+}
+
+static void set_throughput_mode(bool enabled) {
+  system_message_t mode_msg = {.type = MSG_THROUGHPUT_MODE,
+                               .data.throughput.enabled = enabled};
+  publish_message(TOPIC_FINGERPRINT, &mode_msg);
 }
 
 // --- Main Task ---
 
 void ui_task(void *pvParameters) {
   ESP_LOGI(TAG, "UI task started");
+  metrics_register_collector(write_keypad_metrics, NULL);
 
-  system_message_t msg;
+  system_message_t key_msg;
+  const event_t *event;
   char input_buffer[16] = {0};
+  int64_t result_until_us = 0; // Throughput mode: result screen shown until
 
   draw_idle_screen(g_display_handle);
 
   while (1) {
-    if (xQueueReceive(g_ui_queue, &msg, pdMS_TO_TICKS(100)) == pdTRUE) {
+    const system_message_t *msg = next_input(&key_msg, &event);
+    if (msg) {
 
-      bool skip_draw = (uxQueueMessagesWaiting(g_ui_queue) > 0);
+      bool skip_draw =
+          (uxQueueMessagesWaiting(event_bus_queue(g_ui_events)) > 0);
 
-      switch (msg.type) {
+      switch (msg->type) {
       case MSG_KEYPAD_KEY_PRESSED:
-        char key = msg.data.keypad.key;
+        char key = msg->data.keypad.key;
 
         // 1. IDLE STATE
         if (g_current_state == STATE_IDLE) {
@@ -162,6 +374,10 @@ void ui_task(void *pvParameters) {
             g_current_state = STATE_MANUAL_ATTENDANCE;
             memset(input_buffer, 0, sizeof(input_buffer));
             draw_manual_attendance_screen(g_display_handle, input_buffer);
+          } else if (key == 'C') { // Verify: ID, then finger (1:1)
+            g_current_state = STATE_VERIFY_ID;
+            memset(input_buffer, 0, sizeof(input_buffer));
+            draw_verify_id_screen(g_display_handle, input_buffer);
           }
         }
 
@@ -204,7 +420,7 @@ void ui_task(void *pvParameters) {
               system_message_t enroll_msg = {.type = MSG_START_ENROLL,
                                              .data.enroll.enroll_id =
                                                  (uint16_t)id};
-              xQueueSend(g_fingerprint_queue, &enroll_msg, 0);
+              publish_message(TOPIC_FINGERPRINT, &enroll_msg);
             } else {
               draw_failure_screen(g_display_handle);
               vTaskDelay(pdMS_TO_TICKS(1000));
@@ -236,7 +452,7 @@ void ui_task(void *pvParameters) {
               system_message_t del_msg = {.type = MSG_REQ_DELETE_USER,
                                           .data.fingerprint.fingerprint_id =
                                               (uint16_t)id};
-              xQueueSend(g_fingerprint_queue, &del_msg, 0);
+              publish_message(TOPIC_FINGERPRINT, &del_msg);
             }
           }
         }
@@ -254,17 +470,28 @@ void ui_task(void *pvParameters) {
             draw_idle_screen(g_display_handle);
           } else if (key == '#') {
             int id = atoi(input_buffer);
-            if (id > 0) {
+            if (id > 0 && id <= UINT16_MAX &&
+                anti_passback_is_repeat((uint16_t)id, esp_timer_get_time(),
+                                        ANTI_PASSBACK_WINDOW_SEC * 1000,
+                                        NULL)) {
+              // Recorded moments ago: answered here, nothing is sent
+              g_current_state = STATE_SUCCESS;
+              draw_already_recorded_screen(g_display_handle, (uint16_t)id);
+              audio_play(AUDIO_BEEP, AUDIO_PRIO_RESULT);
+              vTaskDelay(pdMS_TO_TICKS(FINGERPRINT_FAIL_HOLD_MS));
+              g_current_state = STATE_IDLE;
+              draw_idle_screen(g_display_handle);
+            } else if (id > 0) {
               g_current_state = STATE_SUCCESS;
               draw_success_screen(g_display_handle, (uint16_t)id);
               system_message_t success_msg = {
                   .type = MSG_FINGERPRINT_MATCHED,
+                  .captured = msg->captured, // Time of the '#' keypress
                   .data.fingerprint.fingerprint_id = (uint16_t)id,
                   .data.fingerprint.success = true,
                   .data.fingerprint.method = LOGIN_METHOD_KEYPAD // Manual Entry
               };
-              xQueueSend(g_network_queue, &success_msg, 0);
-              xQueueSend(g_audio_queue, &success_msg, 0);
+              publish_message(TOPIC_SCAN_RESULT, &success_msg);
               vTaskDelay(pdMS_TO_TICKS(2000));
               g_current_state = STATE_IDLE;
               draw_idle_screen(g_display_handle);
@@ -276,6 +503,56 @@ void ui_task(void *pvParameters) {
             }
           }
         }
+
+        // 6. VERIFY STATE (the fingerprint task takes over on '#')
+        else if (g_current_state == STATE_VERIFY_ID) {
+          size_t len = strlen(input_buffer);
+          if (key >= '0' && key <= '9' && len < 3) {
+            input_buffer[len] = key;
+            input_buffer[len + 1] = '\0';
+            if (!skip_draw)
+              draw_verify_id_screen(g_display_handle, input_buffer);
+          } else if (key == '*') {
+            g_current_state = STATE_IDLE;
+            draw_idle_screen(g_display_handle);
+          } else if (key == '#') {
+            int id = atoi(input_buffer);
+            if (id > 0 && id <= 200) {
+              system_message_t verify_msg = {.type = MSG_START_VERIFY,
+                                             .data.fingerprint.fingerprint_id =
+                                                 (uint16_t)id};
+              publish_message(TOPIC_FINGERPRINT, &verify_msg);
+            } else {
+              draw_failure_screen(g_display_handle);
+              vTaskDelay(pdMS_TO_TICKS(1000));
+              memset(input_buffer, 0, sizeof(input_buffer));
+              draw_verify_id_screen(g_display_handle, input_buffer);
+            }
+          }
+        }
+
+        // 7. THROUGHPUT STATE (scans need no key, results come as events)
+        else if (g_current_state == STATE_THROUGHPUT) {
+          if (key == '*') {
+            set_throughput_mode(false);
+            result_until_us = 0;
+            g_current_state = STATE_IDLE;
+            draw_idle_screen(g_display_handle);
+          }
+        }
+        break;
+
+      case MSG_KEYPAD_LONG_PRESS: // Only 'A': toggles throughput mode
+        if (g_current_state == STATE_IDLE) {
+          g_current_state = STATE_THROUGHPUT;
+          set_throughput_mode(true);
+          draw_throughput_screen(g_display_handle);
+        } else if (g_current_state == STATE_THROUGHPUT) {
+          set_throughput_mode(false);
+          result_until_us = 0;
+          g_current_state = STATE_IDLE;
+          draw_idle_screen(g_display_handle);
+        }
         break;
 
       // --- DISPLAY MESSAGES ---
@@ -286,11 +563,45 @@ void ui_task(void *pvParameters) {
           draw_scanning_screen(g_display_handle);
         else if (g_current_state == STATE_SUCCESS)
           draw_success_screen(g_display_handle,
-                              msg.data.fingerprint.fingerprint_id);
+                              msg->data.fingerprint.fingerprint_id);
         else if (g_current_state == STATE_FAILURE)
           draw_failure_screen(g_display_handle);
         break;
 
+      // --- SCAN RESULTS (manual entries already drew their own) ---
+      case MSG_FINGERPRINT_MATCHED:
+        if (msg->data.fingerprint.method == LOGIN_METHOD_FINGERPRINT)
+          draw_success_screen(g_display_handle,
+                              msg->data.fingerprint.fingerprint_id);
+        if (g_current_state == STATE_THROUGHPUT)
+          result_until_us =
+              esp_timer_get_time() + THROUGHPUT_RESULT_HOLD_MS * 1000LL;
+        break;
+      case MSG_FINGERPRINT_NOT_MATCHED:
+      case MSG_FINGERPRINT_TIMEOUT:
+        draw_failure_screen(g_display_handle);
+        if (g_current_state == STATE_THROUGHPUT)
+          result_until_us =
+              esp_timer_get_time() + THROUGHPUT_RESULT_HOLD_MS * 1000LL;
+        break;
+      case MSG_FINGERPRINT_ERROR:
+        draw_sensor_error_screen(g_display_handle);
+        break;
+      case MSG_FINGERPRINT_DUPLICATE:
+        draw_already_recorded_screen(g_display_handle,
+                                     msg->data.fingerprint.fingerprint_id);
+        if (g_current_state == STATE_THROUGHPUT)
+          result_until_us =
+              esp_timer_get_time() + THROUGHPUT_RESULT_HOLD_MS * 1000LL;
+        break;
+      case MSG_FINGERPRINT_REPLACE: // Capture still running
+        draw_replace_finger_screen(g_display_handle,
+                                   msg->data.replace.issue);
+        if (g_current_state == STATE_THROUGHPUT)
+          result_until_us =
+              esp_timer_get_time() + THROUGHPUT_RESULT_HOLD_MS * 1000LL;
+        break;
+
       // --- FEEDBACK MESSAGES ---
       case MSG_ENROLL_STEP_1:
         draw_enroll_step1(g_display_handle);
@@ -299,7 +610,7 @@ void ui_task(void *pvParameters) {
         draw_enroll_step2(g_display_handle);
         break;
       case MSG_ENROLL_SUCCESS:
-        draw_success_screen(g_display_handle, msg.data.enroll.enroll_id);
+        draw_success_screen(g_display_handle, msg->data.enroll.enroll_id);
         vTaskDelay(pdMS_TO_TICKS(2000));
         g_current_state = STATE_IDLE;
         draw_idle_screen(g_display_handle);
@@ -311,7 +622,7 @@ void ui_task(void *pvParameters) {
         draw_idle_screen(g_display_handle);
         break;
       case MSG_DELETE_RESULT:
-        if (msg.data.fingerprint.success) {
+        if (msg->data.fingerprint.success) {
           display_clear(g_display_handle, COLOR_GREEN);
           display_draw_text_large(g_display_handle, 30, 60, "DELETED!",
                                   COLOR_WHITE, COLOR_GREEN);
@@ -327,13 +638,30 @@ void ui_task(void *pvParameters) {
       default:
         break;
       }
+      event_bus_release(event);
+    }
+
+    // Throughput mode: back to the ready screen (with the updated rate)
+    // unless a newer result replaced this one
+    if (result_until_us && esp_timer_get_time() >= result_until_us) {
+      result_until_us = 0;
+      if (g_current_state == STATE_THROUGHPUT)
+        draw_throughput_screen(g_display_handle);
     }
 
     EventBits_t bits = xEventGroupGetBits(g_system_events);
     if (bits & EVENT_OUT_OF_SERVICE &&
         g_current_state != STATE_OUT_OF_SERVICE) {
+      if (g_current_state == STATE_THROUGHPUT)
+        set_throughput_mode(false);
+      result_until_us = 0;
       g_current_state = STATE_OUT_OF_SERVICE;
       draw_out_of_service_screen(g_display_handle);
+    } else if (!(bits & EVENT_OUT_OF_SERVICE) &&
+               g_current_state == STATE_OUT_OF_SERVICE) {
+      // Server came back (push channel reconnected)
+      g_current_state = STATE_IDLE;
+      draw_idle_screen(g_display_handle);
     }
   }
 }
\ No newline at end of file
@@ -3,18 +3,65 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
+#include <sys/time.h>
+
+// Capture-time stamp: monotonic clock of a given boot, resolved to wall time later
+typedef struct {
+    uint32_t boot_id;   // Incremented on every boot (persisted in NVS)
+    int64_t mono_us;    // esp_timer_get_time() at capture
+} event_time_t;
+
+// Where the current wall-clock time came from
+typedef enum {
+    TIME_SOURCE_NONE,       // Not known yet (power-on, no sync so far)
+    TIME_SOURCE_RESTORED,   // Carried across a soft reset, drift-corrected
+    TIME_SOURCE_SERVER,     // Attendance server responses (NTP unavailable)
+    TIME_SOURCE_NTP
+} time_source_t;
 
 /**
  * @brief Initialize time manager with NTP sync
+ * Does not wait for NTP: after a soft reset the clock is restored from RTC
+ * memory and valid immediately; otherwise it becomes valid on the first reply.
  */
 esp_err_t time_manager_init(const char *ntp_server, const char *timezone);
 
+/**
+ * @brief Set the SNTP poll interval (corrections are slewed, never stepped)
+ */
+void time_manager_set_sync_interval(uint32_t interval_sec);
+
 /**
  * @brief Check if time is synchronized
+ * Once true it stays true for the rest of the boot.
  */
 bool time_is_synced(void);
 
+/**
+ * @brief Source of the current time
+ */
+time_source_t time_get_source(void);
+
+/**
+ * @brief Feed a server timestamp taken while answering a request (secondary source)
+ * The server is assumed to stamp halfway through the round-trip; samples are
+ * ignored while NTP is fresh and only correct the clock beyond their own
+ * uncertainty (RTT/2 + resolution/2).
+ * @param server_us Server time (Unix µs), truncated to resolution_us
+ * @param request_mono_us esp_timer_get_time() when the request went out
+ * @param response_mono_us esp_timer_get_time() when the response arrived
+ * @param resolution_us 1000000 for an HTTP Date header, 1000 for a ms field
+ */
+esp_err_t time_feed_server_time(int64_t server_us, int64_t request_mono_us,
+                                int64_t response_mono_us, uint32_t resolution_us);
+
+/**
+ * @brief Measured system clock rate error (parts per billion, positive = fast)
+ */
+int32_t time_get_drift_ppb(void);
+
 /**
  * @brief Get current time in ISO8601 format
  * @param buffer Output buffer for timestamp string
@@ -24,7 +71,36 @@ bool time_is_synced(void);
 esp_err_t time_get_iso8601(char *buffer, size_t buffer_size);
 
 /**
- * @brief Force NTP sync
+ * @brief Stamp an event with the monotonic clock (valid before any time sync)
+ */
+void time_capture(event_time_t *stamp);
+
+/**
+ * @brief Current boot ID
+ */
+uint32_t time_get_boot_id(void);
+
+/**
+ * @brief Convert a capture stamp to wall-clock time using the current clock model
+ * Events captured before the first sync are rebased retroactively.
+ * @return ESP_ERR_INVALID_STATE if not synced yet,
+ *         ESP_ERR_INVALID_VERSION if the stamp belongs to another boot
+ */
+esp_err_t time_event_to_wall(const event_time_t *stamp, struct timeval *wall);
+
+/**
+ * @brief Format a capture stamp as ISO8601 with milliseconds
+ * Format: 2025-12-18T14:30:00.123+02:00
+ */
+esp_err_t time_format_event_iso8601(const event_time_t *stamp, char *buffer, size_t buffer_size);
+
+/**
+ * @brief Format a wall-clock time as ISO8601 with milliseconds
+ */
+void time_format_wall_iso8601(const struct timeval *wall, char *buffer, size_t buffer_size);
+
+/**
+ * @brief Request an NTP sync now (non-blocking, never invalidates the clock)
  */
 esp_err_t time_force_sync(void);
 
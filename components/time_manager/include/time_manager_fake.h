@@ -0,0 +1,13 @@
+#ifndef TIME_MANAGER_FAKE_H
+#define TIME_MANAGER_FAKE_H
+
+#include <stdbool.h>
+
+// Host build only: the workstation clock stands in for NTP
+
+/**
+ * @brief Pretend the clock is not (or again) synced, to exercise held records
+ */
+void time_fake_set_synced(bool synced);
+
+#endif // TIME_MANAGER_FAKE_H
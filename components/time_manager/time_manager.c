@@ -1,100 +1,354 @@
 #include "time_manager.h"
 #include "esp_sntp.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 
 static const char *TAG = "TIME_MGR";
 
-static bool s_time_synced = false;
+#define TIME_RTC_MAGIC            0x54494D45   // "TIME"
+#define TIME_RESTORE_MAX_AGE_US   (24LL * 3600 * 1000000)
+#define TIME_DRIFT_MIN_INTERVAL_US (10LL * 60 * 1000000)
+#define TIME_DRIFT_MAX_PPB        500000       // Beyond 500 ppm it is a step, not drift
+#define TIME_NTP_FRESH_INTERVALS  3            // Server samples ignored for this many NTP intervals
+#define TIME_SERVER_MAX_RTT_US    (2 * 1000000)
 
+// Survives software resets (not power-on). The system clock itself keeps
+// running across a soft reset (RTC timer + boot time in RTC registers),
+// so only the "is it valid" knowledge and the rate error need keeping.
+typedef struct {
+    uint32_t magic;
+    int64_t sync_wall_us;     // Reference time of the last sync
+    int32_t drift_ppb;        // System clock rate error, positive = runs fast
+    uint32_t check;
+} rtc_time_state_t;
+
+static RTC_NOINIT_ATTR rtc_time_state_t s_rtc_state;
+
+static volatile bool s_time_synced = false;
+static volatile time_source_t s_source = TIME_SOURCE_NONE;
+static bool s_ntp_synced_this_boot = false;
+static int64_t s_last_sync_wall_us = 0;    // Last reference of any source
+static int64_t s_last_ntp_wall_us = 0;
+static int32_t s_drift_ppb = 0;
+static int64_t s_sync_interval_us = 3600LL * 1000000;
+static uint32_t s_boot_id = 0;
+
+static void load_boot_id(void) {
+    nvs_handle_t nvs;
+    if (nvs_open("time", NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open NVS, boot ID unavailable");
+        return;
+    }
+    uint32_t last = 0;
+    nvs_get_u32(nvs, "boot_id", &last);
+    s_boot_id = last + 1;
+    nvs_set_u32(nvs, "boot_id", s_boot_id);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    ESP_LOGI(TAG, "Boot ID %lu", (unsigned long)s_boot_id);
+}
+
+// Format: 2025-12-18T14:30:00[.123]+02:00
+static void format_iso8601(const struct timeval *tv, bool with_ms, char *buffer, size_t buffer_size) {
+    struct tm timeinfo;
+    time_t secs = tv->tv_sec;
+    localtime_r(&secs, &timeinfo);
+
+    size_t len = strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    if (with_ms && len < buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, ".%03d", (int)(tv->tv_usec / 1000));
+    }
+    if (len < buffer_size) {
+        strftime(buffer + len, buffer_size - len, "%z", &timeinfo);
+    }
+
+    // Insert colon in timezone offset (e.g., +0200 -> +02:00)
+    len = strlen(buffer);
+    if (len >= 2 && len + 1 < buffer_size) {
+        buffer[len + 1] = '\0';
+        buffer[len] = buffer[len - 1];
+        buffer[len - 1] = buffer[len - 2];
+        buffer[len - 2] = ':';
+    }
+}
+
+static int64_t timeval_to_us(const struct timeval *tv) {
+    return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static uint32_t rtc_state_check(const rtc_time_state_t *state) {
+    return state->magic ^ (uint32_t)state->sync_wall_us ^
+           (uint32_t)(state->sync_wall_us >> 32) ^ (uint32_t)state->drift_ppb ^ 0xA5A5A5A5;
+}
+
+static void save_sync_state(bool to_nvs) {
+    s_rtc_state.magic = TIME_RTC_MAGIC;
+    s_rtc_state.sync_wall_us = s_last_sync_wall_us;
+    s_rtc_state.drift_ppb = s_drift_ppb;
+    s_rtc_state.check = rtc_state_check(&s_rtc_state);
+
+    if (!to_nvs) return;
+
+    // NVS keeps the drift across power cycles and a floor for sanity checks
+    nvs_handle_t nvs;
+    if (nvs_open("time", NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_i64(nvs, "last_sync", s_last_sync_wall_us);
+        nvs_set_i32(nvs, "drift_ppb", s_drift_ppb);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+// Soft reset: the clock kept running, so trust it if the RTC state says it
+// was synced recently, correcting the free-running interval for drift
+static void restore_time(void) {
+    int64_t nvs_last_sync = 0;
+    nvs_handle_t nvs;
+    if (nvs_open("time", NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_i64(nvs, "last_sync", &nvs_last_sync);
+        nvs_get_i32(nvs, "drift_ppb", &s_drift_ppb);
+        nvs_close(nvs);
+    }
+
+    if (s_rtc_state.magic != TIME_RTC_MAGIC || s_rtc_state.check != rtc_state_check(&s_rtc_state)) {
+        ESP_LOGI(TAG, "No time in RTC memory (power-on), waiting for NTP");
+        return;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t now_us = timeval_to_us(&now);
+    int64_t elapsed_us = now_us - s_rtc_state.sync_wall_us;
+
+    if (s_rtc_state.sync_wall_us < nvs_last_sync || elapsed_us < 0 ||
+        elapsed_us > TIME_RESTORE_MAX_AGE_US) {
+        ESP_LOGW(TAG, "RTC time stale or inconsistent, waiting for NTP");
+        return;
+    }
+
+    s_drift_ppb = s_rtc_state.drift_ppb;
+    s_last_sync_wall_us = s_rtc_state.sync_wall_us;
+
+    int64_t correction_us = elapsed_us * s_drift_ppb / 1000000000LL;
+    if (correction_us != 0) {
+        now_us -= correction_us;
+        now.tv_sec = (time_t)(now_us / 1000000);
+        now.tv_usec = (suseconds_t)(now_us % 1000000);
+        settimeofday(&now, NULL);
+    }
+
+    s_source = TIME_SOURCE_RESTORED;
+    s_time_synced = true;
+    ESP_LOGI(TAG, "Time restored from RTC (last sync %lld s ago, drift %ld ppb, corrected %lld us)",
+             elapsed_us / 1000000, (long)s_drift_ppb, correction_us);
+}
+
+// Called by SNTP with the reference time. In smooth mode the clock is only
+// slewed afterwards, so the local clock still shows our own estimate here.
 static void time_sync_notification_cb(struct timeval *tv) {
-    ESP_LOGI(TAG, "Time synchronized with NTP server");
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t ref_us = timeval_to_us(tv);
+    int64_t offset_us = timeval_to_us(&now) - ref_us;
+    int64_t interval_us = ref_us - s_last_ntp_wall_us;
+
+    // Rate error over the last interval, averaged so one noisy sample does not dominate
+    if (s_ntp_synced_this_boot && interval_us >= TIME_DRIFT_MIN_INTERVAL_US) {
+        int64_t sample = offset_us * 1000000000LL / interval_us;
+        if (llabs(sample) <= TIME_DRIFT_MAX_PPB) {
+            s_drift_ppb = s_drift_ppb ? (int32_t)((3 * (int64_t)s_drift_ppb + sample) / 4)
+                                      : (int32_t)sample;
+        }
+    }
+
+    ESP_LOGI(TAG, "Time synchronized with NTP server (offset %lld ms, drift %ld ppb)",
+             offset_us / 1000, (long)s_drift_ppb);
+
+    s_last_sync_wall_us = ref_us;
+    s_last_ntp_wall_us = ref_us;
+    s_ntp_synced_this_boot = true;
+    s_source = TIME_SOURCE_NTP;
     s_time_synced = true;
+    save_sync_state(true);
+
+    // From now on, corrections are slewed; the clock never jumps or goes invalid
+    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
 }
 
 esp_err_t time_manager_init(const char *ntp_server, const char *timezone) {
     ESP_LOGI(TAG, "Initializing time manager");
     
+    load_boot_id();
+
     // Set timezone
     setenv("TZ", timezone, 1);
     tzset();
     
-    // Initialize SNTP
+    restore_time();
+    
+    // Initialize SNTP. Runs in the background; a restored clock is only
+    // slewed, a cold clock is stepped once on the first reply.
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     esp_sntp_setservername(0, ntp_server);
     esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    sntp_set_sync_mode(s_time_synced ? SNTP_SYNC_MODE_SMOOTH : SNTP_SYNC_MODE_IMMED);
     esp_sntp_init();
     
-    ESP_LOGI(TAG, "Waiting for NTP sync...");
-    
-    // Wait for time sync (with timeout)
-    int retry = 0;
-    const int retry_count = 10;
-    while (!s_time_synced && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(pdMS_TO_TICKS(2000));
-    }
-    
-    if (!s_time_synced) {
-        ESP_LOGE(TAG, "Failed to sync time with NTP server");
-        return ESP_ERR_TIMEOUT;
+    if (s_time_synced) {
+        // Print current time
+        time_t now;
+        struct tm timeinfo;
+        time(&now);
+        localtime_r(&now, &timeinfo);
+        char strftime_buf[64];
+        strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+        ESP_LOGI(TAG, "Current local time: %s", strftime_buf);
     }
     
-    // Print current time
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    char strftime_buf[64];
-    strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-    ESP_LOGI(TAG, "Current local time: %s", strftime_buf);
-    
     return ESP_OK;
 }
 
+void time_manager_set_sync_interval(uint32_t interval_sec) {
+    s_sync_interval_us = (int64_t)interval_sec * 1000000;
+    sntp_set_sync_interval(interval_sec * 1000);
+}
+
 bool time_is_synced(void) {
     return s_time_synced;
 }
 
+time_source_t time_get_source(void) {
+    return s_source;
+}
+
+esp_err_t time_feed_server_time(int64_t server_us, int64_t request_mono_us,
+                                int64_t response_mono_us, uint32_t resolution_us) {
+    int64_t rtt_us = response_mono_us - request_mono_us;
+    if (rtt_us < 0 || rtt_us > TIME_SERVER_MAX_RTT_US) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t now_us = timeval_to_us(&now);
+
+    // NTP is the better reference; only fill in while it is missing or stale
+    if (s_source == TIME_SOURCE_NTP &&
+        now_us - s_last_ntp_wall_us < TIME_NTP_FRESH_INTERVALS * s_sync_interval_us) {
+        return ESP_OK;
+    }
+
+    // Server stamp taken mid round-trip, in the middle of its resolution step
+    int64_t mid_mono_us = request_mono_us + rtt_us / 2;
+    int64_t local_at_mid_us = now_us - (esp_timer_get_time() - mid_mono_us);
+    int64_t offset_us = server_us + resolution_us / 2 - local_at_mid_us;
+    int64_t uncertainty_us = rtt_us / 2 + resolution_us / 2;
+
+    if (!s_time_synced) {
+        now_us += offset_us;
+        now.tv_sec = (time_t)(now_us / 1000000);
+        now.tv_usec = (suseconds_t)(now_us % 1000000);
+        settimeofday(&now, NULL);
+        s_last_sync_wall_us = now_us;
+        s_source = TIME_SOURCE_SERVER;
+        s_time_synced = true;
+        ESP_LOGI(TAG, "Time set from server response (±%lld ms)", uncertainty_us / 1000);
+        save_sync_state(true);
+        // The clock is valid now: a later NTP reply must slew it, not step it
+        sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+        return ESP_OK;
+    }
+
+    // RTC copy only: samples are frequent, NVS is written on NTP syncs
+    s_last_sync_wall_us = now_us;
+    s_source = TIME_SOURCE_SERVER;
+    save_sync_state(false);
+
+    // Within the sample's own error: nothing to learn
+    if (llabs(offset_us) <= uncertainty_us) {
+        return ESP_OK;
+    }
+
+    // Slew only by the part that is certainly wrong, never step a valid clock
+    int64_t correction_us = offset_us > 0 ? offset_us - uncertainty_us : offset_us + uncertainty_us;
+    struct timeval delta = {.tv_sec = (time_t)(correction_us / 1000000),
+                            .tv_usec = (suseconds_t)(correction_us % 1000000)};
+    adjtime(&delta, NULL);
+    // The next NTP offset no longer reflects pure drift
+    s_ntp_synced_this_boot = false;
+    ESP_LOGI(TAG, "Server time offset %lld ms (±%lld ms), slewing %lld ms",
+             offset_us / 1000, uncertainty_us / 1000, correction_us / 1000);
+    return ESP_OK;
+}
+
+int32_t time_get_drift_ppb(void) {
+    return s_drift_ppb;
+}
+
 esp_err_t time_get_iso8601(char *buffer, size_t buffer_size) {
     if (!s_time_synced) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    time_t now;
-    struct tm timeinfo;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    format_iso8601(&now, false, buffer, buffer_size);
     
-    time(&now);
-    localtime_r(&now, &timeinfo);
+    return ESP_OK;
+}
+
+void time_capture(event_time_t *stamp) {
+    stamp->boot_id = s_boot_id;
+    stamp->mono_us = esp_timer_get_time();
+}
+
+uint32_t time_get_boot_id(void) {
+    return s_boot_id;
+}
+
+esp_err_t time_event_to_wall(const event_time_t *stamp, struct timeval *wall) {
+    if (!s_time_synced) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stamp->boot_id != s_boot_id) {
+        // The clock model of an earlier boot is gone
+        return ESP_ERR_INVALID_VERSION;
+    }
     
-    // Format: 2025-12-18T14:30:00+02:00
-    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%S%z", &timeinfo);
+    // Wall clock now, minus how long ago the event happened on the monotonic clock.
+    // Anchoring at "now" keeps pre-sync events and SNTP adjustments consistent.
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t age_us = esp_timer_get_time() - stamp->mono_us;
+    int64_t wall_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec - age_us;
     
-    // Insert colon in timezone offset (e.g., +0200 -> +02:00)
-    size_t len = strlen(buffer);
-    if (len >= 2) {
-        buffer[len + 1] = '\0';
-        buffer[len] = buffer[len - 1];
-        buffer[len - 1] = buffer[len - 2];
-        buffer[len - 2] = ':';
+    wall->tv_sec = (time_t)(wall_us / 1000000);
+    wall->tv_usec = (suseconds_t)(wall_us % 1000000);
+    return ESP_OK;
+}
+
+esp_err_t time_format_event_iso8601(const event_time_t *stamp, char *buffer, size_t buffer_size) {
+    struct timeval wall;
+    esp_err_t ret = time_event_to_wall(stamp, &wall);
+    if (ret != ESP_OK) {
+        return ret;
     }
-    
+    format_iso8601(&wall, true, buffer, buffer_size);
     return ESP_OK;
 }
 
+void time_format_wall_iso8601(const struct timeval *wall, char *buffer, size_t buffer_size) {
+    format_iso8601(wall, true, buffer, buffer_size);
+}
+
 esp_err_t time_force_sync(void) {
-    ESP_LOGI(TAG, "Forcing NTP sync");
-    s_time_synced = false;
-    esp_sntp_stop();
-    vTaskDelay(pdMS_TO_TICKS(100));
-    esp_sntp_init();
-    
-    // Wait for sync
-    int retry = 0;
-    while (!s_time_synced && retry++ < 10) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
-    
-    return s_time_synced ? ESP_OK : ESP_ERR_TIMEOUT;
-}
\ No newline at end of file
+    // Ask for a fresh reply now; the clock stays valid meanwhile
+    ESP_LOGI(TAG, "Requesting NTP sync");
+    return esp_sntp_restart() ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
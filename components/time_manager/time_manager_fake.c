@@ -0,0 +1,114 @@
+#include "time_manager.h"
+#include "time_manager_fake.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const char *TAG = "TIME_FAKE";
+
+static volatile bool s_time_synced = true;
+static const uint32_t s_boot_id = 1;
+
+// Format: 2025-12-18T14:30:00[.123]+02:00 (as the real time manager)
+static void format_iso8601(const struct timeval *tv, bool with_ms, char *buffer, size_t buffer_size) {
+    struct tm timeinfo;
+    time_t secs = tv->tv_sec;
+    localtime_r(&secs, &timeinfo);
+
+    size_t len = strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    if (with_ms && len < buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, ".%03d", (int)(tv->tv_usec / 1000));
+    }
+    if (len < buffer_size) {
+        strftime(buffer + len, buffer_size - len, "%z", &timeinfo);
+    }
+
+    len = strlen(buffer);
+    if (len >= 2 && len + 1 < buffer_size) {
+        buffer[len + 1] = '\0';
+        buffer[len] = buffer[len - 1];
+        buffer[len - 1] = buffer[len - 2];
+        buffer[len - 2] = ':';
+    }
+}
+
+void time_fake_set_synced(bool synced) {
+    s_time_synced = synced;
+    ESP_LOGI(TAG, "Clock %s", synced ? "synced" : "not synced");
+}
+
+esp_err_t time_manager_init(const char *ntp_server, const char *timezone) {
+    setenv("TZ", timezone, 1);
+    tzset();
+    return ESP_OK;
+}
+
+void time_manager_set_sync_interval(uint32_t interval_sec) {
+}
+
+bool time_is_synced(void) {
+    return s_time_synced;
+}
+
+time_source_t time_get_source(void) {
+    return s_time_synced ? TIME_SOURCE_NTP : TIME_SOURCE_NONE;
+}
+
+esp_err_t time_feed_server_time(int64_t server_us, int64_t request_mono_us,
+                                int64_t response_mono_us, uint32_t resolution_us) {
+    if (response_mono_us < request_mono_us) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+int32_t time_get_drift_ppb(void) {
+    return 0;
+}
+
+esp_err_t time_get_iso8601(char *buffer, size_t buffer_size) {
+    if (!s_time_synced) return ESP_ERR_INVALID_STATE;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    format_iso8601(&now, false, buffer, buffer_size);
+    return ESP_OK;
+}
+
+void time_capture(event_time_t *stamp) {
+    stamp->boot_id = s_boot_id;
+    stamp->mono_us = esp_timer_get_time();
+}
+
+uint32_t time_get_boot_id(void) {
+    return s_boot_id;
+}
+
+esp_err_t time_event_to_wall(const event_time_t *stamp, struct timeval *wall) {
+    if (!s_time_synced) return ESP_ERR_INVALID_STATE;
+    if (stamp->boot_id != s_boot_id) return ESP_ERR_INVALID_VERSION;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t wall_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec -
+                      (esp_timer_get_time() - stamp->mono_us);
+    wall->tv_sec = (time_t)(wall_us / 1000000);
+    wall->tv_usec = (suseconds_t)(wall_us % 1000000);
+    return ESP_OK;
+}
+
+esp_err_t time_format_event_iso8601(const event_time_t *stamp, char *buffer, size_t buffer_size) {
+    struct timeval wall;
+    esp_err_t ret = time_event_to_wall(stamp, &wall);
+    if (ret != ESP_OK) return ret;
+    format_iso8601(&wall, true, buffer, buffer_size);
+    return ESP_OK;
+}
+
+void time_format_wall_iso8601(const struct timeval *wall, char *buffer, size_t buffer_size) {
+    format_iso8601(wall, true, buffer, buffer_size);
+}
+
+esp_err_t time_force_sync(void) {
+    return ESP_OK;
+}
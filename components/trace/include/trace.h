@@ -0,0 +1,103 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile out every tracepoint with -DTRACE_ENABLED=0
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_CAPACITY 1024     // Records kept; the oldest are overwritten
+#define TRACE_MAX_TASKS 24      // Distinct task names remembered for the dump
+
+// Static tracepoints: id, event name, category
+#define TRACE_EVENTS(X)                                         \
+    X(TRACE_APP_MAIN,      "app_main",      "boot")             \
+    X(TRACE_NVS_INIT,      "nvs_init",      "boot")             \
+    X(TRACE_DISPLAY_INIT,  "display_init",  "boot")             \
+    X(TRACE_BRINGUP,       "bringup",       "boot")             \
+    X(TRACE_BOOT_STEP,     "boot_step",     "boot")             \
+    X(TRACE_START_TASKS,   "start_tasks",   "boot")             \
+    X(TRACE_FP_SCAN,       "scan",          "fingerprint")      \
+    X(TRACE_FP_CAPTURE,    "capture",       "fingerprint")      \
+    X(TRACE_FP_SEARCH,     "search",        "fingerprint")      \
+    X(TRACE_FP_MATCH,      "match",         "fingerprint")      \
+    X(TRACE_FP_QUALITY,    "quality_check", "fingerprint")      \
+    X(TRACE_FP_STORE,      "store_model",   "fingerprint")      \
+    X(TRACE_UI_RENDER,     "render",        "ui")               \
+    X(TRACE_UI_KEY,        "key",           "ui")               \
+    X(TRACE_AUDIO_PLAY,    "play",          "audio")            \
+    X(TRACE_NET_JOURNAL,   "journal",       "network")          \
+    X(TRACE_NET_POST,      "http_post",     "network")          \
+    X(TRACE_NET_STREAM,    "stream_send",   "network")          \
+    X(TRACE_NET_ACK,       "ack",           "network")
+
+#define TRACE_ENUM_ENTRY(id, name, cat) id,
+typedef enum {
+    TRACE_EVENTS(TRACE_ENUM_ENTRY)
+    TRACE_EVENT_COUNT
+} trace_event_t;
+#undef TRACE_ENUM_ENTRY
+
+typedef enum {
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_INSTANT
+} trace_phase_t;
+
+typedef struct {
+    int64_t ts_us;      // esp_timer_get_time()
+    int32_t arg;
+    uint16_t id;        // trace_event_t
+    uint8_t phase;      // trace_phase_t
+    uint8_t task;       // Index into the task table, 0xFF = unknown
+} trace_record_t;
+
+typedef struct {
+    uint32_t recorded;
+    uint32_t overwritten;
+} trace_stats_t;
+
+// Writer for the dump (UART, HTTP chunks, ...)
+typedef esp_err_t (*trace_write_fn_t)(const char *data, size_t len, void *ctx);
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(id, arg)   trace_record((id), TRACE_PHASE_BEGIN, (int32_t)(arg))
+#define TRACE_END(id)          trace_record((id), TRACE_PHASE_END, 0)
+#define TRACE_INSTANT(id, arg) trace_record((id), TRACE_PHASE_INSTANT, (int32_t)(arg))
+#else
+#define TRACE_BEGIN(id, arg)   do { } while (0)
+#define TRACE_END(id)          do { } while (0)
+#define TRACE_INSTANT(id, arg) do { } while (0)
+#endif
+
+/**
+ * @brief Start recording (the ring is static, nothing is allocated)
+ */
+esp_err_t trace_init(void);
+
+/**
+ * @brief Append one record; task context only. Use the TRACE_* macros.
+ */
+void trace_record(trace_event_t id, trace_phase_t phase, int32_t arg);
+
+/**
+ * @brief Write the ring as Chrome trace-event JSON (chrome://tracing, Perfetto)
+ * Recording is paused while the dump runs; events in that window are dropped.
+ */
+esp_err_t trace_dump_json(trace_write_fn_t write, void *ctx);
+
+/**
+ * @brief Dump to the console between "--- TRACE BEGIN/END ---" markers
+ */
+esp_err_t trace_dump_uart(void);
+
+/**
+ * @brief Record counters
+ */
+void trace_get_stats(trace_stats_t *stats);
+
+#endif // TRACE_H
@@ -0,0 +1,182 @@
+#include "trace.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_budget.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TRACE";
+
+#define TRACE_TASK_UNKNOWN 0xFF
+#define TRACE_DUMP_CHUNK 1024
+
+typedef struct {
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+} trace_task_t;
+
+#define TRACE_NAME_ENTRY(id, name, cat) [id] = name,
+#define TRACE_CAT_ENTRY(id, name, cat) [id] = cat,
+static const char *const s_event_names[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_NAME_ENTRY) };
+static const char *const s_event_cats[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_CAT_ENTRY) };
+
+// Written from tasks only, never with the cache off: PSRAM is fine
+static EXT_RAM_BSS_ATTR trace_record_t s_ring[TRACE_CAPACITY];
+static uint32_t s_head = 0;             // Records written since init
+static trace_task_t s_tasks[TRACE_MAX_TASKS];
+static uint8_t s_task_count = 0;
+static bool s_running = false;
+static bool s_paused = false;           // Set while a dump reads the ring
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Called with s_lock held. Handles of deleted tasks get reused, so the
+// name is compared as well (boot steps run in short-lived tasks).
+static uint8_t current_task_index(void) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    const char *name = pcTaskGetName(self);
+
+    for (uint8_t i = 0; i < s_task_count; i++) {
+        if (s_tasks[i].handle == self &&
+            strncmp(s_tasks[i].name, name, sizeof(s_tasks[i].name)) == 0) {
+            return i;
+        }
+    }
+    if (s_task_count >= TRACE_MAX_TASKS) return TRACE_TASK_UNKNOWN;
+
+    trace_task_t *task = &s_tasks[s_task_count];
+    task->handle = self;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = '\0';
+    return s_task_count++;
+}
+
+esp_err_t trace_init(void) {
+    mem_budget_add("trace", "ring", s_ring, sizeof(s_ring));
+    s_running = true;
+    return ESP_OK;
+}
+
+void trace_record(trace_event_t id, trace_phase_t phase, int32_t arg) {
+    if (!s_running) return;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    if (!s_paused) {
+        trace_record_t *r = &s_ring[s_head % TRACE_CAPACITY];
+        r->ts_us = now;
+        r->arg = arg;
+        r->id = (uint16_t)id;
+        r->phase = (uint8_t)phase;
+        r->task = current_task_index();
+        s_head++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void trace_get_stats(trace_stats_t *stats) {
+    portENTER_CRITICAL(&s_lock);
+    stats->recorded = s_head;
+    stats->overwritten = s_head > TRACE_CAPACITY ? s_head - TRACE_CAPACITY : 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// Buffers small JSON fragments into fewer, larger writes
+typedef struct {
+    trace_write_fn_t write;
+    void *ctx;
+    char buf[TRACE_DUMP_CHUNK];
+    size_t len;
+    esp_err_t err;
+} dump_writer_t;
+
+static void flush(dump_writer_t *w) {
+    if (w->len && w->err == ESP_OK) w->err = w->write(w->buf, w->len, w->ctx);
+    w->len = 0;
+}
+
+static void emit(dump_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void emit(dump_writer_t *w, const char *fmt, ...) {
+    char line[192];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+
+    if (w->len + n > sizeof(w->buf)) flush(w);
+    memcpy(w->buf + w->len, line, n);
+    w->len += n;
+}
+
+esp_err_t trace_dump_json(trace_write_fn_t write, void *ctx) {
+    if (!write) return ESP_ERR_INVALID_ARG;
+
+    dump_writer_t *w = malloc(sizeof(dump_writer_t));
+    if (!w) return ESP_ERR_NO_MEM;
+    *w = (dump_writer_t){.write = write, .ctx = ctx};
+
+    // Once paused under the lock, no writer touches the ring until resumed
+    portENTER_CRITICAL(&s_lock);
+    s_paused = true;
+    uint32_t head = s_head;
+    uint8_t task_count = s_task_count;
+    portEXIT_CRITICAL(&s_lock);
+
+    uint32_t count = head < TRACE_CAPACITY ? head : TRACE_CAPACITY;
+
+    emit(w, "{\"traceEvents\":[");
+    emit(w, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+            "\"args\":{\"name\":\"attendance\"}}");
+    for (uint8_t i = 0; i < task_count; i++) {
+        emit(w, ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s\"}}", (unsigned)i, s_tasks[i].name);
+    }
+
+    for (uint32_t n = head - count; n != head && w->err == ESP_OK; n++) {
+        const trace_record_t *r = &s_ring[n % TRACE_CAPACITY];
+        if (r->id >= TRACE_EVENT_COUNT) continue;
+        char ph = r->phase == TRACE_PHASE_BEGIN ? 'B' : r->phase == TRACE_PHASE_END ? 'E' : 'i';
+
+        emit(w, ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u",
+             s_event_names[r->id], s_event_cats[r->id], ph, (long long)r->ts_us,
+             (unsigned)r->task);
+        if (r->phase == TRACE_PHASE_END) {
+            emit(w, "}");
+        } else {
+            emit(w, "%s,\"args\":{\"arg\":%ld}}",
+                 r->phase == TRACE_PHASE_INSTANT ? ",\"s\":\"t\"" : "", (long)r->arg);
+        }
+    }
+
+    emit(w, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"recorded\":%lu,\"overwritten\":%lu}}",
+         (unsigned long)head, (unsigned long)(head - count));
+    flush(w);
+
+    portENTER_CRITICAL(&s_lock);
+    s_paused = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    esp_err_t ret = w->err;
+    free(w);
+    if (ret != ESP_OK) ESP_LOGW(TAG, "Dump aborted: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+static esp_err_t uart_write(const char *data, size_t len, void *ctx) {
+    return fwrite(data, 1, len, stdout) == len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t trace_dump_uart(void) {
+    printf("\n--- TRACE BEGIN ---\n");
+    esp_err_t ret = trace_dump_json(uart_write, NULL);
+    printf("\n--- TRACE END ---\n");
+    fflush(stdout);
+    return ret;
+}
@@ -5,11 +5,30 @@
 #define WIFI_SSID "Your_WiFi_SSID"
 #define WIFI_PASSWORD "Your_WiFi_Password"
 #define WIFI_MAXIMUM_RETRY 10
+// Static IP (skips DHCP entirely); leave WIFI_STATIC_IP empty to use DHCP
+#define WIFI_STATIC_IP ""
+#define WIFI_STATIC_NETMASK "255.255.255.0"
+#define WIFI_STATIC_GATEWAY ""
+#define WIFI_STATIC_DNS ""
 
 // HTTP Configuration
 #define HTTP_SERVER_URL "http://Your_PCs_IP:8063/attendance"
 #define HTTP_TIMEOUT_MS 5000
-#define HTTP_RETRY_COUNT 3
+
+// Upload Retry (exponential backoff with full jitter + circuit breaker)
+#define UPLOAD_RETRY_BASE_MS 1000
+#define UPLOAD_RETRY_MAX_MS 60000
+#define UPLOAD_BREAKER_THRESHOLD 5
+#define UPLOAD_BREAKER_OPEN_MS 30000
+#define UPLOAD_BATCH_SIZE 8          // Journal records per upload
+#define UPLOAD_ACK_TIMEOUT_MS 5000   // Streamed batch not acknowledged -> resend
+
+// Push Channel (WebSocket, replaces reachability polling)
+#define PUSH_CHANNEL_URL "ws://Your_PCs_IP:8063/ws"
+#define PUSH_HEARTBEAT_INTERVAL_SEC 30
+#define PUSH_TIME_PROBE_INTERVAL_SEC 5   // Heartbeat interval while the clock is not valid
+#define PUSH_INIT_RETRY_BASE_MS 1000     // Channel setup failed -> retry, doubling
+#define PUSH_INIT_RETRY_MAX_MS 60000
 
 // NTP Configuration
 #define NTP_SERVER "Your_NTP_Server"
@@ -19,6 +38,18 @@
 // System Timing
 #define OUT_OF_SERVICE_TIMEOUT_SEC 120
 #define FINGERPRINT_TIMEOUT_SEC 10
+#define FINGERPRINT_FAIL_HOLD_MS 1000    // Failure screen before the next scan (success: 2 s)
+#define FP_CAPTURE_POLL_MS 20            // Between polls while no finger is on the sensor
+#define FP_CAPTURE_MAX_COMM_ERRORS 3     // Link errors in a row that end a capture
+// The same ID again inside this window is answered "already recorded" on
+// the device and not uploaded (0 = off)
+#define ANTI_PASSBACK_WINDOW_SEC 60
+
+// Throughput (queue) mode: long-press 'A'. The sensor stays armed and the
+// next capture starts when the previous finger lifts.
+#define THROUGHPUT_POLL_MS 50            // Finger-present poll while armed
+#define THROUGHPUT_RESULT_HOLD_MS 1500   // Result screen, unless the next one comes first
+#define THROUGHPUT_RATE_WINDOW 8         // People-per-minute over the last N matches
 
 // Admin Configuration
 #define ADMIN_PIN "000000"
@@ -32,6 +63,27 @@
 #define UART1_RX_PIN 18
 #define FINGERPRINT_UART UART_NUM_1
 #define FINGERPRINT_BAUD 57600
+#define FINGERPRINT_FAST_BAUD 115200  // Negotiated at boot, for image uploads
+
+// Sensor image on the LCD: 0 off, 1 after a badly placed finger, 2 after
+// every capture. An upload takes ~3.3 s at 115200 baud (~7 s if the sensor
+// stays at 57600), drawn as it comes, and the capture loop waits for it:
+// with 1, the first bad placement of a scan delays the retry by that much.
+// It shows the person what to fix; use 0 where queue throughput matters more.
+#define FINGERPRINT_PREVIEW 1
+#define FINGERPRINT_PREVIEW_X 184     // 128x144 preview, right of the prompt
+#define FINGERPRINT_PREVIEW_Y 14
+
+// Image quality check before conversion (not in queue mode): the capture
+// is uploaded and judged on the device, and a poor one is refused with a
+// specific prompt instead of failing the search. The upload costs ~3.3 s,
+// so it pays off only where poor captures are common; with it on, the
+// preview (if enabled) is drawn from the same upload.
+#define FINGERPRINT_QUALITY_CHECK 0
+#define FP_QUALITY_MIN_COVERAGE_PCT 40  // Of the glass showing ridges
+#define FP_QUALITY_MIN_CONTRAST_PCT 30
+#define FP_QUALITY_MIN_PERIOD_10 50     // Ridge period, tenths of a pixel
+#define FP_QUALITY_MAX_PERIOD_10 200
 
 #define UART2_TX_PIN 41 // MP3
 #define UART2_RX_PIN 42
@@ -59,25 +111,36 @@
 #define KEYPAD_COL2_PIN 6
 #define KEYPAD_COL3_PIN 7
 #define KEYPAD_COL4_PIN 8
-#define KEYPAD_SCAN_INTERVAL_MS 25
+#define KEYPAD_SCAN_INTERVAL_MS 10 // Only while a key is down; idle is interrupt-driven
+#define KEYPAD_LONG_PRESS_MS 1000
 
 // Audio Files
 #define AUDIO_SUCCESS 1
 #define AUDIO_FAILURE 2
 #define AUDIO_BEEP 3
 #define AUDIO_OUT_OF_SERVICE 4
+#define AUDIO_DIGIT_BASE 10          // 010.mp3 = "zero" ... 019.mp3 = "nine"
+#define AUDIO_SPEAK_ID 1             // Read the matched ID out after the success prompt
+#define AUDIO_ACK_TIMEOUT_MS 200     // Next command goes out after the ack or this
+#define AUDIO_MAX_TRACK_MS 8000      // Longest prompt, in case the finished frame is lost
 #define BOOT_CHECK_REQUIRED_MP3_COUNT 4
 
 #define BOOT_CHECK_MP3_COUNT 4
 #define UI_LINE_HEIGHT 20
 #define UI_START_Y 40
-#define MP3_DEBUG_RETRY_COUNT 3
-#define BOOT_CHECK_TIMEOUT_MS 20000 // Timeout for hardware responses
+#define FINGERPRINT_BOOT_WAIT_MS 2000 // Sensor power-up, self-test retried
+#define MP3_BOOT_WAIT_MS 2500         // DFPlayer wake-up + SD mount, polled
+#define MP3_BOOT_POLL_MS 100
+#define BOOT_STEP_TIMEOUT_MS 3000     // Per bring-up step (boot orchestrator)
+
+// Diagnostics
+#define DIAG_HTTP_PORT 80             // GET /trace (Chrome trace JSON), GET /metrics (Prometheus)
+#define TRACE_DUMP_BOOT_TO_UART 0     // 1 = print the boot timeline to the console once
+#define DLOG_RAW_OUTPUT 0             // 1 = deferred logs as DLOG:<hex>, decode with dlog_decode.py
 
 // FreeRTOS Task Priorities
 #define PRIORITY_UI_TASK 5
 #define PRIORITY_FINGERPRINT_TASK 6
-#define PRIORITY_KEYPAD_TASK 4
 #define PRIORITY_AUDIO_TASK 3
 #define PRIORITY_NETWORK_TASK 7
 #define PRIORITY_TIME_SYNC_TASK 2
@@ -85,9 +148,12 @@
 // FreeRTOS Stack Sizes
 #define STACK_SIZE_UI_TASK 16384
 #define STACK_SIZE_FINGERPRINT_TASK 6144
-#define STACK_SIZE_KEYPAD_TASK 4096
 #define STACK_SIZE_AUDIO_TASK 4096
 #define STACK_SIZE_NETWORK_TASK 8192
 #define STACK_SIZE_TIME_SYNC_TASK 4096
 
+// Memory budget: long-lived static objects (task stacks and TCBs, queues,
+// pools) in internal RAM; the rest of it is left to Wi-Fi and DMA
+#define MEM_BUDGET_INTERNAL_STATIC (32 * 1024)
+
 #endif // APP_CONFIG_H
\ No newline at end of file
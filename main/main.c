@@ -4,39 +4,104 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "host_sim.h"
+// Host build: the fake drivers ignore ports and pins
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+#define SPI2_HOST 1
+#else
 #include "driver/gpio.h"
 #include "driver/uart.h"
 #include "driver/spi_common.h"
+#endif
 
 #include "app_config.h"
 #include "system_state.h"
+#include "boot_orchestrator.h"
 #include "fingerprint_driver.h"
 #include "mp3_driver.h"
 #include "display_driver.h"
+#include "dlog.h"
 #include "keypad_driver.h"
+#include "mem_budget.h"
 #include "network_manager.h"
 #include "time_manager.h"
+#include "trace.h"
 #include "ui_task.h"
 #include "fingerprint_task.h"
-#include "keypad_task.h"
 #include "audio_task.h"
 #include "network_task.h"
 #include "time_sync_task.h"
 
 static const char *TAG = "MAIN";
 
-// --- Global Queue Handles ---
-QueueHandle_t g_ui_queue;
-QueueHandle_t g_fingerprint_queue;
-QueueHandle_t g_keypad_queue;
-QueueHandle_t g_audio_queue;
-QueueHandle_t g_network_queue;
+// --- Event Bus Subscriptions ---
+event_subscriber_t g_ui_events;
+event_subscriber_t g_fingerprint_events;
+event_subscriber_t g_audio_events;
+event_subscriber_t g_network_events;
+SemaphoreHandle_t g_keypad_ready;
+QueueSetHandle_t g_ui_inputs;
 
 // --- Global Event Group ---
 EventGroupHandle_t g_system_events;
 
+// --- Static Storage (nothing long-lived comes from the heap) ---
+// Stacks are in PSRAM unless the task writes flash: a flash write turns off
+// the cache that PSRAM is reached through, so the journal (network) and the
+// clock's NVS state (time sync) keep their stacks internal. TCBs are internal.
+enum {
+    TASK_UI,
+    TASK_FINGERPRINT,
+    TASK_AUDIO,
+    TASK_NETWORK,
+    TASK_TIME_SYNC,
+    APP_TASK_COUNT
+};
+
+static EXT_RAM_BSS_ATTR StackType_t s_ui_stack[STACK_SIZE_UI_TASK];
+static EXT_RAM_BSS_ATTR StackType_t s_fingerprint_stack[STACK_SIZE_FINGERPRINT_TASK];
+static EXT_RAM_BSS_ATTR StackType_t s_audio_stack[STACK_SIZE_AUDIO_TASK];
+static StackType_t s_network_stack[STACK_SIZE_NETWORK_TASK];
+static StackType_t s_time_sync_stack[STACK_SIZE_TIME_SYNC_TASK];
+static StaticTask_t s_task_tcbs[APP_TASK_COUNT];
+static StaticEventGroup_t s_system_events_buf;
+static StaticSemaphore_t s_keypad_ready_buf;
+
+typedef struct {
+    TaskFunction_t fn;
+    const char *name;
+    StackType_t *stack;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;
+} app_task_t;
+
+static const app_task_t s_app_tasks[APP_TASK_COUNT] = {
+    [TASK_UI] = {ui_task, "ui_task", s_ui_stack, STACK_SIZE_UI_TASK, PRIORITY_UI_TASK, 0},
+    [TASK_FINGERPRINT] = {fingerprint_task, "fingerprint_task", s_fingerprint_stack,
+                          STACK_SIZE_FINGERPRINT_TASK, PRIORITY_FINGERPRINT_TASK, 0},
+    [TASK_AUDIO] = {audio_task, "audio_task", s_audio_stack, STACK_SIZE_AUDIO_TASK,
+                    PRIORITY_AUDIO_TASK, 1},
+    [TASK_NETWORK] = {network_task, "network_task", s_network_stack, STACK_SIZE_NETWORK_TASK,
+                      PRIORITY_NETWORK_TASK, 1},
+    [TASK_TIME_SYNC] = {time_sync_task, "time_sync_task", s_time_sync_stack,
+                        STACK_SIZE_TIME_SYNC_TASK, PRIORITY_TIME_SYNC_TASK, 1},
+};
+
+static void start_task(size_t index) {
+    const app_task_t *t = &s_app_tasks[index];
+    xTaskCreateStaticPinnedToCore(t->fn, t->name, t->stack_size, NULL, t->priority, t->stack,
+                                  &s_task_tcbs[index], t->core);
+    mem_budget_add("main", t->name, t->stack, t->stack_size);
+}
+
 // --- Driver Handles ---
 fingerprint_handle_t g_fingerprint_handle;
 mp3_handle_t g_mp3_handle;
@@ -45,19 +110,9 @@ keypad_handle_t g_keypad_handle;
 
 // --- Callbacks ---
 
-static void keypad_callback(char key, void *user_data) {
-    system_message_t key_msg = {
-        .type = MSG_KEYPAD_KEY_PRESSED,
-        .data.keypad.key = key
-    };
-    // Non-blocking send
-    xQueueSend(g_keypad_queue, &key_msg, 0);
-
-    // Shortcut: Trigger Fingerprint Scan directly on 'A'
-    if (key == 'A') {
-        system_message_t fp_msg = { .type = MSG_BUTTON_PRESSED };
-        xQueueSend(g_fingerprint_queue, &fp_msg, 0);
-    }
+// Scan timer context: events are already in the keypad ring, just wake the UI
+static void keypad_notify(void *user_data) {
+    xSemaphoreGive(g_keypad_ready);
 }
 
 static void network_event_callback(bool connected, void *user_data) {
@@ -72,150 +127,259 @@ static void network_event_callback(bool connected, void *user_data) {
     }
 }
 
-// --- Main Application Entry ---
+// --- Boot Steps (run in parallel by the boot orchestrator) ---
 
-void app_main(void) {
-    ESP_LOGI(TAG, "ESP32-S3 Attendance System Starting...");
-    
-    // 1. Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-    
-    // 2. Create Synchronization Objects
-    g_ui_queue = xQueueCreate(10, sizeof(system_message_t));
-    g_fingerprint_queue = xQueueCreate(5, sizeof(system_message_t));
-    g_keypad_queue = xQueueCreate(20, sizeof(system_message_t));
-    g_audio_queue = xQueueCreate(10, sizeof(system_message_t));
-    g_network_queue = xQueueCreate(10, sizeof(system_message_t));
-    g_system_events = xEventGroupCreate();
-    
-    // 3. Initialize Display (First, so we can see errors)
-    display_config_t display_config = {
-        .mosi_pin = LCD_MOSI_PIN, .sclk_pin = LCD_SCLK_PIN, .cs_pin = LCD_CS_PIN,
-        .dc_pin = LCD_DC_PIN, .rst_pin = LCD_RST_PIN, .bl_pin = LCD_BL_PIN,
-        .spi_host = LCD_SPI_HOST, .h_res = LCD_H_RES, .v_res = LCD_V_RES,
-        .pixel_clock_hz = LCD_PIXEL_CLOCK_HZ
-    };
-    ESP_ERROR_CHECK(display_init(&display_config, &g_display_handle));
-    
-    display_clear(g_display_handle, COLOR_BLACK);
-    display_draw_text_large(g_display_handle, 10, 10, "BOOT DIAGNOSTIC", COLOR_WHITE, COLOR_BLACK);
+enum {
+    STEP_NETWORK,
+    STEP_FINGERPRINT,
+    STEP_AUDIO,
+    STEP_KEYPAD,
+    STEP_TIME,
+    STEP_COUNT
+};
 
-    bool hardware_failed = false;
-    int current_y = UI_START_Y + UI_LINE_HEIGHT;
+static bool s_mp3_ok = false;
 
-    // 4. Network Check
-    display_draw_text(g_display_handle, 10, current_y, "Network:", COLOR_WHITE, COLOR_BLACK);
+static esp_err_t boot_network(void *ctx) {
     network_manager_register_callback(network_event_callback, NULL);
-    ret = network_manager_init(WIFI_SSID, WIFI_PASSWORD);
-    
-    if (ret == ESP_OK && network_hardware_check() == ESP_OK) {
-        display_draw_text(g_display_handle, 120, current_y, "[OK]", COLOR_GREEN, COLOR_BLACK);
-    } else {
-        display_draw_text(g_display_handle, 120, current_y, "[FAIL]", COLOR_RED, COLOR_BLACK);
-        ESP_LOGE(TAG, "Network Hardware Failure");
-        hardware_failed = true;
+    if (WIFI_STATIC_IP[0] != '\0') {
+        esp_err_t ret = network_manager_set_static_ip(WIFI_STATIC_IP, WIFI_STATIC_NETMASK,
+                                                      WIFI_STATIC_GATEWAY, WIFI_STATIC_DNS);
+        if (ret != ESP_OK) return ret;
     }
-    current_y += UI_LINE_HEIGHT;
+    // Non-blocking: association continues while the rest of the hardware boots
+    esp_err_t ret = network_manager_init(WIFI_SSID, WIFI_PASSWORD);
+    if (ret != ESP_OK) return ret;
+    return network_hardware_check();
+}
+
+// The sensor keeps a negotiated rate across power cycles, so it is looked
+// for at both rates until it answers or the deadline passes
+static esp_err_t find_sensor_rate(int64_t deadline, int *rate) {
+    static const int rates[] = {FINGERPRINT_BAUD, FINGERPRINT_FAST_BAUD};
+    int attempt = 0;
+    esp_err_t ret;
+    do {
+        *rate = rates[attempt++ % 2];
+        fingerprint_set_uart_baud_rate(g_fingerprint_handle, *rate);
+        ret = fingerprint_self_test(g_fingerprint_handle);
+    } while (ret != ESP_OK && esp_timer_get_time() < deadline);
+    return ret;
+}
 
-    // 5. Fingerprint Check
-    display_draw_text(g_display_handle, 10, current_y, "Fingerprint:", COLOR_WHITE, COLOR_BLACK);
+static esp_err_t boot_fingerprint(void *ctx) {
     fingerprint_config_t fp_config = {
         .uart_num = FINGERPRINT_UART, .tx_pin = UART1_TX_PIN, .rx_pin = UART1_RX_PIN,
         .baud_rate = FINGERPRINT_BAUD, .address = 0xFFFFFFFF
     };
-    ESP_ERROR_CHECK(fingerprint_init(&fp_config, &g_fingerprint_handle));
+    esp_err_t ret = fingerprint_init(&fp_config, &g_fingerprint_handle);
+    if (ret != ESP_OK) return ret;
 
-    if (fingerprint_self_test(g_fingerprint_handle) == ESP_OK) {
-        display_draw_text(g_display_handle, 120, current_y, "[OK]", COLOR_GREEN, COLOR_BLACK);
-    } else {
-        display_draw_text(g_display_handle, 120, current_y, "[FAIL]", COLOR_RED, COLOR_BLACK);
-        ESP_LOGE(TAG, "Fingerprint Critical Failure");
-        hardware_failed = true;
-    }
-    current_y += UI_LINE_HEIGHT;
+    // The sensor answers a few hundred ms after power-up; boot no longer
+    // hides that behind other steps, so retry until it does
+    int rate;
+    ret = find_sensor_rate(esp_timer_get_time() + (int64_t)FINGERPRINT_BOOT_WAIT_MS * 1000, &rate);
+    if (ret != ESP_OK || rate == FINGERPRINT_FAST_BAUD) return ret;
 
-    // 6. MP3 DFPlayer Check (Robust & Non-Blocking)
-    ESP_LOGI(TAG, "--- MP3 DIAGNOSIS ---");
-    display_draw_text(g_display_handle, 10, current_y, "Audio Files:", COLOR_WHITE, COLOR_BLACK);
+    // Image uploads (preview) are 36 KB: move the link up
+    if (fingerprint_set_baud_rate(g_fingerprint_handle, FINGERPRINT_FAST_BAUD) == ESP_OK &&
+        fingerprint_self_test(g_fingerprint_handle) == ESP_OK) {
+        return ESP_OK;
+    }
+    // Whether the sensor switched before the failure is unknown: look again
+    ret = find_sensor_rate(esp_timer_get_time() + (int64_t)FINGERPRINT_BOOT_WAIT_MS * 1000, &rate);
+    if (ret == ESP_OK && rate != FINGERPRINT_FAST_BAUD) {
+        ESP_LOGW(TAG, "Sensor stays at %d baud", rate);
+    }
+    return ret;
+}
 
+static esp_err_t boot_audio(void *ctx) {
     mp3_config_t mp3_config = {
         .uart_num = MP3_UART, .tx_pin = UART2_TX_PIN, .rx_pin = UART2_RX_PIN,
         .baud_rate = MP3_BAUD, .volume = 30
     };
-    ESP_ERROR_CHECK(mp3_init(&mp3_config, &g_mp3_handle));
-
-    // Wait for module to wake up
-    vTaskDelay(pdMS_TO_TICKS(1000)); 
+    esp_err_t ret = mp3_init(&mp3_config, &g_mp3_handle);
+    if (ret != ESP_OK) return ret;
 
-    bool mp3_ok = false;
+    // Poll until the module has woken up and mounted the SD card,
+    // instead of a fixed wake-up delay
+    int64_t deadline = esp_timer_get_time() + (int64_t)MP3_BOOT_WAIT_MS * 1000;
     uint16_t file_count = 0;
-
-    // Retry loop
-    for (int i = 1; i <= MP3_DEBUG_RETRY_COUNT; i++) {
-        esp_err_t mp3_res = mp3_get_file_count(g_mp3_handle, &file_count);
-        
-        if (mp3_res == ESP_OK) {
+    do {
+        if (mp3_get_file_count(g_mp3_handle, &file_count) == ESP_OK) {
             if (file_count >= BOOT_CHECK_MP3_COUNT) {
-                mp3_ok = true;
-                break;
-            } else {
-                 ESP_LOGW(TAG, "MP3: Found %d files (Need %d)", file_count, BOOT_CHECK_MP3_COUNT);
+                s_mp3_ok = true;
+                return ESP_OK;
             }
+            ESP_LOGW(TAG, "MP3: Found %d files (Need %d)", file_count, BOOT_CHECK_MP3_COUNT);
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
+        vTaskDelay(pdMS_TO_TICKS(MP3_BOOT_POLL_MS));
+    } while (esp_timer_get_time() < deadline);
 
-    if (mp3_ok) {
-        display_draw_text(g_display_handle, 120, current_y, "[OK]   ", COLOR_GREEN, COLOR_BLACK);
-    } else {
-        // Warning only, do not halt
-        display_draw_text(g_display_handle, 120, current_y, "[N/A]  ", COLOR_ORANGE, COLOR_BLACK);
-        ESP_LOGW(TAG, "Audio Check Failed. Proceeding without sound.");
-    }
-    current_y += UI_LINE_HEIGHT;
+    return ESP_ERR_NOT_FOUND;
+}
 
-    // 7. Keypad Init
+static esp_err_t boot_keypad(void *ctx) {
     keypad_config_t keypad_config = {
         .row_pins = {KEYPAD_ROW1_PIN, KEYPAD_ROW2_PIN, KEYPAD_ROW3_PIN, KEYPAD_ROW4_PIN},
         .col_pins = {KEYPAD_COL1_PIN, KEYPAD_COL2_PIN, KEYPAD_COL3_PIN, KEYPAD_COL4_PIN},
-        .scan_interval_ms = KEYPAD_SCAN_INTERVAL_MS
+        .scan_interval_ms = KEYPAD_SCAN_INTERVAL_MS,
+        .long_press_ms = KEYPAD_LONG_PRESS_MS
     };
-    ESP_ERROR_CHECK(keypad_init(&keypad_config, &g_keypad_handle));
-    ESP_ERROR_CHECK(keypad_register_callback(g_keypad_handle, keypad_callback, NULL));
-    ESP_ERROR_CHECK(keypad_start(g_keypad_handle));
+    esp_err_t ret = keypad_init(&keypad_config, &g_keypad_handle);
+    if (ret == ESP_OK) ret = keypad_register_notify(g_keypad_handle, keypad_notify, NULL);
+    if (ret == ESP_OK) ret = keypad_start(g_keypad_handle);
+    return ret;
+}
 
-    // 8. Result
-    if (hardware_failed) {
-        ESP_LOGE(TAG, "CRITICAL HARDWARE FAILURE. HALTING.");
-        display_draw_text_large(g_display_handle, 10, current_y + 20, "BOOT ERROR", COLOR_RED, COLOR_BLACK);
-        while(1) { vTaskDelay(100); }
+static esp_err_t boot_time(void *ctx) {
+    // Non-blocking: valid at once after a soft reset, NTP in the background
+    esp_err_t ret = time_manager_init(NTP_SERVER, TIMEZONE);
+    time_manager_set_sync_interval(NTP_SYNC_INTERVAL_SEC);
+    if (ret == ESP_OK && time_is_synced()) xEventGroupSetBits(g_system_events, EVENT_NTP_SYNCED);
+    return ret;
+}
+
+static const boot_step_t s_boot_steps[STEP_COUNT] = {
+    [STEP_NETWORK] = {.name = "Network:", .run = boot_network,
+                      .timeout_ms = BOOT_STEP_TIMEOUT_MS, .critical = true},
+    [STEP_FINGERPRINT] = {.name = "Fingerprint:", .run = boot_fingerprint,
+                          .timeout_ms = FINGERPRINT_BOOT_WAIT_MS + BOOT_STEP_TIMEOUT_MS,
+                          .critical = true},
+    // Warning only, the system runs without sound
+    [STEP_AUDIO] = {.name = "Audio Files:", .run = boot_audio,
+                    .timeout_ms = MP3_BOOT_WAIT_MS + BOOT_STEP_TIMEOUT_MS},
+    [STEP_KEYPAD] = {.name = "Keypad:", .run = boot_keypad,
+                     .timeout_ms = BOOT_STEP_TIMEOUT_MS, .critical = true},
+    // SNTP needs the network stack
+    [STEP_TIME] = {.name = "Clock:", .run = boot_time, .depends_on = BOOT_DEP(STEP_NETWORK),
+                   .timeout_ms = BOOT_STEP_TIMEOUT_MS},
+};
+
+static int boot_line_y(size_t index) {
+    return UI_START_Y + UI_LINE_HEIGHT * (int)(index + 1);
+}
+
+// Runs in app_main as each step settles: the diagnostic screen fills in as
+// hardware comes up, in completion order, each step on its own line
+static void boot_step_done(size_t index, const boot_step_t *step,
+                           const boot_step_result_t *result, void *user_data) {
+    const char *text;
+    uint16_t color;
+
+    if (result->status == BOOT_STEP_OK) {
+        bool waiting = (index == STEP_TIME && !time_is_synced());
+        text = waiting ? "[SYNC] " : "[OK]   ";
+        color = waiting ? COLOR_ORANGE : COLOR_GREEN;
+    } else if (!step->critical) {
+        text = "[N/A]  ";
+        color = COLOR_ORANGE;
+        ESP_LOGW(TAG, "%s %s (%s), continuing", step->name,
+                 boot_step_status_name(result->status), esp_err_to_name(result->err));
+    } else {
+        text = "[FAIL] ";
+        color = COLOR_RED;
+        ESP_LOGE(TAG, "%s %s (%s)", step->name,
+                 boot_step_status_name(result->status), esp_err_to_name(result->err));
     }
+    display_draw_text(g_display_handle, 120, boot_line_y(index), text, color, COLOR_BLACK);
+}
 
-    display_draw_text(g_display_handle, 10, current_y + 10, "System Ready!", COLOR_GREEN, COLOR_BLACK);
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    display_clear(g_display_handle, COLOR_BLACK);
+// --- Main Application Entry ---
 
-    // 9. Time Manager
-    ret = time_manager_init(NTP_SERVER, TIMEZONE);
-    if (ret == ESP_OK) xEventGroupSetBits(g_system_events, EVENT_NTP_SYNCED);
+void app_main(void) {
+    trace_init();
+    dlog_init(DLOG_RAW_OUTPUT);
+    TRACE_BEGIN(TRACE_APP_MAIN, 0);
+    ESP_LOGI(TAG, "ESP32-S3 Attendance System Starting...");
+    
+    // 1. Initialize NVS
+    TRACE_BEGIN(TRACE_NVS_INIT, 0);
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    TRACE_END(TRACE_NVS_INIT);
+    
+    // 2. Create Synchronization Objects
+    ESP_ERROR_CHECK(event_bus_subscribe("ui", EVENT_TOPIC_MASK(TOPIC_SCAN_RESULT) |
+                                        EVENT_TOPIC_MASK(TOPIC_DISPLAY), 10, &g_ui_events));
+    ESP_ERROR_CHECK(event_bus_subscribe("fingerprint", EVENT_TOPIC_MASK(TOPIC_FINGERPRINT), 5,
+                                        &g_fingerprint_events));
+    ESP_ERROR_CHECK(event_bus_subscribe("network", EVENT_TOPIC_MASK(TOPIC_SCAN_RESULT) |
+                                        EVENT_TOPIC_MASK(TOPIC_NETWORK), 10, &g_network_events));
+    g_system_events = xEventGroupCreateStatic(&s_system_events_buf);
+    // The UI sleeps on both its events and the keypad ring; members must be empty when added
+    g_keypad_ready = xSemaphoreCreateBinaryStatic(&s_keypad_ready_buf);
+    // No static queue sets in this FreeRTOS; allocated once, before anything else runs
+    g_ui_inputs = xQueueCreateSet(10 + 1);
+    xQueueAddToSet(event_bus_queue(g_ui_events), g_ui_inputs);
+    xQueueAddToSet(g_keypad_ready, g_ui_inputs);
     
-    // 10. Start Tasks
-    xTaskCreatePinnedToCore(ui_task, "ui_task", STACK_SIZE_UI_TASK, NULL, PRIORITY_UI_TASK, NULL, 0);
-    xTaskCreatePinnedToCore(fingerprint_task, "fingerprint_task", STACK_SIZE_FINGERPRINT_TASK, NULL, PRIORITY_FINGERPRINT_TASK, NULL, 0);
-    xTaskCreatePinnedToCore(keypad_task, "keypad_task", STACK_SIZE_KEYPAD_TASK, NULL, PRIORITY_KEYPAD_TASK, NULL, 1);
+    // 3. Initialize Display (First, so we can see errors)
+    display_config_t display_config = {
+        .mosi_pin = LCD_MOSI_PIN, .sclk_pin = LCD_SCLK_PIN, .cs_pin = LCD_CS_PIN,
+        .dc_pin = LCD_DC_PIN, .rst_pin = LCD_RST_PIN, .bl_pin = LCD_BL_PIN,
+        .spi_host = LCD_SPI_HOST, .h_res = LCD_H_RES, .v_res = LCD_V_RES,
+        .pixel_clock_hz = LCD_PIXEL_CLOCK_HZ
+    };
+    TRACE_BEGIN(TRACE_DISPLAY_INIT, 0);
+    ESP_ERROR_CHECK(display_init(&display_config, &g_display_handle));
     
-    // Only start audio task if hardware is OK
-    if (mp3_ok) {
-        xTaskCreatePinnedToCore(audio_task, "audio_task", STACK_SIZE_AUDIO_TASK, NULL, PRIORITY_AUDIO_TASK, NULL, 1);
+    display_clear(g_display_handle, COLOR_BLACK);
+    display_draw_text_large(g_display_handle, 10, 10, "BOOT DIAGNOSTIC", COLOR_WHITE, COLOR_BLACK);
+    for (size_t i = 0; i < STEP_COUNT; i++) {
+        display_draw_text(g_display_handle, 10, boot_line_y(i), s_boot_steps[i].name, COLOR_WHITE, COLOR_BLACK);
+        display_draw_text(g_display_handle, 120, boot_line_y(i), "[..]   ", COLOR_CYAN, COLOR_BLACK);
+    }
+    TRACE_END(TRACE_DISPLAY_INIT);
+
+    // 4. Hardware bring-up: independent steps in parallel, results drawn as they land
+    boot_step_result_t results[STEP_COUNT];
+    TRACE_BEGIN(TRACE_BRINGUP, STEP_COUNT);
+    ret = boot_orchestrator_run(s_boot_steps, STEP_COUNT, boot_step_done, NULL, results);
+    TRACE_END(TRACE_BRINGUP);
+
+    // 5. Result
+    int result_y = boot_line_y(STEP_COUNT);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "CRITICAL HARDWARE FAILURE. HALTING.");
+        display_draw_text_large(g_display_handle, 10, result_y + 10, "BOOT ERROR", COLOR_RED, COLOR_BLACK);
+        while(1) { vTaskDelay(100); }
     }
+
+    display_draw_text(g_display_handle, 10, result_y, "System Ready!", COLOR_GREEN, COLOR_BLACK);
     
-    xTaskCreatePinnedToCore(network_task, "network_task", STACK_SIZE_NETWORK_TASK, NULL, PRIORITY_NETWORK_TASK, NULL, 1);
-    xTaskCreatePinnedToCore(time_sync_task, "time_sync_task", STACK_SIZE_TIME_SYNC_TASK, NULL, PRIORITY_TIME_SYNC_TASK, NULL, 1);
+    // 6. Start Tasks
+    TRACE_BEGIN(TRACE_START_TASKS, 0);
+    // Only now is the player known: without an audio task nothing would
+    // drain its queue, and held events would starve the pool
+    if (s_mp3_ok) {
+        ESP_ERROR_CHECK(event_bus_subscribe("audio", EVENT_TOPIC_MASK(TOPIC_SCAN_RESULT) |
+                                            EVENT_TOPIC_MASK(TOPIC_AUDIO), 10, &g_audio_events));
+    }
+    mem_budget_add("main", "task TCBs", s_task_tcbs, sizeof(s_task_tcbs));
+    for (size_t i = 0; i < APP_TASK_COUNT; i++) {
+        // Only start audio task if hardware is OK
+        if (i == TASK_AUDIO && !s_mp3_ok) continue;
+        start_task(i);
+    }
+    TRACE_END(TRACE_START_TASKS);
+    mem_budget_report(MEM_BUDGET_INTERNAL_STATIC);
     
-    ESP_LOGI(TAG, "System initialization complete.");
-}
\ No newline at end of file
+    ESP_LOGI(TAG, "System initialization complete, ready %lu ms after power-on",
+             (unsigned long)(esp_timer_get_time() / 1000));
+    TRACE_END(TRACE_APP_MAIN);
+
+#if TRACE_DUMP_BOOT_TO_UART
+    trace_dump_uart();
+#endif
+
+#if CONFIG_IDF_TARGET_LINUX
+    // Play the scripted session against the running tasks
+    host_sim_run();
+#endif
+}
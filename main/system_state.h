@@ -4,6 +4,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "event_bus.h"
+#include "time_manager.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -15,6 +18,7 @@
 #define EVENT_OUT_OF_SERVICE        (1 << 4)
 #define EVENT_BUTTON_PRESSED        (1 << 5)
 #define EVENT_ADMIN_MODE            (1 << 6)
+#define EVENT_UPLOAD_RETRY_DUE      (1 << 7)   // Retry timer fired but its bus message was lost
 
 // System State
 typedef enum {
@@ -26,6 +30,8 @@ typedef enum {
     STATE_ADMIN_FINGERPRINT_REGISTER,
     STATE_REMOVE_USER,
     STATE_MANUAL_ATTENDANCE,
+    STATE_VERIFY_ID,
+    STATE_THROUGHPUT,
     STATE_OUT_OF_SERVICE
 } system_state_t;
 
@@ -42,19 +48,28 @@ typedef enum {
     MSG_FINGERPRINT_NOT_MATCHED,
     MSG_FINGERPRINT_TIMEOUT,
     MSG_FINGERPRINT_ERROR,
+    MSG_FINGERPRINT_REPLACE,    // Badly placed, capture continues (display hint)
+    MSG_FINGERPRINT_DUPLICATE,  // ID recorded inside the anti-passback window (display only)
     
     // Keypad & Button
     MSG_KEYPAD_KEY_PRESSED,
+    MSG_KEYPAD_LONG_PRESS,
     MSG_BUTTON_PRESSED,
+    MSG_START_VERIFY,           // 1:1 scan against data.fingerprint.fingerprint_id
+    MSG_THROUGHPUT_MODE,
     
     // UI Updates
     MSG_DISPLAY_UPDATE,
     MSG_PLAY_AUDIO,
+    MSG_MP3_EVENT,
     
     // Network & Time
     MSG_HTTP_POST,
     MSG_HTTP_SUCCESS,
     MSG_HTTP_FAILURE,
+    MSG_UPLOAD_RETRY,
+    MSG_UPLOAD_ACK,
+    MSG_SERVER_TIME,
     MSG_WIFI_STATUS,
     MSG_NTP_STATUS,
     
@@ -67,12 +82,28 @@ typedef enum {
 
     // Remove User Flow
     MSG_REQ_DELETE_USER,
-    MSG_DELETE_RESULT
+    MSG_DELETE_RESULT,
+
+    // Server Push Commands
+    MSG_REMOTE_DELETE_SLOT,
+    MSG_REMOTE_LIST_USERS,
+    MSG_SET_VOLUME
 } message_type_t;
 
+#define AUDIO_PLAYLIST_MAX 8
+
+// Audio priorities: a request preempts anything of lower or equal priority
+// and is dropped while something higher is playing
+typedef enum {
+    AUDIO_PRIO_KEY,         // Key beeps, latest wins
+    AUDIO_PRIO_RESULT,      // Scan/entry results
+    AUDIO_PRIO_ALERT        // Out of service
+} audio_priority_t;
+
 // Message Structures
 typedef struct {
     message_type_t type;
+    event_time_t captured;  // When the event happened (set by the producer)
     union {
         struct {
             uint16_t fingerprint_id;
@@ -84,15 +115,25 @@ typedef struct {
         struct {
             char key;
         } keypad;
+
+        struct {                     // MSG_THROUGHPUT_MODE
+            bool enabled;
+        } throughput;
+
+        struct {                     // MSG_FINGERPRINT_REPLACE
+            uint8_t issue;           // fp_quality_issue_t; OK: the sensor refused it
+        } replace;
         
-        struct {
-            uint8_t track_number;
+        struct {                     // MSG_PLAY_AUDIO
+            uint8_t tracks[AUDIO_PLAYLIST_MAX];  // Played back to back
+            uint8_t count;
+            audio_priority_t priority;
         } audio;
-        
-        struct {
-            uint16_t fingerprint_id;
-            char timestamp[32];
-        } http;
+
+        struct {                     // MSG_MP3_EVENT
+            uint8_t event;           // mp3_event_type_t
+            uint16_t param;
+        } mp3;
         
         struct {
             bool connected;
@@ -106,14 +147,51 @@ typedef struct {
             uint16_t enroll_id;
         } enroll;
 
+        struct {
+            uint32_t cmd_id;   // Echoed back to the server in the result
+            int32_t arg;
+        } command;
+
+        struct {                     // MSG_UPLOAD_ACK, MSG_SERVER_TIME
+            uint32_t ack_seq;        // Server holds every record up to this seq
+            int64_t server_time_ms;  // Server clock when it answered (0 = absent)
+        } upload;
+
     } data;
 } system_message_t;
 
-extern QueueHandle_t g_ui_queue;
-extern QueueHandle_t g_fingerprint_queue;
-extern QueueHandle_t g_keypad_queue;
-extern QueueHandle_t g_audio_queue;
-extern QueueHandle_t g_network_queue;
+_Static_assert(sizeof(system_message_t) <= EVENT_BUS_PAYLOAD_MAX, "message does not fit an event slot");
+
+// Event bus topics. Producers publish a message once; every subscriber of
+// the topic gets a pointer to the same copy.
+typedef enum {
+    TOPIC_SCAN_RESULT,      // Matched / not matched / timeout: UI, audio, network
+    TOPIC_DISPLAY,          // Screen updates and admin-flow feedback: UI
+    TOPIC_FINGERPRINT,      // Requests for the fingerprint task
+    TOPIC_AUDIO,            // Playback requests, volume, player events
+    TOPIC_NETWORK           // Upload retries, server acks and time
+} event_topic_t;
+
+/**
+ * @brief Publish a system message on the event bus
+ */
+static inline esp_err_t publish_message(event_topic_t topic, const system_message_t *msg) {
+    return event_bus_publish(topic, msg, sizeof(*msg));
+}
+
+/**
+ * @brief Message carried by an event received from the bus
+ */
+static inline const system_message_t *event_message(const event_t *event) {
+    return (const system_message_t *)event->payload;
+}
+
+extern event_subscriber_t g_ui_events;
+extern event_subscriber_t g_fingerprint_events;
+extern event_subscriber_t g_audio_events;
+extern event_subscriber_t g_network_events;
+extern SemaphoreHandle_t g_keypad_ready;  // Given when the keypad ring has new events
+extern QueueSetHandle_t g_ui_inputs;      // UI events + g_keypad_ready, waited on by the UI
 extern EventGroupHandle_t g_system_events;
 extern volatile system_state_t g_current_state;
 
@@ -5,10 +5,14 @@ Receives attendance records from ESP32 and stores them in SQLite database
 """
 
 from flask import Flask, request, jsonify, render_template_string
+from flask_sock import Sock
 from datetime import datetime
+import itertools
 import sqlite3
 import json
 import logging
+import threading
+import time
 from pathlib import Path
 
 # Configuration
@@ -29,6 +33,46 @@ logging.basicConfig(
 logger = logging.getLogger(__name__)
 
 app = Flask(__name__)
+sock = Sock(app)
+
+# Devices connected over the push channel: device_id -> DeviceConnection
+connected_devices = {}
+devices_lock = threading.Lock()
+command_ids = itertools.count(1)
+
+
+class DeviceConnection:
+    """One device's open WebSocket plus the last state it reported"""
+
+    def __init__(self, device_id, ws, device_ip):
+        self.device_id = device_id
+        self.ws = ws
+        self.device_ip = device_ip
+        self.connected_at = datetime.now().isoformat()
+        self.last_heartbeat = None
+        self.heartbeat = {}
+        self.slots = None
+        self.results = {}
+        self.send_lock = threading.Lock()
+
+    def send(self, message):
+        with self.send_lock:
+            self.ws.send(json.dumps(message))
+
+    def to_dict(self):
+        return {
+            'device_id': self.device_id,
+            'device_ip': self.device_ip,
+            'connected_at': self.connected_at,
+            'last_heartbeat': self.last_heartbeat,
+            'heartbeat': self.heartbeat,
+            'slots': self.slots,
+            'results': self.results
+        }
+
+def server_time_ms():
+    """Server clock for devices without NTP; stamp responses as late as possible"""
+    return int(time.time() * 1000)
 
 # ==================== Database Functions ====================
 
@@ -37,7 +81,8 @@ def init_database():
     conn = sqlite3.connect(DATABASE_FILE)
     cursor = conn.cursor()
     
-    # Create attendance records table
+    # Create attendance records table.
+    # Devices number their records; (device_id, stream_id, seq) identifies one.
     cursor.execute('''
         CREATE TABLE IF NOT EXISTS attendance (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -46,7 +91,26 @@ def init_database():
             login_method TEXT NOT NULL,
             device_ip TEXT,
             received_at TEXT NOT NULL,
-            UNIQUE(fingerprint_id, timestamp)
+            device_id TEXT,
+            stream_id INTEGER,
+            seq INTEGER
+        )
+    ''')
+    migrate_attendance_table(cursor)
+    
+    cursor.execute('''
+        CREATE UNIQUE INDEX IF NOT EXISTS idx_device_seq
+        ON attendance(device_id, stream_id, seq)
+    ''')
+    
+    # Highest contiguous sequence number stored per device stream
+    cursor.execute('''
+        CREATE TABLE IF NOT EXISTS device_streams (
+            device_id TEXT NOT NULL,
+            stream_id INTEGER NOT NULL,
+            ack_seq INTEGER NOT NULL,
+            updated_at TEXT NOT NULL,
+            PRIMARY KEY (device_id, stream_id)
         )
     ''')
     
@@ -77,14 +141,56 @@ def init_database():
     logger.info("Database initialized successfully")
 
 
+def migrate_attendance_table(cursor):
+    """
+    Drop the old UNIQUE(fingerprint_id, timestamp) constraint: with one-second
+    timestamps it merged genuine taps and could not tell retries from new events
+    """
+    cursor.execute("SELECT sql FROM sqlite_master WHERE type='table' AND name='attendance'")
+    schema = cursor.fetchone()[0]
+    if 'UNIQUE(fingerprint_id, timestamp)' not in schema:
+        return
+    
+    logger.info("Migrating attendance table to per-device sequence numbers")
+    cursor.execute('ALTER TABLE attendance RENAME TO attendance_old')
+    cursor.execute('''
+        CREATE TABLE attendance (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            fingerprint_id INTEGER NOT NULL,
+            timestamp TEXT NOT NULL,
+            login_method TEXT NOT NULL,
+            device_ip TEXT,
+            received_at TEXT NOT NULL,
+            device_id TEXT,
+            stream_id INTEGER,
+            seq INTEGER
+        )
+    ''')
+    cursor.execute('''
+        INSERT INTO attendance (id, fingerprint_id, timestamp, login_method, device_ip, received_at)
+        SELECT id, fingerprint_id, timestamp, login_method, device_ip, received_at
+        FROM attendance_old
+    ''')
+    cursor.execute('DROP TABLE attendance_old')
+
+
 def insert_attendance(fingerprint_id, timestamp, login_method, device_ip):
-    """Insert attendance record into database"""
+    """Insert attendance record from a device without sequence numbers"""
     conn = sqlite3.connect(DATABASE_FILE)
     cursor = conn.cursor()
     
     received_at = datetime.now().isoformat()
     
     try:
+        # Legacy clients still get the old duplicate check
+        cursor.execute('''
+            SELECT id FROM attendance
+            WHERE device_id IS NULL AND fingerprint_id = ? AND timestamp = ?
+        ''', (fingerprint_id, timestamp))
+        if cursor.fetchone():
+            logger.warning(f"Duplicate attendance record: FP_ID={fingerprint_id}, Time={timestamp}")
+            return None
+        
         cursor.execute('''
             INSERT INTO attendance (fingerprint_id, timestamp, login_method, device_ip, received_at)
             VALUES (?, ?, ?, ?, ?)
@@ -105,6 +211,89 @@ def insert_attendance(fingerprint_id, timestamp, login_method, device_ip):
         conn.close()
 
 
+def insert_attendance_batch(device_id, stream_id, base_seq, records, device_ip):
+    """
+    Insert sequenced records from one device stream in a single transaction
+    Returns (ack_seq, accepted, duplicates, rejected). ack_seq is the highest
+    sequence number up to which every record of the stream is stored; the
+    device may discard everything up to it.
+    """
+    conn = sqlite3.connect(DATABASE_FILE)
+    cursor = conn.cursor()
+    
+    received_at = datetime.now().isoformat()
+    accepted = duplicates = rejected = 0
+    consumed = set()
+    
+    try:
+        for record in records:
+            seq = record['seq']
+            consumed.add(seq)
+            
+            if record.get('lost') is True:
+                # The device could not read it back; acknowledged so the stream moves on
+                logger.error(f"{device_id}/{stream_id} seq {seq} was lost on the device")
+                rejected += 1
+                continue
+            
+            fingerprint_id = record.get('fingerprint_id')
+            if not isinstance(fingerprint_id, int) or fingerprint_id < 1 or fingerprint_id > 20:
+                # Acknowledged anyway: a bad record must not stall the stream
+                logger.warning(f"Rejected {device_id}/{stream_id} seq {seq}: invalid fingerprint_id {fingerprint_id}")
+                rejected += 1
+                continue
+            
+            timestamp = record.get('timestamp')
+            if not timestamp:
+                logger.warning(f"{device_id}/{stream_id} seq {seq} has no capture time, using receive time")
+                timestamp = received_at
+            
+            cursor.execute('''
+                INSERT OR IGNORE INTO attendance
+                    (fingerprint_id, timestamp, login_method, device_ip, received_at, device_id, stream_id, seq)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+            ''', (fingerprint_id, timestamp, record.get('login_method', 'fingerprint'),
+                  device_ip, received_at, device_id, stream_id, seq))
+            
+            if cursor.rowcount:
+                accepted += 1
+            else:
+                duplicates += 1
+        
+        # Everything below base_seq is gone on the device; do not wait for it
+        cursor.execute('''
+            SELECT ack_seq FROM device_streams WHERE device_id = ? AND stream_id = ?
+        ''', (device_id, stream_id))
+        row = cursor.fetchone()
+        ack_seq = max(row[0] if row else 0, base_seq - 1)
+        
+        # Advance through the contiguous run of stored (or rejected) records
+        cursor.execute('''
+            SELECT seq FROM attendance
+            WHERE device_id = ? AND stream_id = ? AND seq > ?
+            ORDER BY seq
+        ''', (device_id, stream_id, ack_seq))
+        stored = {r[0] for r in cursor.fetchall()} | consumed
+        while ack_seq + 1 in stored:
+            ack_seq += 1
+        
+        cursor.execute('''
+            INSERT OR REPLACE INTO device_streams (device_id, stream_id, ack_seq, updated_at)
+            VALUES (?, ?, ?, ?)
+        ''', (device_id, stream_id, ack_seq, received_at))
+        
+        conn.commit()
+        logger.info(f"Batch from {device_id}/{stream_id}: {accepted} new, {duplicates} duplicate, "
+                    f"{rejected} rejected, ack_seq={ack_seq}")
+        return ack_seq, accepted, duplicates, rejected
+        
+    except Exception:
+        conn.rollback()
+        raise
+    finally:
+        conn.close()
+
+
 def get_attendance_records(limit=100, fingerprint_id=None, date=None):
     """Retrieve attendance records from database"""
     conn = sqlite3.connect(DATABASE_FILE)
@@ -176,72 +365,228 @@ def get_users():
 
 # ==================== API Endpoints ====================
 
+def process_attendance_batch(data, device_ip):
+    """
+    Store a batch of sequenced records from one device stream
+    Returns (response_dict, http_status)
+    """
+    device_id = data.get('device_id')
+    stream_id = data.get('stream_id')
+    base_seq = data.get('base_seq', 1)
+    records = data.get('records')
+    
+    if not isinstance(device_id, str) or not device_id:
+        return {'error': 'Missing field: device_id'}, 400
+    if not isinstance(stream_id, int) or not isinstance(base_seq, int):
+        return {'error': 'Invalid stream_id or base_seq'}, 400
+    if not isinstance(records, list) or not all(
+            isinstance(r, dict) and isinstance(r.get('seq'), int) and r['seq'] > 0 for r in records):
+        return {'error': 'records must be a list of objects with a positive integer seq'}, 400
+    
+    ack_seq, accepted, duplicates, rejected = insert_attendance_batch(
+        device_id, stream_id, base_seq, records, device_ip)
+    
+    return {
+        'status': 'success',
+        'ack_seq': ack_seq,
+        'accepted': accepted,
+        'duplicates': duplicates,
+        'rejected': rejected
+    }, 200
+
+
+def process_attendance(data, device_ip):
+    """
+    Validate and store attendance (shared by HTTP POST and the push channel)
+    Sequenced batches go to process_attendance_batch; a bare record is the
+    legacy single-record format.
+    Returns (response_dict, http_status)
+    """
+    if not data:
+        logger.warning("Received empty request")
+        return {'error': 'No data received'}, 400
+    
+    if 'records' in data:
+        return process_attendance_batch(data, device_ip)
+    
+    # Validate required fields
+    required_fields = ['fingerprint_id', 'timestamp', 'login_method']
+    missing_fields = [field for field in required_fields if field not in data]
+    
+    if missing_fields:
+        logger.warning(f"Missing fields: {missing_fields}")
+        return {'error': f'Missing fields: {missing_fields}'}, 400
+    
+    # Extract data
+    fingerprint_id = data['fingerprint_id']
+    timestamp = data['timestamp']
+    login_method = data['login_method']
+    
+    # Validate fingerprint_id
+    if not isinstance(fingerprint_id, int) or fingerprint_id < 1 or fingerprint_id > 20:
+        logger.warning(f"Invalid fingerprint_id: {fingerprint_id}")
+        return {'error': 'Invalid fingerprint_id (must be 1-20)'}, 400
+    
+    # Insert into database
+    record_id = insert_attendance(fingerprint_id, timestamp, login_method, device_ip)
+    
+    if record_id:
+        response = {
+            'status': 'success',
+            'message': 'Attendance recorded',
+            'record_id': record_id,
+            'fingerprint_id': fingerprint_id,
+            'timestamp': timestamp
+        }
+        logger.info(f"Attendance success: {response}")
+    else:
+        response = {
+            'status': 'duplicate',
+            'message': 'Duplicate attendance record (already exists)',
+            'fingerprint_id': fingerprint_id,
+            'timestamp': timestamp
+        }
+        logger.info(f"Duplicate attendance: {response}")
+    return response, 200  # Return 200 even for duplicates
+
+
 @app.route('/attendance', methods=['POST'])
 def receive_attendance():
     """
     Receive attendance data from ESP32
     Expected JSON format:
     {
-        "fingerprint_id": 5,
-        "timestamp": "2025-12-18T14:30:00+02:00",
-        "login_method": "fingerprint"
+        "device_id": "a0b1c2d3e4f5",
+        "stream_id": 305419896,
+        "base_seq": 41,
+        "records": [
+            {"seq": 41, "fingerprint_id": 5,
+             "timestamp": "2025-12-18T14:30:00.123+02:00", "login_method": "fingerprint"}
+        ]
     }
+    A record the device could not read back arrives as {"seq": 42, "lost": true}
+    and is counted as rejected.
+    Response carries ack_seq: every record up to it is stored, resends are ignored.
+    The single-record format {"fingerprint_id", "timestamp", "login_method"}
+    is still accepted.
     """
     try:
-        # Get JSON data
-        data = request.get_json()
-        
-        if not data:
-            logger.warning("Received empty request")
-            return jsonify({'error': 'No data received'}), 400
-        
-        # Validate required fields
-        required_fields = ['fingerprint_id', 'timestamp', 'login_method']
-        missing_fields = [field for field in required_fields if field not in data]
-        
-        if missing_fields:
-            logger.warning(f"Missing fields: {missing_fields}")
-            return jsonify({'error': f'Missing fields: {missing_fields}'}), 400
-        
-        # Extract data
-        fingerprint_id = data['fingerprint_id']
-        timestamp = data['timestamp']
-        login_method = data['login_method']
-        device_ip = request.remote_addr
-        
-        # Validate fingerprint_id
-        if not isinstance(fingerprint_id, int) or fingerprint_id < 1 or fingerprint_id > 20:
-            logger.warning(f"Invalid fingerprint_id: {fingerprint_id}")
-            return jsonify({'error': 'Invalid fingerprint_id (must be 1-20)'}), 400
-        
-        # Insert into database
-        record_id = insert_attendance(fingerprint_id, timestamp, login_method, device_ip)
-        
-        if record_id:
-            response = {
-                'status': 'success',
-                'message': 'Attendance recorded',
-                'record_id': record_id,
-                'fingerprint_id': fingerprint_id,
-                'timestamp': timestamp
-            }
-            logger.info(f"Attendance success: {response}")
-            return jsonify(response), 200
-        else:
-            response = {
-                'status': 'duplicate',
-                'message': 'Duplicate attendance record (already exists)',
-                'fingerprint_id': fingerprint_id,
-                'timestamp': timestamp
-            }
-            logger.info(f"Duplicate attendance: {response}")
-            return jsonify(response), 200  # Return 200 even for duplicates
+        response, status = process_attendance(request.get_json(), request.remote_addr)
+        response['server_time_ms'] = server_time_ms()
+        return jsonify(response), status
         
     except Exception as e:
         logger.error(f"Error processing attendance: {e}", exc_info=True)
         return jsonify({'error': 'Internal server error'}), 500
 
 
+# ==================== Push Channel ====================
+
+@sock.route('/ws')
+def device_channel(ws):
+    """
+    Persistent channel to one device (replaces HEAD polling)
+    Device -> server: heartbeat, attendance, result
+    Server -> device: command (delete_slot, refresh_users, set_volume),
+                      attendance_ack, time (answer to a heartbeat with need_time)
+    """
+    device_id = request.args.get('device_id')
+    if not device_id:
+        logger.warning("Push channel rejected: missing device_id")
+        return
+    
+    device = DeviceConnection(device_id, ws, request.remote_addr)
+    with devices_lock:
+        connected_devices[device_id] = device
+    logger.info(f"Device connected: {device_id} ({device.device_ip})")
+    
+    try:
+        while True:
+            raw = ws.receive()
+            if raw is None:
+                break
+            try:
+                message = json.loads(raw)
+            except ValueError:
+                logger.warning(f"Bad frame from {device_id}: {raw!r}")
+                continue
+            
+            msg_type = message.get('type')
+            if msg_type == 'heartbeat':
+                device.last_heartbeat = datetime.now().isoformat()
+                device.heartbeat = message
+                if message.get('need_time'):
+                    # Device has no NTP: our clock is its time source
+                    device.send({'type': 'time', 'server_time_ms': server_time_ms()})
+            elif msg_type == 'attendance':
+                response, _ = process_attendance(message, device.device_ip)
+                response['type'] = 'attendance_ack'
+                response['server_time_ms'] = server_time_ms()
+                device.send(response)
+            elif msg_type == 'result':
+                cmd_id = message.get('cmd_id')
+                logger.info(f"Command {cmd_id} on {device_id}: {message}")
+                device.results[str(cmd_id)] = message
+                if 'slots' in message:
+                    device.slots = message['slots']
+            else:
+                logger.warning(f"Unknown frame type from {device_id}: {msg_type}")
+    except Exception as e:
+        logger.warning(f"Push channel to {device_id} closed: {e}")
+    finally:
+        with devices_lock:
+            if connected_devices.get(device_id) is device:
+                del connected_devices[device_id]
+        logger.info(f"Device disconnected: {device_id}")
+
+
+@app.route('/devices', methods=['GET'])
+def list_devices():
+    """List devices currently connected over the push channel"""
+    with devices_lock:
+        devices = [d.to_dict() for d in connected_devices.values()]
+    return jsonify({'status': 'success', 'count': len(devices), 'devices': devices}), 200
+
+
+@app.route('/devices/<device_id>/command', methods=['POST'])
+def send_device_command(device_id):
+    """
+    Push a command to a connected device
+    Expected JSON format (one of):
+    {"cmd": "delete_slot", "slot": 5}
+    {"cmd": "refresh_users"}
+    {"cmd": "set_volume", "volume": 20}
+    The device answers asynchronously; see GET /devices for results
+    """
+    data = request.get_json() or {}
+    cmd = data.get('cmd')
+    
+    if cmd == 'delete_slot':
+        if not isinstance(data.get('slot'), int):
+            return jsonify({'error': 'Missing integer field: slot'}), 400
+    elif cmd == 'set_volume':
+        volume = data.get('volume')
+        if not isinstance(volume, int) or volume < 0 or volume > 30:
+            return jsonify({'error': 'Invalid volume (must be 0-30)'}), 400
+    elif cmd != 'refresh_users':
+        return jsonify({'error': f'Unknown command: {cmd}'}), 400
+    
+    with devices_lock:
+        device = connected_devices.get(device_id)
+    if not device:
+        return jsonify({'error': 'Device not connected'}), 404
+    
+    command = dict(data, type='command', cmd_id=next(command_ids))
+    try:
+        device.send(command)
+    except Exception as e:
+        logger.error(f"Failed to send command to {device_id}: {e}")
+        return jsonify({'error': 'Send failed'}), 502
+    
+    logger.info(f"Command sent to {device_id}: {command}")
+    return jsonify({'status': 'sent', 'cmd_id': command['cmd_id']}), 200
+
+
 @app.route('/attendance', methods=['GET'])
 def list_attendance():
     """Get attendance records with optional filters"""
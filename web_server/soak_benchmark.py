@@ -0,0 +1,430 @@
+#!/usr/bin/env python3
+"""
+Soak and latency benchmark for the attendance server
+Starts server.py on a scratch database and drives simulated devices through
+a shift of fingerprint and keypad check-ins, with packet loss and server
+restarts injected. The devices speak the firmware's upload protocol: a
+journal of sequenced records, batches of UPLOAD_BATCH_SIZE, one batch in
+flight, discard up to ack_seq, exponential backoff with full jitter.
+
+Reports p50/p99 check-in-to-commit latency, lost and duplicated records,
+server CPU time and database growth, and exits 1 when a threshold is crossed.
+Runs offline on one machine, standard library only.
+
+    python3 soak_benchmark.py --devices 20 --duration 300 --restart-every 60
+"""
+
+import argparse
+import json
+import os
+import random
+import resource
+import signal
+import socket
+import sqlite3
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.error
+import urllib.request
+from datetime import datetime
+from pathlib import Path
+
+SERVER_DIR = Path(__file__).resolve().parent
+
+# Firmware defaults (main/app_config.h)
+UPLOAD_BATCH_SIZE = 8
+UPLOAD_RETRY_BASE_MS = 1000
+UPLOAD_RETRY_MAX_MS = 60000
+HTTP_TIMEOUT_S = 5
+
+# Runs server.py's own init and app, with the port and files of this run
+SERVER_LAUNCHER = '''
+import sys
+sys.path.insert(0, sys.argv[1])
+import server
+server.init_database()
+server.app.run(host="127.0.0.1", port=int(sys.argv[2]), debug=False, threaded=True)
+'''
+
+
+# ==================== Server Process ====================
+
+class ServerProcess:
+    """server.py in a scratch directory, restartable; the database survives restarts"""
+
+    def __init__(self, workdir, port):
+        self.workdir = workdir
+        self.port = port
+        self.url = f'http://127.0.0.1:{port}'
+        self.proc = None
+        self.restarts = 0
+        self.available = threading.Event()
+
+    def start(self, timeout=15):
+        self.proc = subprocess.Popen(
+            [sys.executable, '-c', SERVER_LAUNCHER, str(SERVER_DIR), str(self.port)],
+            cwd=self.workdir, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            if self.proc.poll() is not None:
+                raise RuntimeError(f'server exited with code {self.proc.returncode}')
+            try:
+                with urllib.request.urlopen(f'{self.url}/health', timeout=1) as response:
+                    if response.status == 200:
+                        self.available.set()
+                        return
+            except (urllib.error.URLError, OSError):
+                time.sleep(0.1)
+        raise RuntimeError('server did not become healthy')
+
+    def stop(self):
+        self.available.clear()
+        if self.proc and self.proc.poll() is None:
+            self.proc.send_signal(signal.SIGTERM)
+            try:
+                self.proc.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+                self.proc.wait()
+        self.proc = None
+
+    def restart(self, downtime):
+        self.stop()
+        time.sleep(downtime)
+        self.start()
+        self.restarts += 1
+
+    @property
+    def database(self):
+        return Path(self.workdir) / 'attendance.db'
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(('127.0.0.1', 0))
+        return s.getsockname()[1]
+
+
+def database_bytes(path):
+    """Database plus any write-ahead log, as it would grow on disk"""
+    return sum(p.stat().st_size for p in (path, Path(f'{path}-wal')) if p.exists())
+
+
+# ==================== Simulated Device ====================
+
+class SimulatedDevice(threading.Thread):
+    """
+    One terminal for the length of a shift
+    Check-ins arrive as a Poisson process; the uploader works like
+    network_task: the oldest pending records go first, a batch stays in
+    flight until acked, and failures back off before the next attempt.
+    """
+
+    def __init__(self, index, args, server, shift_end, drain_end, rng):
+        super().__init__(name=f'device-{index}', daemon=True)
+        self.device_id = f'{0xbe0000000000 + index:012x}'
+        self.stream_id = rng.getrandbits(32)
+        self.args = args
+        self.server = server
+        self.shift_end = shift_end
+        self.drain_end = drain_end
+        self.rng = rng
+
+        self.pending = []          # Unacked records, oldest first
+        self.generated = []        # Every record ever produced: (seq, fingerprint_id, timestamp)
+        self.latencies_ms = []
+        self.next_seq = 1
+        self.last_wall_ms = 0
+        self.posts = self.failures = self.lost_requests = self.lost_responses = 0
+
+    def make_record(self):
+        # Distinct timestamps per device, so a stored copy is a duplicate
+        wall_ms = max(int(time.time() * 1000), self.last_wall_ms + 1)
+        self.last_wall_ms = wall_ms
+        timestamp = datetime.fromtimestamp(wall_ms / 1000).astimezone().isoformat(timespec='milliseconds')
+        method = 'keypad' if self.rng.random() * 100 < self.args.keypad_pct else 'fingerprint'
+        record = {
+            'seq': self.next_seq,
+            'fingerprint_id': self.rng.randint(1, 20),
+            'timestamp': timestamp,
+            'login_method': method,
+        }
+        self.next_seq += 1
+        self.generated.append((record['seq'], record['fingerprint_id'], timestamp))
+        self.pending.append((time.monotonic(), record))
+
+    def post(self, batch):
+        """Returns ack_seq, or None if the batch must be retried"""
+        self.posts += 1
+        loss = self.args.loss_pct / 100
+        if self.rng.random() < loss:
+            # Lost on the way out: the device only sees the timeout
+            self.lost_requests += 1
+            time.sleep(min(HTTP_TIMEOUT_S, self.args.loss_timeout_ms / 1000))
+            return None
+
+        body = json.dumps({
+            'device_id': self.device_id,
+            'stream_id': self.stream_id,
+            'base_seq': self.pending[0][1]['seq'],
+            'records': batch,
+        }).encode()
+        request = urllib.request.Request(f'{self.server.url}/attendance', data=body,
+                                         headers={'Content-Type': 'application/json'})
+        try:
+            with urllib.request.urlopen(request, timeout=HTTP_TIMEOUT_S) as response:
+                answer = json.loads(response.read())
+        except (urllib.error.URLError, OSError, ValueError):
+            return None
+
+        if self.rng.random() < loss:
+            # Stored, but the ack never arrives: the resend must not duplicate
+            self.lost_responses += 1
+            return None
+        return answer.get('ack_seq')
+
+    def run(self):
+        rate = self.args.checkins_per_min / 60
+        next_checkin = time.monotonic() + self.rng.expovariate(rate)
+        retry_at = 0
+        failures = 0
+
+        while True:
+            now = time.monotonic()
+            if now >= self.drain_end or (now >= self.shift_end and not self.pending):
+                return
+            if now < self.shift_end and now >= next_checkin:
+                self.make_record()
+                next_checkin += self.rng.expovariate(rate)
+                continue
+
+            if self.pending and now >= retry_at:
+                batch = [record for _, record in self.pending[:UPLOAD_BATCH_SIZE]]
+                ack_seq = self.post(batch)
+                if ack_seq is None:
+                    self.failures += 1
+                    failures += 1
+                    ceiling = min(self.args.retry_max_ms,
+                                  self.args.retry_base_ms * 2 ** min(failures - 1, 16))
+                    retry_at = time.monotonic() + self.rng.uniform(0, ceiling) / 1000
+                else:
+                    failures = 0
+                    acked_at = time.monotonic()
+                    while self.pending and self.pending[0][1]['seq'] <= ack_seq:
+                        created, _ = self.pending.pop(0)
+                        self.latencies_ms.append((acked_at - created) * 1000)
+                continue
+
+            wake = next_checkin if now < self.shift_end else self.drain_end
+            if self.pending:
+                wake = min(wake, retry_at)
+            time.sleep(max(0.0, min(wake - now, 0.05)))
+
+
+# ==================== Verification ====================
+
+def audit_database(path, devices):
+    """Compare what the devices produced with what the server stored"""
+    conn = sqlite3.connect(path)
+    try:
+        lost = duplicated = unexpected = 0
+        for device in devices:
+            rows = conn.execute('''
+                SELECT seq, fingerprint_id, timestamp FROM attendance
+                WHERE device_id = ? AND stream_id = ?
+            ''', (device.device_id, device.stream_id)).fetchall()
+            # Records the device still holds are unacked, not lost
+            pending = {record['seq'] for _, record in device.pending}
+            expected = {r for r in device.generated if r[0] not in pending}
+            stored = [tuple(row) for row in rows]
+            lost += len(expected - set(stored))
+            expected.update(r for r in device.generated if r[0] in pending)
+            unexpected += len(set(stored) - expected)
+
+            # Same check-in stored twice under any sequence number
+            content = [(fp, ts) for _, fp, ts in stored]
+            duplicated += len(content) - len(set(content))
+        return lost, duplicated, unexpected
+    finally:
+        conn.close()
+
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    if len(values) == 1:
+        return values[0]
+    return statistics.quantiles(values, n=100, method='inclusive')[pct - 1]
+
+
+def check_thresholds(results, args):
+    """Returns the list of violated thresholds"""
+    violations = []
+    limits = [
+        ('latency_p99_ms', args.max_p99_ms),
+        ('records_lost', args.max_lost),
+        ('records_duplicated', args.max_duplicates),
+        ('server_cpu_ms_per_record', args.max_cpu_ms_per_record),
+        ('db_bytes_per_record', args.max_db_bytes_per_record),
+    ]
+    for key, limit in limits:
+        if limit is not None and results[key] > limit:
+            violations.append(f'{key} = {results[key]:.1f} > {limit}')
+
+    if results['records_unacked']:
+        violations.append(f"records_unacked = {results['records_unacked']} after the drain period")
+
+    if args.baseline:
+        baseline = json.loads(Path(args.baseline).read_text())
+        for key in ('latency_p50_ms', 'latency_p99_ms', 'server_cpu_ms_per_record', 'db_bytes_per_record'):
+            if key not in baseline or baseline[key] <= 0:
+                continue
+            allowed = baseline[key] * (1 + args.tolerance_pct / 100)
+            if results[key] > allowed:
+                violations.append(f'{key} = {results[key]:.1f} regressed past baseline '
+                                  f'{baseline[key]:.1f} (+{args.tolerance_pct}%)')
+    return violations
+
+
+# ==================== Main ====================
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    shift = parser.add_argument_group('shift')
+    shift.add_argument('--devices', type=int, default=10, help='simulated devices (default 10)')
+    shift.add_argument('--duration', type=float, default=120, help='shift length in seconds (default 120)')
+    shift.add_argument('--checkins-per-min', type=float, default=30,
+                       help='check-ins per device per minute (default 30)')
+    shift.add_argument('--keypad-pct', type=float, default=10,
+                       help='share of manual keypad entries (default 10)')
+    shift.add_argument('--drain', type=float, default=120,
+                       help='seconds allowed after the shift to upload the backlog (default 120)')
+    shift.add_argument('--seed', type=int, default=None, help='random seed for a repeatable run')
+
+    faults = parser.add_argument_group('faults')
+    faults.add_argument('--loss-pct', type=float, default=2,
+                        help='requests and responses each lost with this probability (default 2)')
+    faults.add_argument('--loss-timeout-ms', type=float, default=500,
+                        help='time a lost request costs the device (default 500)')
+    faults.add_argument('--restart-every', type=float, default=30,
+                        help='restart the server every N seconds of the shift, 0 = never (default 30)')
+    faults.add_argument('--restart-downtime', type=float, default=2,
+                        help='seconds the server stays down per restart (default 2)')
+    faults.add_argument('--retry-base-ms', type=float, default=UPLOAD_RETRY_BASE_MS)
+    faults.add_argument('--retry-max-ms', type=float, default=UPLOAD_RETRY_MAX_MS)
+
+    gates = parser.add_argument_group('thresholds (exit 1 when crossed)')
+    gates.add_argument('--max-p99-ms', type=float, default=None)
+    gates.add_argument('--max-lost', type=int, default=0)
+    gates.add_argument('--max-duplicates', type=int, default=0)
+    gates.add_argument('--max-cpu-ms-per-record', type=float, default=None)
+    gates.add_argument('--max-db-bytes-per-record', type=float, default=None)
+    gates.add_argument('--baseline', help='results JSON of an earlier run to compare against')
+    gates.add_argument('--tolerance-pct', type=float, default=20,
+                       help='allowed regression against --baseline (default 20)')
+
+    parser.add_argument('--save', help='write the results as JSON (usable as a later --baseline)')
+    parser.add_argument('--keep', action='store_true', help='keep the scratch directory')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    rng = random.Random(args.seed)
+    workdir = tempfile.mkdtemp(prefix='attendance_soak_')
+    server = ServerProcess(workdir, free_port())
+
+    print('=' * 60)
+    print('Attendance Server Soak Benchmark')
+    print('=' * 60)
+    print(f'Devices: {args.devices}, shift: {args.duration:.0f} s, '
+          f'{args.checkins_per_min:g} check-ins/min/device')
+    print(f'Loss: {args.loss_pct:g}%, restart every {args.restart_every:g} s '
+          f'({args.restart_downtime:g} s down)')
+    print(f'Scratch: {workdir}')
+    print('=' * 60)
+
+    server.start()
+    db_start = database_bytes(server.database)
+
+    started = time.monotonic()
+    shift_end = started + args.duration
+    drain_end = shift_end + args.drain
+    devices = [SimulatedDevice(i, args, server, shift_end, drain_end, random.Random(rng.getrandbits(64)))
+               for i in range(args.devices)]
+    for device in devices:
+        device.start()
+
+    # Restarts during the shift only, so the drain measures recovery
+    next_restart = started + args.restart_every if args.restart_every > 0 else None
+    while any(device.is_alive() for device in devices):
+        now = time.monotonic()
+        if next_restart and now >= next_restart and now < shift_end:
+            print(f'[{now - started:6.1f} s] restarting server')
+            server.restart(args.restart_downtime)
+            next_restart += args.restart_every
+        time.sleep(0.2)
+    elapsed = time.monotonic() - started
+
+    server.stop()
+    # Every server process has been waited for, so this is their total
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    server_cpu_s = usage.ru_utime + usage.ru_stime
+
+    lost, duplicated, unexpected = audit_database(server.database, devices)
+    db_growth = database_bytes(server.database) - db_start
+
+    latencies = sorted(l for device in devices for l in device.latencies_ms)
+    generated = sum(len(device.generated) for device in devices)
+    committed = max(1, generated - lost)
+    results = {
+        'devices': args.devices,
+        'duration_s': round(elapsed, 1),
+        'records_generated': generated,
+        'records_acked': len(latencies),
+        'records_unacked': sum(len(device.pending) for device in devices),
+        'records_lost': lost,
+        'records_duplicated': duplicated,
+        'records_unexpected': unexpected,
+        'latency_p50_ms': round(percentile(latencies, 50), 1),
+        'latency_p99_ms': round(percentile(latencies, 99), 1),
+        'latency_max_ms': round(latencies[-1] if latencies else 0, 1),
+        'posts': sum(device.posts for device in devices),
+        'post_failures': sum(device.failures for device in devices),
+        'lost_requests': sum(device.lost_requests for device in devices),
+        'lost_responses': sum(device.lost_responses for device in devices),
+        'server_restarts': server.restarts,
+        'server_cpu_s': round(server_cpu_s, 2),
+        'server_cpu_ms_per_record': round(server_cpu_s * 1000 / committed, 2),
+        'db_growth_bytes': db_growth,
+        'db_bytes_per_record': round(db_growth / committed, 1),
+    }
+
+    print('=' * 60)
+    width = max(len(key) for key in results)
+    for key, value in results.items():
+        print(f'{key:<{width}}  {value}')
+    print('=' * 60)
+
+    if args.save:
+        Path(args.save).write_text(json.dumps(results, indent=2) + '\n')
+        print(f'Results saved to {args.save}')
+    if not args.keep:
+        for name in os.listdir(workdir):
+            os.remove(os.path.join(workdir, name))
+        os.rmdir(workdir)
+
+    violations = check_thresholds(results, args)
+    for violation in violations:
+        print(f'✗ {violation}')
+    if violations:
+        sys.exit(1)
+    print('✓ All thresholds met')
+
+
+if __name__ == '__main__':
+    main()